@@ -14,6 +14,15 @@
 
 #define OPC_MAX_PATH 512
 #define OPC_DEFLATE_BUFFER_SIZE 4096
+#define OPC_SEEK_INDEX_SPAN (1024*1024) // distance of the checkpoints used for seeking in deflated streams
+#define OPC_STRING_BLOCK_SIZE 4096 // block size of the string arena of a container
+#define OPC_PARALLEL_DEFLATE_BLOCK_SIZE (128*1024) // input of one deflate job, see opcContainerSetOutputStreamThreads
+#define OPC_MAX_THREADS 64 // threads per stream resp. per opcContainerExtractParts call
+
+    /**
+      File offsets and sizes. Always 64 bit, so ZIP64 archives larger than 4GB can be handled on 32 bit platforms too.
+      */
+    typedef uint64_t opc_ofs_t;
 
 #ifndef SEEK_SET
 #  define SEEK_SET        0
@@ -40,7 +49,8 @@
         OPC_ERROR_HEADER,
         OPC_ERROR_MEMORY,
         OPC_ERROR_XML, 
-        OPC_ERROR_USER // user triggered an abort
+        OPC_ERROR_USER, // user triggered an abort
+        OPC_ERROR_CRC // checksum mismatch, see OPC_OPEN_VERIFY_CRC
     } opc_error_t;
     
     /**
@@ -54,6 +64,31 @@
         OPC_COMPRESSIONOPTION_SUPERFAST
     } opcCompressionOption_t;
 
+    /**
+      Callback to allocate \c size bytes, see \ref opcAllocator.
+      */
+    typedef void *opcAllocatorMallocCallback(void *ctx, size_t size);
+
+    /**
+      Callback to resize the block \c ptr (which may be \a NULL) to \c size bytes, see \ref opcAllocator.
+      */
+    typedef void *opcAllocatorReallocCallback(void *ctx, void *ptr, size_t size);
+
+    /**
+      Callback to release the block \c ptr, see \ref opcAllocator.
+      */
+    typedef void opcAllocatorFreeCallback(void *ctx, void *ptr);
+
+    /**
+      Memory allocator of a container. All callbacks must be given, \c ctx is passed to each of them.
+      \see opcContainerOpenEx
+      */
+    typedef struct OPC_ALLOCATOR_STRUCT {
+        opcAllocatorMallocCallback *_malloc;
+        opcAllocatorReallocCallback *_realloc;
+        opcAllocatorFreeCallback *_free;
+        void *ctx;
+    } opcAllocator;
 
 /**
   Abstraction for memset(m, 0, s).
@@ -33,35 +33,80 @@
 #include "internal.h"
 
 
-static void* ensureItem(void **array_, uint32_t items, uint32_t item_size) {
-    *array_=xmlRealloc(*array_, (items+1)*item_size);
+static void* ensureItem(const opcAllocator *allocator, void **array_, uint32_t items, uint32_t item_size) {
+    // the capacity is implied by the item count: arrays grow in powers of two (starting with 4 items).
+    if (0==items || (items>=4 && 0==(items&(items-1)))) {
+        void *array=opcHelperRealloc(allocator, *array_, (0==items?4:2*items)*item_size);
+        if (NULL==array) return NULL;
+        *array_=array;
+    }
     return *array_;
 }
 
 static opcContainerPart* ensurePart(opcContainer *container) {
-    return ((opcContainerPart*)ensureItem((void**)&container->part_array, container->part_items, sizeof(opcContainerPart)))+container->part_items;
+    opcContainerPart *array=(opcContainerPart*)ensureItem(container->io.allocator, (void**)&container->part_array, container->part_items, sizeof(opcContainerPart));
+    return (NULL!=array?array+container->part_items:NULL);
 }
 
 static opcContainerRelPrefix* ensureRelPrefix(opcContainer *container) {
-    return ((opcContainerRelPrefix*)ensureItem((void**)&container->relprefix_array, container->relprefix_items, sizeof(opcContainerRelPrefix)))+container->relprefix_items;
+    opcContainerRelPrefix *array=(opcContainerRelPrefix*)ensureItem(container->io.allocator, (void**)&container->relprefix_array, container->relprefix_items, sizeof(opcContainerRelPrefix));
+    return (NULL!=array?array+container->relprefix_items:NULL);
 }
 
 static opcContainerType* ensureType(opcContainer *container) {
-    return ((opcContainerType*)ensureItem((void**)&container->type_array, container->type_items, sizeof(opcContainerType)))+container->type_items;
+    opcContainerType *array=(opcContainerType*)ensureItem(container->io.allocator, (void**)&container->type_array, container->type_items, sizeof(opcContainerType));
+    return (NULL!=array?array+container->type_items:NULL);
 }
 
 static opcContainerExtension* ensureExtension(opcContainer *container) {
-    return ((opcContainerExtension*)ensureItem((void**)&container->extension_array, container->extension_items, sizeof(opcContainerExtension)))+container->extension_items;
+    opcContainerExtension *array=(opcContainerExtension*)ensureItem(container->io.allocator, (void**)&container->extension_array, container->extension_items, sizeof(opcContainerExtension));
+    return (NULL!=array?array+container->extension_items:NULL);
 }
 
 static opcContainerRelationType* ensureRelationType(opcContainer *container) {
-    return ((opcContainerRelationType*)ensureItem((void**)&container->relationtype_array, container->relationtype_items, sizeof(opcContainerRelationType)))+container->relationtype_items;
+    opcContainerRelationType *array=(opcContainerRelationType*)ensureItem(container->io.allocator, (void**)&container->relationtype_array, container->relationtype_items, sizeof(opcContainerRelationType));
+    return (NULL!=array?array+container->relationtype_items:NULL);
 }
 
 static opcContainerExternalRelation* ensureExternalRelation(opcContainer *container) {
-    return ((opcContainerExternalRelation*)ensureItem((void**)&container->externalrelation_array, container->externalrelation_items, sizeof(opcContainerRelationType)))+container->externalrelation_items;
+    opcContainerExternalRelation *array=(opcContainerExternalRelation*)ensureItem(container->io.allocator, (void**)&container->externalrelation_array, container->externalrelation_items, sizeof(opcContainerExternalRelation));
+    return (NULL!=array?array+container->externalrelation_items:NULL);
+}
+
+
+static xmlChar *opcContainerStrdup(opcContainer *container, const xmlChar *str) {
+    // strings live as long as the container, so they are bump allocated and freed all at once.
+    if (NULL==str) return NULL;
+    uint32_t const len=xmlStrlen(str)+1;
+    opcContainerStringBlock *block=container->string_block;
+    if (NULL==block || block->used+len>block->size) {
+        uint32_t const size=(len>OPC_STRING_BLOCK_SIZE/4?len:OPC_STRING_BLOCK_SIZE);
+        opcContainerStringBlock *new_block=(opcContainerStringBlock *)opcHelperMalloc(container->io.allocator, sizeof(opcContainerStringBlock)+size);
+        if (NULL==new_block) return NULL;
+        new_block->size=size;
+        new_block->used=0;
+        if (NULL!=block && size!=OPC_STRING_BLOCK_SIZE) { // long string, keep filling the current block
+            new_block->next=block->next;
+            block->next=new_block;
+        } else {
+            new_block->next=block;
+            container->string_block=new_block;
+        }
+        block=new_block;
+    }
+    xmlChar *ret=block->data+block->used;
+    memcpy(ret, str, len);
+    block->used+=len;
+    return ret;
 }
 
+static void opcContainerFreeStrings(opcContainer *container) {
+    while(NULL!=container->string_block) {
+        opcContainerStringBlock *next=container->string_block->next;
+        opcHelperFree(container->io.allocator, container->string_block);
+        container->string_block=next;
+    }
+}
 
 static bool findItem(void *array_, uint32_t items, const void *key1, uint32_t key2, int (*cmp_fct)(const void *key1, uint32_t key2, const void *array_, uint32_t item), uint32_t *pos) {
     uint32_t i=0;
@@ -100,16 +145,106 @@ static inline int part_cmp_fct(const void *key, uint32_t v, const void *array_,
 }
 
 
+static inline uint32_t part_hash_fct(const xmlChar *name) {
+    uint32_t h=2166136261u; // FNV-1a
+    for(;0!=*name;name++) {
+        h=(h^*name)*16777619u;
+    }
+    return h;
+}
+
+static bool opcContainerBuildPartHash(opcContainer *container) {
+    // the part_array is kept sorted (serialisation order), the hash maps names to positions in it.
+    uint32_t hash_size=16;
+    while(hash_size<2*container->part_items) hash_size<<=1;
+    container->part_hash_valid=false;
+    if (hash_size!=container->part_hash_size) {
+        uint32_t *part_hash_array=(uint32_t *)opcHelperRealloc(container->io.allocator, container->part_hash_array, hash_size*sizeof(uint32_t));
+        if (NULL==part_hash_array) return false;
+        container->part_hash_array=part_hash_array;
+        container->part_hash_size=hash_size;
+    }
+    opc_bzero_mem(container->part_hash_array, hash_size*sizeof(uint32_t));
+    for(uint32_t i=0;i<container->part_items;i++) {
+        uint32_t h=part_hash_fct(container->part_array[i].name)&(hash_size-1);
+        while(0!=container->part_hash_array[h]) h=(h+1)&(hash_size-1);
+        container->part_hash_array[h]=i+1; // 0 denotes an empty slot
+    }
+    container->part_hash_valid=true;
+    container->part_hash_misses=0;
+    return true;
+}
+
+static bool opcContainerAddPartHash(opcContainer *container, uint32_t i) {
+    // rebuilding whenever the table gets half full keeps appends amortised O(1).
+    if (2*container->part_items>container->part_hash_size) {
+        return opcContainerBuildPartHash(container);
+    } else {
+        uint32_t const mask=container->part_hash_size-1;
+        uint32_t h=part_hash_fct(container->part_array[i].name)&mask;
+        while(0!=container->part_hash_array[h]) h=(h+1)&mask;
+        container->part_hash_array[h]=i+1;
+        return true;
+    }
+}
+
+static bool opcContainerFindPartByHash(opcContainer *container, const xmlChar *name, uint32_t *pos) {
+    assert(container->part_hash_valid);
+    uint32_t const mask=container->part_hash_size-1;
+    for(uint32_t h=part_hash_fct(name)&mask;0!=container->part_hash_array[h];h=(h+1)&mask) {
+        uint32_t const i=container->part_hash_array[h]-1;
+        if (container->part_array[i].name==name || 0==xmlStrcmp(container->part_array[i].name, name)) {
+            *pos=i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static int part_sort_fct(const void *a, const void *b) {
+    return xmlStrcmp(((const opcContainerPart*)a)->name, ((const opcContainerPart*)b)->name);
+}
+
+static bool opcContainerSortParts(opcContainer *container) {
+    assert(container->part_array_unsorted);
+    container->part_array_unsorted=false;
+    if (container->part_items>1) {
+        qsort(container->part_array, container->part_items, sizeof(opcContainerPart), part_sort_fct);
+    }
+    return opcContainerBuildPartHash(container);
+}
+
 opcContainerPart *opcContainerInsertPart(opcContainer *container, const xmlChar *name, bool insert) {
     uint32_t i=0;
-    if (findItem(container->part_array, container->part_items, name, 0, part_cmp_fct, &i)) {
+    if (container->part_array_unsorted) { // loading, see opcContainerLoadFromZip
+        if (!container->part_hash_valid) {
+            return NULL; // out of memory
+        } else if (opcContainerFindPartByHash(container, name, &i)) {
+            return &container->part_array[i];
+        } else if (insert && NULL!=ensurePart(container)) {
+            i=container->part_items++;
+            opc_bzero_mem(&container->part_array[i], sizeof(container->part_array[i]));
+            container->part_array[i].first_segment_id=-1;
+            container->part_array[i].last_segment_id=-1;
+            container->part_array[i].name=opcContainerStrdup(container, name);
+            container->part_array[i].rel_segment_id=-1;
+            return (NULL!=container->part_array[i].name && opcContainerAddPartHash(container, i)?&container->part_array[i]:NULL);
+        } else {
+            return NULL;
+        }
+    } else if (!insert && (container->part_hash_valid || (++container->part_hash_misses>container->part_items && opcContainerBuildPartHash(container)))) {
+        // while parts are being created the binary search below is used; the hash is only rebuilt once enough 
+        // lookups paid for it, otherwise creating n parts would rebuild it n times.
+        return (opcContainerFindPartByHash(container, name, &i)?&container->part_array[i]:NULL);
+    } else if (findItem(container->part_array, container->part_items, name, 0, part_cmp_fct, &i)) {
         return &container->part_array[i];
     } else if (insert && NULL!=ensurePart(container)) {
         ensureGap(container->part_array, container->part_items, i);
         container->part_array[i].first_segment_id=-1;
         container->part_array[i].last_segment_id=-1;
-        container->part_array[i].name=xmlStrdup(name); 
+        container->part_array[i].name=opcContainerStrdup(container, name);
         container->part_array[i].rel_segment_id=-1;
+        container->part_hash_valid=false; // positions changed, rebuilt on the next lookup
         return &container->part_array[i];
     } else {
         return NULL;
@@ -129,6 +264,7 @@ static opc_error_t opcContainerDeleteAllRelationsToPart(opcContainer *container,
     for(uint32_t i=0;i<*relation_items;) {
         if (0==(*relation_array)[i].target_mode && part==(*relation_array)[i].target_ptr) {
             deleteItem((*relation_array), (*relation_items), i);
+            container->relation_generation++;
         } else {
             i++;
         }
@@ -140,23 +276,48 @@ opc_error_t opcContainerDeletePart(opcContainer *container, const xmlChar *name)
     opc_error_t ret=OPC_ERROR_NONE;
     uint32_t i=0;
     if (findItem(container->part_array, container->part_items, name, 0, part_cmp_fct, &i)) {
-        if (-1!=container->part_array[i].first_segment_id) {
-            opcContainerDeletePartEx(container, name, false);
+        bool const incoming=opcContainerBuildIncomingRelations(container); // loads all relations, all relations to the part are deleted
+        opcContainerPart *part=&container->part_array[i];
+        // same as opcContainerDeletePartEx, but without looking up the part, the hash is outdated after a delete
+        if ((uint32_t)-1!=part->first_segment_id) {
+            opcZipSegmentDelete(container->storage, &part->first_segment_id, &part->last_segment_id, NULL);
         }
-        if (-1!=container->part_array[i].rel_segment_id) {
-            opcContainerDeletePartEx(container, name, true);
+        if ((uint32_t)-1!=part->rel_segment_id) {
+            opcZipSegmentDelete(container->storage, &part->rel_segment_id, NULL, NULL);
         }
-        OPC_ENSURE(OPC_ERROR_NONE==opcContainerDeleteAllRelationsToPart(container, container->part_array[i].name, &container->relation_array, &container->relation_items));
-        for(uint32_t j=0;j<container->part_items;j++) {
-            OPC_ENSURE(OPC_ERROR_NONE==opcContainerDeleteAllRelationsToPart(container, container->part_array[i].name, &container->part_array[j].relation_array, &container->part_array[j].relation_items));
+        if (incoming) { // only visit the relations to and from the part
+            for(opcContainerIncomingRelation *in=opcContainerFindIncomingRelation(container, part->name, NULL, OPC_RELATION_INVALID);
+                NULL!=in;
+                in=opcContainerFindIncomingRelation(container, part->name, in->source, in->relation_id)) {
+                uint32_t j=0;
+                if (NULL==in->source) {
+                    OPC_ENSURE(OPC_ERROR_NONE==opcContainerDeleteRelation(container, &container->relation_array, &container->relation_items, in->relation_id));
+                } else if (findItem(container->part_array, container->part_items, in->source, 0, part_cmp_fct, &j)) {
+                    OPC_ENSURE(OPC_ERROR_NONE==opcContainerDeleteRelation(container, &container->part_array[j].relation_array, &container->part_array[j].relation_items, in->relation_id));
+                }
+                in->deleted=true;
+                container->incoming_deleted++;
+            }
+            for(uint32_t j=0;j<part->relation_items;j++) {
+                if (0==part->relation_array[j].target_mode) {
+                    opcContainerRemoveIncomingRelation(container, part->name, &part->relation_array[j]);
+                }
+            }
+            opcContainerCompactIncomingRelations(container);
+        } else {
+            OPC_ENSURE(OPC_ERROR_NONE==opcContainerDeleteAllRelationsToPart(container, part->name, &container->relation_array, &container->relation_items));
+            for(uint32_t j=0;j<container->part_items;j++) {
+                OPC_ENSURE(OPC_ERROR_NONE==opcContainerDeleteAllRelationsToPart(container, part->name, &container->part_array[j].relation_array, &container->part_array[j].relation_items));
+            }
         }
         if (NULL!=container->part_array[i].relation_array){
-            xmlFree(container->part_array[i].relation_array);
+            opcHelperFree(container->io.allocator, container->part_array[i].relation_array);
         }
-        if (NULL!=container->part_array[i].name){
-            xmlFree(container->part_array[i].name);   
+        if (NULL!=container->part_array[i].relation_type_index.index_array){
+            opcHelperFree(container->io.allocator, container->part_array[i].relation_type_index.index_array);
         }
         deleteItem(container->part_array, container->part_items, i);
+        container->part_hash_valid=false;
     }
     return ret;
 }
@@ -173,7 +334,7 @@ static uint32_t insertRelPrefix(opcContainer *container, const xmlChar *relPrefi
     } else {
         if (container->relprefix_items<OPC_MAX_UINT16 && NULL!=ensureRelPrefix(container)) {
             i=container->relprefix_items++;
-            container->relprefix_array[i].prefix=xmlStrdup(relPrefix);
+            container->relprefix_array[i].prefix=opcContainerStrdup(container, relPrefix);
             return i;
         } else {
             return -1; // error
@@ -229,7 +390,7 @@ opcContainerType *insertType(opcContainer *container, const xmlChar *type, bool
         return &container->type_array[i];
     } else if (insert && NULL!=ensureType(container)) {
         ensureGap(container->type_array, container->type_items, i);
-        container->type_array[i].type=xmlStrdup(type);
+        container->type_array[i].type=opcContainerStrdup(container, type);
         return &container->type_array[i];
     } else {
         return NULL;
@@ -246,7 +407,7 @@ opcContainerExtension *opcContainerInsertExtension(opcContainer *container, cons
         return &container->extension_array[i];
     } else if (insert && NULL!=ensureExtension(container)) {
         ensureGap(container->extension_array, container->extension_items, i);
-        container->extension_array[i].extension=xmlStrdup(extension);
+        container->extension_array[i].extension=opcContainerStrdup(container, extension);
         return &container->extension_array[i];
     } else {
         return NULL;
@@ -262,7 +423,7 @@ opcContainerRelationType *opcContainerInsertRelationType(opcContainer *container
         return &container->relationtype_array[i];
     } else if (insert && NULL!=ensureRelationType(container)) {
         ensureGap(container->relationtype_array, container->relationtype_items, i);
-        container->relationtype_array[i].type=xmlStrdup(type);
+        container->relationtype_array[i].type=opcContainerStrdup(container, type);
         return &container->relationtype_array[i];
     } else {
         return NULL;
@@ -279,7 +440,7 @@ opcContainerExternalRelation*insertExternalRelation(opcContainer *container, con
         return &container->externalrelation_array[i];
     } else if (insert && NULL!=ensureExternalRelation(container)) {
         ensureGap(container->externalrelation_array, container->externalrelation_items, i);
-        container->externalrelation_array[i].target=xmlStrdup(target);
+        container->externalrelation_array[i].target=opcContainerStrdup(container, target);
         return &container->externalrelation_array[i];
     } else {
         return NULL;
@@ -304,7 +465,47 @@ static inline int relation_cmp_fct(const void *key, uint32_t v, const void *arra
         return OPC_CONTAINER_RELID_PREFIX(r1)-OPC_CONTAINER_RELID_PREFIX(r2);
     }
 }
-opcContainerRelation *opcContainerInsertRelation(opcContainerRelation **relation_array, uint32_t *relation_items, 
+static int relation_sort_fct(const void *a, const void *b) {
+    return relation_cmp_fct(NULL, ((const opcContainerRelation*)a)->relation_id, b, 0);
+}
+
+static opcContainerRelation *opcContainerAppendRelation(opcContainer *container, opcContainerRelation **relation_array, uint32_t *relation_items, 
+                                            uint32_t relation_id,
+                                            xmlChar *relation_type,
+                                            uint32_t target_mode, xmlChar *target_ptr) {
+    if (NULL!=ensureItem(container->io.allocator, (void**)relation_array, *relation_items, sizeof(opcContainerRelation))) {
+        opcContainerRelation *rel=&(*relation_array)[(*relation_items)++];
+        container->relation_generation++;
+        opc_bzero_mem(rel, sizeof(*rel));
+        rel->relation_id=relation_id;
+        rel->relation_type=relation_type;
+        rel->target_mode=target_mode;
+        rel->target_ptr=target_ptr;
+        return rel;
+    } else {
+        return NULL; // memory error!
+    }
+}
+
+static void opcContainerSortRelations(opcContainerRelation *relation_array, uint32_t *relation_items) {
+    // relations are appended while parsing, so the array is sorted once afterwards.
+    bool sorted=true;
+    for(uint32_t k=1;sorted && k<*relation_items;k++) {
+        sorted=(relation_cmp_fct(NULL, relation_array[k-1].relation_id, relation_array, k)<0);
+    }
+    if (!sorted) {
+        qsort(relation_array, *relation_items, sizeof(opcContainerRelation), relation_sort_fct);
+        uint32_t i=0;
+        for(uint32_t k=0;k<*relation_items;k++) {
+            if (0==i || 0!=relation_cmp_fct(NULL, relation_array[i-1].relation_id, relation_array, k)) {
+                relation_array[i++]=relation_array[k];
+            } // else duplicated id, ignored
+        }
+        *relation_items=i;
+    }
+}
+
+opcContainerRelation *opcContainerInsertRelation(opcContainer *container, opcContainerRelation **relation_array, uint32_t *relation_items, 
                                             uint32_t relation_id,
                                             xmlChar *relation_type,
                                             uint32_t target_mode, xmlChar *target_ptr) {
@@ -316,11 +517,12 @@ opcContainerRelation *opcContainerInsertRelation(opcContainerRelation **relation
             return NULL;
         }
     }
-    if (NULL!=ensureItem((void**)relation_array, *relation_items, sizeof(opcContainerRelation))) {
+    if (NULL!=ensureItem(container->io.allocator, (void**)relation_array, *relation_items, sizeof(opcContainerRelation))) {
         for (uint32_t k=(*relation_items);k>i;k--) { 
             (*relation_array)[k]=(*relation_array)[k-1];
         }
         (*relation_items)++;
+        container->relation_generation++;
         assert(i>=0 && i<(*relation_items));\
         opc_bzero_mem(&(*relation_array)[i], sizeof((*relation_array)[i]));\
         (*relation_array)[i].relation_id=relation_id;
@@ -345,6 +547,7 @@ opc_error_t opcContainerDeleteRelation(opcContainer *container, opcContainerRela
     bool ret=findItem(*relation_array, *relation_items, NULL, relation, relation_cmp_fct, &i);
     if (ret) {
         deleteItem((*relation_array), (*relation_items), i);
+        container->relation_generation++;
     }
     return err;
 }
@@ -367,6 +570,191 @@ opcContainerRelation *opcContainerFindRelationById(opcContainer *container, opcC
     return ret;
 }
 
+static inline int relationtypeentry_cmp_fct(const void *key, uint32_t v, const void *array_, uint32_t item) {
+    const opcContainerRelationTypeEntry *entry=&((const opcContainerRelationTypeEntry*)array_)[item];
+    if (key!=entry->relation_type) {
+        return ((uintptr_t)key<(uintptr_t)entry->relation_type?-1:1);
+    } else {
+        return (v<entry->relation_pos?-1:(v>entry->relation_pos?1:0));
+    }
+}
+static int relationtypeentry_sort_fct(const void *a, const void *b) {
+    return relationtypeentry_cmp_fct(((const opcContainerRelationTypeEntry*)a)->relation_type, ((const opcContainerRelationTypeEntry*)a)->relation_pos, b, 0);
+}
+
+opcContainerRelationTypeIndex *opcContainerGetRelationTypeIndex(opcContainer *container, opcContainerRelation *relation_array, uint32_t relation_items, opcContainerRelationTypeIndex *index) {
+    // the index is rebuilt lazily after any relation array changed, see relation_generation.
+    if (index->generation!=container->relation_generation || index->index_items!=relation_items) {
+        opcContainerRelationTypeEntry *index_array=index->index_array;
+        if (relation_items>index->index_items || NULL==index_array) {
+            index_array=(opcContainerRelationTypeEntry *)opcHelperRealloc(container->io.allocator, index->index_array, (relation_items>0?relation_items:1)*sizeof(opcContainerRelationTypeEntry));
+            if (NULL==index_array) return NULL; // memory error!
+            index->index_array=index_array;
+        }
+        for(uint32_t i=0;i<relation_items;i++) {
+            index_array[i].relation_type=relation_array[i].relation_type;
+            index_array[i].relation_pos=i;
+        }
+        qsort(index_array, relation_items, sizeof(opcContainerRelationTypeEntry), relationtypeentry_sort_fct);
+        index->index_items=relation_items;
+        index->generation=container->relation_generation;
+    }
+    return index;
+}
+
+static inline int incomingrelation_cmp_fct(const void *key, uint32_t v, const void *array_, uint32_t item) {
+    (void)v;
+    const opcContainerIncomingRelation *k=(const opcContainerIncomingRelation*)key;
+    const opcContainerIncomingRelation *entry=&((const opcContainerIncomingRelation*)array_)[item];
+    if (k->target!=entry->target) {
+        return ((uintptr_t)k->target<(uintptr_t)entry->target?-1:1);
+    } else if (k->source!=entry->source) {
+        return ((uintptr_t)k->source<(uintptr_t)entry->source?-1:1);
+    } else {
+        return (k->relation_id<entry->relation_id?-1:(k->relation_id>entry->relation_id?1:0));
+    }
+}
+static int incomingrelation_sort_fct(const void *a, const void *b) {
+    return incomingrelation_cmp_fct(a, 0, b, 0);
+}
+
+static bool opcContainerAppendIncomingRelations(opcContainer *container, const xmlChar *source, opcContainerRelation *relation_array, uint32_t relation_items) {
+    for(uint32_t i=0;i<relation_items;i++) {
+        if (0==relation_array[i].target_mode) {
+            if (NULL==ensureItem(container->io.allocator, (void**)&container->incoming_array, container->incoming_items, sizeof(opcContainerIncomingRelation))) {
+                return false; // memory error!
+            }
+            opcContainerIncomingRelation *in=&container->incoming_array[container->incoming_items++];
+            in->target=relation_array[i].target_ptr;
+            in->source=source;
+            in->relation_id=relation_array[i].relation_id;
+            in->deleted=false;
+        }
+    }
+    return true;
+}
+
+bool opcContainerBuildIncomingRelations(opcContainer *container) {
+    // built once on demand, afterwards kept up to date by opcContainerAdd/RemoveIncomingRelation.
+    if (!container->incoming_valid) {
+        opcContainerLoadAllRelations(container);
+        container->incoming_items=0;
+        container->incoming_deleted=0;
+        bool ret=opcContainerAppendIncomingRelations(container, NULL, container->relation_array, container->relation_items);
+        for(uint32_t i=0;ret && i<container->part_items;i++) {
+            ret=opcContainerAppendIncomingRelations(container, container->part_array[i].name, container->part_array[i].relation_array, container->part_array[i].relation_items);
+        }
+        if (ret) {
+            qsort(container->incoming_array, container->incoming_items, sizeof(opcContainerIncomingRelation), incomingrelation_sort_fct);
+        }
+        container->incoming_valid=ret;
+    }
+    return container->incoming_valid;
+}
+
+void opcContainerAddIncomingRelation(opcContainer *container, const xmlChar *source, const opcContainerRelation *rel) {
+    if (container->incoming_valid && 0==rel->target_mode) {
+        opcContainerIncomingRelation in;
+        in.target=rel->target_ptr;
+        in.source=source;
+        in.relation_id=rel->relation_id;
+        in.deleted=false;
+        uint32_t i=0;
+        if (findItem(container->incoming_array, container->incoming_items, &in, 0, incomingrelation_cmp_fct, &i)) {
+            if (container->incoming_array[i].deleted) {
+                container->incoming_array[i].deleted=false;
+                container->incoming_deleted--;
+            }
+        } else {
+            if (NULL!=ensureItem(container->io.allocator, (void**)&container->incoming_array, container->incoming_items, sizeof(opcContainerIncomingRelation))) {
+                ensureGap(container->incoming_array, container->incoming_items, i);
+                container->incoming_array[i]=in;
+            } else {
+                container->incoming_valid=false; // memory error, rebuilt on demand
+            }
+        }
+    }
+}
+
+void opcContainerCompactIncomingRelations(opcContainer *container) {
+    if (2*container->incoming_deleted>container->incoming_items) {
+        uint32_t j=0;
+        for(uint32_t k=0;k<container->incoming_items;k++) {
+            if (!container->incoming_array[k].deleted) {
+                container->incoming_array[j++]=container->incoming_array[k];
+            }
+        }
+        container->incoming_items=j;
+        container->incoming_deleted=0;
+    }
+}
+
+void opcContainerRemoveIncomingRelation(opcContainer *container, const xmlChar *source, const opcContainerRelation *rel) {
+    if (container->incoming_valid && 0==rel->target_mode) {
+        opcContainerIncomingRelation in;
+        in.target=rel->target_ptr;
+        in.source=source;
+        in.relation_id=rel->relation_id;
+        uint32_t i=0;
+        if (findItem(container->incoming_array, container->incoming_items, &in, 0, incomingrelation_cmp_fct, &i) && !container->incoming_array[i].deleted) {
+            // entries are only marked, so deleting a part costs O(degree) and not O(incoming_items)
+            container->incoming_array[i].deleted=true;
+            container->incoming_deleted++;
+        }
+        opcContainerCompactIncomingRelations(container);
+    }
+}
+
+opcContainerIncomingRelation *opcContainerFindIncomingRelation(opcContainer *container, const xmlChar *target, const xmlChar *source, opcRelation relation) {
+    // returns the first relation to target or, if relation is valid, the one after (source, relation).
+    opcContainerIncomingRelation *ret=NULL;
+    if (opcContainerBuildIncomingRelations(container)) {
+        opcContainerIncomingRelation in;
+        in.target=target;
+        in.source=source;
+        in.relation_id=relation;
+        uint32_t i=0;
+        if (OPC_RELATION_INVALID==relation) {
+            in.source=NULL;
+            in.relation_id=0;
+            findItem(container->incoming_array, container->incoming_items, &in, 0, incomingrelation_cmp_fct, &i);
+        } else if (findItem(container->incoming_array, container->incoming_items, &in, 0, incomingrelation_cmp_fct, &i)) {
+            i++;
+        }
+        while (i<container->incoming_items && target==container->incoming_array[i].target && container->incoming_array[i].deleted) {
+            i++;
+        }
+        if (i<container->incoming_items && target==container->incoming_array[i].target) {
+            ret=&container->incoming_array[i];
+        }
+    }
+    return ret;
+}
+
+opcContainerRelation *opcContainerFindRelationByType(opcContainer *container, opcContainerRelation *relation_array, uint32_t relation_items, opcContainerRelationTypeIndex *index, const xmlChar *type, opcContainerRelation *after) {
+    opcContainerRelation *ret=NULL;
+    if (NULL!=after) {
+        type=after->relation_type; // already interned
+    } else if (NULL!=type) {
+        opcContainerRelationType *rel_type=opcContainerInsertRelationType(container, type, false);
+        type=(NULL!=rel_type?rel_type->type:NULL);
+    }
+    if (NULL!=type && NULL!=(index=opcContainerGetRelationTypeIndex(container, relation_array, relation_items, index))) {
+        uint32_t i=0;
+        if (NULL==after) {
+            findItem(index->index_array, index->index_items, type, 0, relationtypeentry_cmp_fct, &i); // first entry of type
+        } else if (findItem(index->index_array, index->index_items, type, (uint32_t)(after-relation_array), relationtypeentry_cmp_fct, &i)) {
+            i++;
+        } else {
+            i=index->index_items; // after is not in relation_array
+        }
+        if (i<index->index_items && type==index->index_array[i].relation_type) {
+            ret=&relation_array[index->index_array[i].relation_pos];
+        }
+    }
+    return ret;
+}
+
 
 
 static void opc_container_normalize_part_to_helper_buffer(xmlChar *buf, int buf_len,
@@ -453,13 +841,13 @@ static void opcConstainerParseRels(opcContainer *c, const xmlChar *partName, opc
                                 opcContainerPart *target_part=opcContainerInsertPart(c, target_part_name, false);
                                 mce_errorf(&reader, NULL==target_part, MCE_ERROR_VALIDATION, "Referenced part %s (%s;%s) does not exists!", target_part_name, partName, target);
     //                            printf("%s %i %s %s\n", id, counter, rel_type->type, target_part->name);
-                                opcContainerRelation *rel=opcContainerInsertRelation(relation_array, relation_items, rel_id, rel_type->type, 0, target_part->name);
-                                assert(NULL!=rel);
+                                opcContainerRelation *rel=opcContainerAppendRelation(c, relation_array, relation_items, rel_id, rel_type->type, 0, target_part->name);
+                                mce_error(&reader, NULL==rel, MCE_ERROR_MEMORY, NULL);
                             } else if (0==xmlStrcasecmp(mode, BAD_CAST("External"))) {
                                 opcContainerExternalRelation *ext_rel=insertExternalRelation(c, target, true);
                                 mce_error(&reader, NULL==ext_rel, MCE_ERROR_MEMORY, NULL);
-                                opcContainerRelation *rel=opcContainerInsertRelation(relation_array, relation_items, rel_id, rel_type->type, 1, ext_rel->target);
-                                assert(NULL!=rel);
+                                opcContainerRelation *rel=opcContainerAppendRelation(c, relation_array, relation_items, rel_id, rel_type->type, 1, ext_rel->target);
+                                mce_error(&reader, NULL==rel, MCE_ERROR_MEMORY, NULL);
                             } else {
                                 mce_errorf(&reader, true, MCE_ERROR_VALIDATION, "TargetMode %s unknown!\n", mode);
                             }
@@ -470,42 +858,70 @@ static void opcConstainerParseRels(opcContainer *c, const xmlChar *partName, opc
             } mce_end_element(&reader);
         } mce_end_document(reader);
         OPC_ENSURE(0==mceTextReaderCleanup(&reader));
+        opcContainerSortRelations(*relation_array, relation_items);
     }
 }
 
 static const xmlChar OPC_SEGMENT_CONTENTTYPES[]={'[', 'C', 'o', 'n', 't', 'e', 'n', 't', '_', 'T', 'y', 'p', 'e', 's', ']', '.', 'x', 'm', 'l', 0};
 static const xmlChar OPC_SEGMENT_ROOTRELS[]={0};
 
-static opc_error_t opcContainerFree(opcContainer *c) {
-    if (NULL!=c) {
-        for(uint32_t i=0;i<c->extension_items;i++) {
-            xmlFree(c->extension_array[i].extension);
-        }
-        for(uint32_t i=0;i<c->type_items;i++) {
-            xmlFree(c->type_array[i].type);
-        }
-        for(uint32_t i=0;i<c->relationtype_items;i++) {
-            xmlFree(c->relationtype_array[i].type);
+void opcContainerLoadRelations(opcContainer *container, opcContainerPart *part) {
+    // relations are parsed on first access. part==NULL denotes the root relations.
+    if (NULL==part) {
+        if (!container->relations_loaded) {
+            container->relations_loaded=true;
+            if ((uint32_t)-1!=container->rels_segment_id) {
+                opcConstainerParseRels(container, OPC_SEGMENT_ROOTRELS, &container->relation_array, &container->relation_items);
+            }
         }
-        for(uint32_t i=0;i<c->externalrelation_items;i++) {
-            xmlFree(c->externalrelation_array[i].target);
+    } else if (!part->relations_loaded) {
+        part->relations_loaded=true;
+        if ((uint32_t)-1!=part->rel_segment_id) {
+            opcConstainerParseRels(container, part->name, &part->relation_array, &part->relation_items);
         }
+    }
+}
+
+void opcContainerLoadAllRelations(opcContainer *container) {
+    opcContainerLoadRelations(container, NULL);
+    for(uint32_t i=0;i<container->part_items;i++) {
+        opcContainerLoadRelations(container, &container->part_array[i]);
+    }
+}
+
+static bool opcContainerBuildAllRelationTypeIndices(opcContainer *container) {
+    bool ret=(NULL!=opcContainerGetRelationTypeIndex(container, container->relation_array, container->relation_items, &container->relation_type_index));
+    for(uint32_t i=0;ret && i<container->part_items;i++) {
+        opcContainerPart *part=&container->part_array[i];
+        ret=(NULL!=opcContainerGetRelationTypeIndex(container, part->relation_array, part->relation_items, &part->relation_type_index));
+    }
+    return ret;
+}
+
+static void opcContainerFreeMem(opcContainer *c) {
+    opcAllocator const allocator=c->allocator; // c is released by its own allocator
+    opcHelperFree(NULL!=allocator._malloc?&allocator:NULL, c);
+}
+
+static opc_error_t opcContainerFree(opcContainer *c) {
+    if (NULL!=c) {
         for(uint32_t i=0;i<c->part_items;i++) {
-            xmlFree(c->part_array[i].relation_array);
-            xmlFree(c->part_array[i].name);
-        }
-        for(uint32_t i=0;i<c->relprefix_items;i++) {
-            xmlFree(c->relprefix_array[i].prefix);
-        }
-        if (NULL!=c->part_array) xmlFree(c->part_array);
-        if (NULL!=c->relprefix_array) xmlFree(c->relprefix_array);
-        if (NULL!=c->type_array) xmlFree(c->type_array);
-        if (NULL!=c->extension_array) xmlFree(c->extension_array);
-        if (NULL!=c->relationtype_array) xmlFree(c->relationtype_array);
-        if (NULL!=c->externalrelation_array) xmlFree(c->externalrelation_array);
-        if (NULL!=c->relation_array) xmlFree(c->relation_array);
+            opcHelperFree(c->io.allocator, c->part_array[i].relation_array);
+            if (NULL!=c->part_array[i].relation_type_index.index_array) opcHelperFree(c->io.allocator, c->part_array[i].relation_type_index.index_array);
+        }
+        if (NULL!=c->part_array) opcHelperFree(c->io.allocator, c->part_array);
+        if (NULL!=c->part_hash_array) opcHelperFree(c->io.allocator, c->part_hash_array);
+        if (NULL!=c->relprefix_array) opcHelperFree(c->io.allocator, c->relprefix_array);
+        if (NULL!=c->type_array) opcHelperFree(c->io.allocator, c->type_array);
+        if (NULL!=c->extension_array) opcHelperFree(c->io.allocator, c->extension_array);
+        if (NULL!=c->relationtype_array) opcHelperFree(c->io.allocator, c->relationtype_array);
+        if (NULL!=c->externalrelation_array) opcHelperFree(c->io.allocator, c->externalrelation_array);
+        if (NULL!=c->relation_array) opcHelperFree(c->io.allocator, c->relation_array);
+        if (NULL!=c->relation_type_index.index_array) opcHelperFree(c->io.allocator, c->relation_type_index.index_array);
+        if (NULL!=c->incoming_array) opcHelperFree(c->io.allocator, c->incoming_array);
         opcZipClose(c->storage, NULL);
-        xmlFree(c);
+        opcContainerFreeStrings(c);
+        opcContainerFreeMem(c);
     }
     return OPC_ERROR_NONE;
 }
@@ -595,6 +1011,7 @@ static void opcContainerRelDump(opcContainer *c,
 }
 
 opc_error_t opcContainerDump(opcContainer *c, FILE *out) {
+    opcContainerLoadAllRelations(c);
     uint32_t max_content_type_len=xmlStrlen(BAD_CAST("Content Types")); 
     for(uint32_t i=0;i<c->type_items;i++) { 
         uint32_t const len=xmlStrlen(c->type_array[i].type); 
@@ -827,13 +1244,13 @@ opcContainerInputStream* opcContainerOpenInputStreamEx(opcContainer *container,
     opcContainerGetOutputPartSegment(container, name, rels_segment, &first_segment, &last_segment);
     assert(NULL!=first_segment);
     if (NULL!=first_segment) {
-        ret=(opcContainerInputStream*)xmlMalloc(sizeof(opcContainerInputStream));
+        ret=(opcContainerInputStream*)opcHelperMalloc(container->io.allocator, sizeof(opcContainerInputStream));
         if (NULL!=ret) {
             opc_bzero_mem(ret, sizeof(*ret));
             ret->container=container;
             ret->stream=opcZipOpenInputStream(container->storage, *first_segment);
             if (NULL==ret->stream) {
-                xmlFree(ret); ret=NULL; // error
+                opcHelperFree(container->io.allocator, ret); ret=NULL; // error
             }
         }
     }
@@ -844,13 +1261,37 @@ opcContainerInputStream* opcContainerOpenInputStream(opcContainer *container, co
     return opcContainerOpenInputStreamEx(container, name, false);
 }
 
+opc_error_t opcContainerMapPart(opcContainer *container, opcPart part, const uint8_t **data, opc_ofs_t *data_len) {
+    assert(NULL!=data && NULL!=data_len);
+    opcContainerPart *cp=(OPC_PART_INVALID!=part?opcContainerInsertPart(container, part, false):NULL);
+    if (NULL!=cp && cp->first_segment_id<container->storage->segment_items) {
+        return opcZipMapSegment(container->storage, cp->first_segment_id, data, data_len);
+    } else {
+        *data=NULL; *data_len=0;
+        return OPC_ERROR_STREAM;
+    }
+}
+
 uint32_t opcContainerReadInputStream(opcContainerInputStream* stream, uint8_t *buffer, uint32_t buffer_len) {
     return opcZipReadInputStream(stream->container->storage, stream->stream, buffer, buffer_len);
 }
 
+opc_error_t opcContainerSeekInputStream(opcContainerInputStream* stream, opc_ofs_t ofs) {
+    return opcZipSeekInputStream(stream->container->storage, stream->stream, ofs);
+}
+
+opc_error_t opcContainerBuildSeekIndex(opcContainer *container, opcPart part) {
+    opcContainerPart *cp=(OPC_PART_INVALID!=part?opcContainerInsertPart(container, part, false):NULL);
+    if (NULL!=cp && cp->first_segment_id<container->storage->segment_items) {
+        return opcZipBuildSeekIndex(container->storage, cp->first_segment_id);
+    } else {
+        return OPC_ERROR_STREAM;
+    }
+}
+
 opc_error_t opcContainerCloseInputStream(opcContainerInputStream* stream) {
     opc_error_t ret=opcZipCloseInputStream(stream->container->storage, stream->stream);
-    xmlFree(stream);
+    opcHelperFree(stream->container->io.allocator, stream);
     return ret;
 }
 
@@ -864,46 +1305,53 @@ opcCompressionOption_t opcContainerGetInputStreamCompressionOption(opcContainerI
 }
 
 
+static void opcContainerCompressionMethod(opcCompressionOption_t compression_option, uint16_t *compression_method, uint16_t *bit_flag) {
+    *compression_method=0; // no compression by default
+    *bit_flag=0;
+    switch(compression_option) {
+    case OPC_COMPRESSIONOPTION_NONE:
+        break;
+    case OPC_COMPRESSIONOPTION_NORMAL:
+        *compression_method=8;
+        *bit_flag|=0<<1;
+        break;
+    case OPC_COMPRESSIONOPTION_MAXIMUM:
+        *compression_method=8;
+        *bit_flag|=1<<1;
+        break;
+    case OPC_COMPRESSIONOPTION_FAST:
+        *compression_method=8;
+        *bit_flag|=2<<1;
+        break;
+    case OPC_COMPRESSIONOPTION_SUPERFAST:
+        *compression_method=8;
+        *bit_flag|=3<<1;
+        break;
+    }
+}
+
 opcContainerOutputStream* opcContainerCreateOutputStreamEx(opcContainer *container, const xmlChar *name, bool rels_segment, opcCompressionOption_t compression_option) {
     opcContainerOutputStream* ret=NULL;
     uint32_t *first_segment=NULL;
     uint32_t *last_segment=NULL;
     opcContainerGetOutputPartSegment(container, name, rels_segment, &first_segment, &last_segment);
     assert(NULL!=first_segment);
+    if (NULL!=first_segment && NULL!=container->transition_temp_name && (uint32_t)-1!=*first_segment) {
+        opcZipSegmentDelete(container->storage, first_segment, last_segment, NULL); // the original is never written, see OPC_OPEN_TRANSITION
+    }
     if (NULL!=first_segment) {
-        ret=(opcContainerOutputStream*)xmlMalloc(sizeof(opcContainerOutputStream));
+        ret=(opcContainerOutputStream*)opcHelperMalloc(container->io.allocator, sizeof(opcContainerOutputStream));
         if (NULL!=ret) {
             opc_bzero_mem(ret, sizeof(*ret));
             ret->container=container;
-            uint16_t compression_method=0; // no compression by default
+            uint16_t compression_method=0;
             uint16_t bit_flag=0;
-            switch(compression_option) {
-            case OPC_COMPRESSIONOPTION_NONE:
-                assert(0==compression_method);
-                assert(0==bit_flag);
-                break;
-            case OPC_COMPRESSIONOPTION_NORMAL:
-                compression_method=8;
-                bit_flag|=0<<1;
-                break;
-            case OPC_COMPRESSIONOPTION_MAXIMUM:
-                compression_method=8;
-                bit_flag|=1<<1;
-                break;
-            case OPC_COMPRESSIONOPTION_FAST:
-                compression_method=8;
-                bit_flag|=2<<1;
-                break;
-            case OPC_COMPRESSIONOPTION_SUPERFAST:
-                compression_method=8;
-                bit_flag|=3<<1;
-                break;
-            }
+            opcContainerCompressionMethod(compression_option, &compression_method, &bit_flag);
             ret->stream=opcZipCreateOutputStream(container->storage, first_segment, name, rels_segment, 0, 0, compression_method, bit_flag);
             ret->partName=name;
             ret->rels_segment=rels_segment;
             if (NULL==ret->stream) {
-                xmlFree(ret); ret=NULL; // error
+                opcHelperFree(container->io.allocator, ret); ret=NULL; // error
             }
         }
     }
@@ -914,6 +1362,36 @@ opcContainerOutputStream* opcContainerCreateOutputStream(opcContainer *container
     return opcContainerCreateOutputStreamEx(container, name, false, compression_option);
 }
 
+opcContainerOutputStream* opcContainerCreateDetachedOutputStream(opcContainer *container, const xmlChar *name, opcCompressionOption_t compression_option) {
+    opcContainerOutputStream* ret=NULL;
+    uint32_t *first_segment=NULL;
+    uint32_t *last_segment=NULL;
+    opcContainerGetOutputPartSegment(container, name, false, &first_segment, &last_segment);
+    assert(NULL!=first_segment);
+    if (NULL!=first_segment) {
+        ret=(opcContainerOutputStream*)opcHelperMalloc(container->io.allocator, sizeof(opcContainerOutputStream));
+        if (NULL!=ret) {
+            opc_bzero_mem(ret, sizeof(*ret));
+            ret->container=container;
+            uint16_t compression_method=0;
+            uint16_t bit_flag=0;
+            opcContainerCompressionMethod(compression_option, &compression_method, &bit_flag);
+            ret->stream=opcZipCreateDetachedOutputStream(container->storage, compression_method, bit_flag);
+            ret->partName=name;
+            ret->rels_segment=false;
+            ret->detached=true;
+            if (NULL==ret->stream) {
+                opcHelperFree(container->io.allocator, ret); ret=NULL; // error
+            }
+        }
+    }
+    return ret;
+}
+
+opc_error_t opcContainerSetOutputStreamThreads(opcContainerOutputStream* stream, uint32_t threads) {
+    return opcZipSetOutputStreamThreads(stream->container->storage, stream->stream, threads);
+}
+
 uint32_t opcContainerWriteOutputStream(opcContainerOutputStream* stream, const uint8_t *buffer, uint32_t buffer_len) {
     return opcZipWriteOutputStream(stream->container->storage, stream->stream, buffer, buffer_len);
 }
@@ -924,32 +1402,64 @@ opc_error_t opcContainerCloseOutputStream(opcContainerOutputStream* stream) {
     uint32_t *last_segment=NULL;
     opcContainerGetOutputPartSegment(stream->container, stream->partName, stream->rels_segment, &first_segment, &last_segment);
     assert(NULL!=first_segment);
+    if (NULL!=first_segment && stream->detached) {
+        ret=opcZipAttachOutputStream(stream->container->storage, stream->stream, stream->partName, stream->rels_segment);
+        if (OPC_ERROR_NONE!=ret) {
+            // release the stream and whatever segment the attach created; the part keeps its old segments
+            uint32_t segment_id=-1;
+            opcZipCloseOutputStream(stream->container->storage, stream->stream, &segment_id);
+            if ((uint32_t)-1!=segment_id) {
+                opcZipSegmentDelete(stream->container->storage, &segment_id, NULL, NULL);
+            }
+            opcHelperFree(stream->container->io.allocator, stream);
+            return ret;
+        }
+        if ((uint32_t)-1!=*first_segment) {
+            opcZipSegmentDelete(stream->container->storage, first_segment, last_segment, NULL); // replaced by the attached segment
+        }
+    }
     if (NULL!=first_segment) {
         ret=opcZipCloseOutputStream(stream->container->storage, stream->stream, first_segment);
         if (NULL!=last_segment) {
             *last_segment=*first_segment; 
         }
-        xmlFree(stream);
+        opcHelperFree(stream->container->io.allocator, stream);
     }
     return ret;
 }
 
-static opc_error_t opcContainerInit(opcContainer *c, opcContainerOpenMode mode, void *userContext) {
+static opc_error_t opcContainerInit(opcContainer *c, opcContainerOpenMode mode, void *userContext, const opcAllocator *allocator) {
     opc_bzero_mem(c, sizeof(*c));
+    if (NULL!=allocator) {
+        c->allocator=*allocator;
+    }
     c->content_types_segment_id=-1;
     c->rels_segment_id=-1;
-    c->mode=mode;
+    c->mode=(opcContainerOpenMode)(mode & ~(OPC_OPEN_MMAP | OPC_OPEN_THREAD_SAFE | OPC_OPEN_EAGER_RELATIONS | OPC_OPEN_VERIFY_CRC | OPC_OPEN_STREAMING)); // flags are handled on opening
+    c->thread_safe=(OPC_OPEN_THREAD_SAFE==(mode & OPC_OPEN_THREAD_SAFE));
+    c->eager_relations=(OPC_OPEN_EAGER_RELATIONS==(mode & OPC_OPEN_EAGER_RELATIONS));
+    c->verify_crc=(OPC_OPEN_VERIFY_CRC==(mode & OPC_OPEN_VERIFY_CRC));
+    c->streaming=(OPC_OPEN_STREAMING==(mode & OPC_OPEN_STREAMING));
     c->userContext=userContext;
     return OPC_ERROR_NONE;
 }
 
 static opcContainer *opcContainerLoadFromZip(opcContainer *c) {
     assert(NULL==c->storage); // loaded twice??
-    c->storage=opcZipCreate(&c->io);
+    c->io.allocator=(NULL!=c->allocator._malloc?&c->allocator:NULL); // reset by opcFileInitIO*
+    if (!c->thread_safe || (OPC_OPEN_READ_ONLY==c->mode && NULL!=c->io._ioreadat)) { // threads can not share a file position
+        c->storage=opcZipCreate(&c->io);
+    }
     if (NULL!=c->storage) {
-        if (OPC_ERROR_NONE==opcZipLoader(&c->io, c, opcContainerZipLoaderLoadSegment)) {
+        c->storage->verify_crc=c->verify_crc;
+        c->storage->streaming=c->streaming;
+        c->part_array_unsorted=opcContainerBuildPartHash(c); // parts are sorted once everything is loaded
+        if (c->streaming?OPC_OPEN_WRITE_ONLY==c->mode /* nothing to load, nothing to read */
+                        :OPC_ERROR_NONE==opcZipDirectoryLoader(&c->io, c, opcContainerZipLoaderLoadSegment)) {
             // successfull loaded!
-            OPC_ENSURE(OPC_ERROR_NONE==opcZipGC(c->storage));
+            if (OPC_OPEN_READ_ONLY!=c->mode) {
+                OPC_ENSURE(OPC_ERROR_NONE==opcZipGC(c->storage));
+            }
             if (-1!=c->content_types_segment_id) {
                 mceTextReader_t reader;
                 if (OPC_ERROR_NONE==opcXmlReaderOpenEx(c, &reader, OPC_SEGMENT_CONTENTTYPES, false, NULL, NULL, 0)) {
@@ -1015,23 +1525,24 @@ static opcContainer *opcContainerLoadFromZip(opcContainer *c) {
                     OPC_ENSURE(0==mceTextReaderCleanup(&reader));
                 }
             }
-            if (NULL!=c && -1!=c->rels_segment_id) {
-                opcConstainerParseRels(c, OPC_SEGMENT_ROOTRELS, &c->relation_array, &c->relation_items);
+            if (c->part_array_unsorted) {
+                opcContainerSortParts(c);
             }
-            for(uint32_t i=0;NULL!=c && i<c->part_items;i++) {
-                opcContainerPart *part=&c->part_array[i];
-                if (-1!=part->rel_segment_id) {
-                    opcConstainerParseRels(c, part->name, &part->relation_array, &part->relation_items);
-                }
+            if (NULL!=c && (c->eager_relations || c->thread_safe)) { // otherwise relations are parsed on demand
+                opcContainerLoadAllRelations(c);
+            }
+            if (NULL!=c && c->thread_safe && (OPC_ERROR_NONE!=opcZipLoadAllHeaders(c->storage) || (!c->part_hash_valid && !opcContainerBuildPartHash(c)) || !opcContainerBuildAllRelationTypeIndices(c) || !opcContainerBuildIncomingRelations(c))) {
+                opcContainerClose(c, OPC_CLOSE_NOW); c=NULL; // otherwise opening a stream or finding a part would modify the container
             }
         } else {
-            opcFileCleanupIO(&c->io); // error loading
-            opcZipClose(c->storage, NULL);
-            xmlFree(c); c=NULL;
+            opcZipClose(c->storage, NULL); // error loading, closes the io as well
+            if (NULL!=c->part_hash_array) opcHelperFree(c->io.allocator, c->part_hash_array);
+            opcContainerFreeStrings(c);
+            opcContainerFreeMem(c); c=NULL;
         }
     } else {
         opcFileCleanupIO(&c->io); // error creating zip
-        xmlFree(c); c=NULL;
+        opcContainerFreeMem(c); c=NULL;
     }
     return c;
 }
@@ -1042,32 +1553,107 @@ static uint32_t opcContainerGenerateFileFlags(opcContainerOpenMode mode) {
     return flags;
 }
 
+static opc_error_t opcContainerInitIOTemplate(opcContainer *c, const xmlChar *fileName, const xmlChar *destName) {
+    // the template is copied raw, i.e. no part is inflated or deflated. Afterwards the copy is modified like in 
+    // READ/WRITE mode, so only the parts which are written again get compressed.
+    opc_error_t err=OPC_ERROR_STREAM;
+    if (NULL!=destName && 0!=xmlStrcmp(fileName, destName)) {
+        opcIO_t src;
+        opc_bzero_mem(&src, sizeof(src));
+        if (OPC_ERROR_NONE==opcFileInitIOMmap(&src, fileName, OPC_FILE_READ)
+            || OPC_ERROR_NONE==opcFileInitIOFd(&src, fileName, OPC_FILE_READ)
+            || OPC_ERROR_NONE==opcFileInitIOFile(&src, fileName, OPC_FILE_READ)) {
+            if (OPC_ERROR_NONE==(err=opcFileInitIOFile(&c->io, destName, OPC_FILE_WRITE | OPC_FILE_READ | OPC_FILE_TRUNC))
+                && OPC_ERROR_NONE!=(err=opcFileCopyIO(&c->io, &src))) {
+                opcFileCleanupIO(&c->io);
+            }
+            opcFileCleanupIO(&src);
+        }
+    }
+    c->mode=OPC_OPEN_READ_WRITE;
+    return err;
+}
+
+static opc_ofs_t opcContainerAppendOffset(opcContainer *c) {
+    // new segments are appended behind the last one, the central directory is not needed anymore once loaded.
+    opcZip *zip=c->storage;
+    return (zip->segment_items>0?zip->segment_array[zip->segment_items-1].stream_ofs+zip->segment_array[zip->segment_items-1].segment_size:0);
+}
+
 opcContainer* opcContainerOpen(const xmlChar *fileName, 
                                opcContainerOpenMode mode, 
                                void *userContext, 
                                const xmlChar *destName) {
-    opcContainer*c=(opcContainer*)xmlMalloc(sizeof(opcContainer));
+    return opcContainerOpenEx(fileName, mode, userContext, destName, NULL);
+}
+
+opcContainer* opcContainerOpenEx(const xmlChar *fileName, 
+                                 opcContainerOpenMode mode, 
+                                 void *userContext, 
+                                 const xmlChar *destName,
+                                 const opcAllocator *allocator) {
+    opcContainer*c=(opcContainer*)opcHelperMalloc(allocator, sizeof(opcContainer));
     if (NULL!=c) {
-        OPC_ENSURE(OPC_ERROR_NONE==opcContainerInit(c, mode, userContext));
-        if (OPC_ERROR_NONE==opcFileInitIOFile(&c->io, fileName, opcContainerGenerateFileFlags(mode))) {
+        OPC_ENSURE(OPC_ERROR_NONE==opcContainerInit(c, mode, userContext, allocator));
+        if (OPC_OPEN_TEMPLATE==c->mode) {
+            if (OPC_ERROR_NONE==opcContainerInitIOTemplate(c, fileName, destName)) {
+                c=opcContainerLoadFromZip(c);
+            } else {
+                opcContainerFreeMem(c); c=NULL; // error copying the template
+            }
+        } else if (OPC_OPEN_TRANSITION==c->mode) {
+            xmlChar temp_name[OPC_MAX_PATH];
+            if (NULL==destName && OPC_ERROR_NONE==opcFileTempName(temp_name, sizeof(temp_name), fileName)) {
+                destName=temp_name;
+            }
+            // fileName is only read, the new container is written to destName on closing, see opcContainerCommit.
+            c->mode=OPC_OPEN_READ_WRITE;
+            if (NULL!=destName && 0!=xmlStrcmp(fileName, destName)
+                && (OPC_ERROR_NONE==opcFileInitIOMmap(&c->io, fileName, OPC_FILE_READ)
+                 || OPC_ERROR_NONE==opcFileInitIOFd(&c->io, fileName, OPC_FILE_READ)
+                 || OPC_ERROR_NONE==opcFileInitIOFile(&c->io, fileName, OPC_FILE_READ))) {
+                c=opcContainerLoadFromZip(c);
+                if (NULL!=c && (OPC_ERROR_NONE!=opcFileInitIOOverlay(&c->io, opcContainerAppendOffset(c))
+                             || NULL==(c->transition_file_name=opcContainerStrdup(c, fileName)) 
+                             || NULL==(c->transition_temp_name=opcContainerStrdup(c, destName)))) {
+                    c->transition_temp_name=NULL;
+                    c->mode=OPC_OPEN_READ_ONLY; // nothing must be written
+                    opcContainerClose(c, OPC_CLOSE_NOW); c=NULL;
+                }
+            } else {
+                opcContainerFreeMem(c); c=NULL; // error opening fileName
+            }
+            if (NULL==c && NULL!=destName && 0!=xmlStrcmp(fileName, destName)) {
+                remove((const char *)destName); // the original is left as it is
+            }
+        } else if ((OPC_OPEN_MMAP==(mode & OPC_OPEN_MMAP) && OPC_ERROR_NONE==opcFileInitIOMmap(&c->io, fileName, opcContainerGenerateFileFlags(c->mode)))
+            || (OPC_OPEN_READ_ONLY==c->mode && OPC_ERROR_NONE==opcFileInitIOFd(&c->io, fileName, opcContainerGenerateFileFlags(c->mode))) // streams read via pread
+            || OPC_ERROR_NONE==opcFileInitIOFile(&c->io, fileName, opcContainerGenerateFileFlags(c->mode))) {
             c=opcContainerLoadFromZip(c);
         } else {
-            xmlFree(c); c=NULL; // error init io
+            opcContainerFreeMem(c); c=NULL; // error init io
         }
     }
     return c;
 }
 
-opcContainer* opcContainerOpenMem(const uint8_t *data, uint32_t data_len,
+opcContainer* opcContainerOpenMem(const uint8_t *data, size_t data_len,
                                   opcContainerOpenMode mode, 
                                   void *userContext) {
-    opcContainer*c=(opcContainer*)xmlMalloc(sizeof(opcContainer));
+    return opcContainerOpenMemEx(data, data_len, mode, userContext, NULL);
+}
+
+opcContainer* opcContainerOpenMemEx(const uint8_t *data, size_t data_len,
+                                    opcContainerOpenMode mode, 
+                                    void *userContext,
+                                    const opcAllocator *allocator) {
+    opcContainer*c=(opcContainer*)opcHelperMalloc(allocator, sizeof(opcContainer));
     if (NULL!=c) {
-        OPC_ENSURE(OPC_ERROR_NONE==opcContainerInit(c, mode, userContext));
+        OPC_ENSURE(OPC_ERROR_NONE==opcContainerInit(c, mode, userContext, allocator));
         if (OPC_ERROR_NONE==opcFileInitIOMemory(&c->io, data, data_len, opcContainerGenerateFileFlags(mode))) {
             c=opcContainerLoadFromZip(c);
         } else {
-            xmlFree(c); c=NULL; // error init io
+            opcContainerFreeMem(c); c=NULL; // error init io
         }
     }
     return c;
@@ -1080,16 +1666,30 @@ opcContainer* opcContainerOpenIO(opcFileReadCallback *ioread,
                                  opcFileTrimCallback *iotrim,
                                  opcFileFlushCallback *ioflush,
                                  void *iocontext,
-                                 size_t file_size,
+                                 opc_ofs_t file_size,
                                  opcContainerOpenMode mode, 
                                  void *userContext) {
-    opcContainer*c=(opcContainer*)xmlMalloc(sizeof(opcContainer));
+    return opcContainerOpenIOEx(ioread, iowrite, ioclose, ioseek, iotrim, ioflush, iocontext, file_size, mode, userContext, NULL);
+}
+
+opcContainer* opcContainerOpenIOEx(opcFileReadCallback *ioread,
+                                   opcFileWriteCallback *iowrite,
+                                   opcFileCloseCallback *ioclose,
+                                   opcFileSeekCallback *ioseek,
+                                   opcFileTrimCallback *iotrim,
+                                   opcFileFlushCallback *ioflush,
+                                   void *iocontext,
+                                   opc_ofs_t file_size,
+                                   opcContainerOpenMode mode, 
+                                   void *userContext,
+                                   const opcAllocator *allocator) {
+    opcContainer*c=(opcContainer*)opcHelperMalloc(allocator, sizeof(opcContainer));
     if (NULL!=c) {
-        OPC_ENSURE(OPC_ERROR_NONE==opcContainerInit(c, mode, userContext));
+        OPC_ENSURE(OPC_ERROR_NONE==opcContainerInit(c, mode, userContext, allocator));
         if (OPC_ERROR_NONE==opcFileInitIO(&c->io, ioread, iowrite, ioclose, ioseek, iotrim, ioflush, iocontext, file_size, opcContainerGenerateFileFlags(mode))) {
             c=opcContainerLoadFromZip(c);
         } else {
-            xmlFree(c); c=NULL; // error init io
+            opcContainerFreeMem(c); c=NULL; // error init io
         }
     }
     return c;
@@ -1226,20 +1826,124 @@ static void opcContainerWriteAllRels(opcContainer *c) {
     }
 }
 
-opc_error_t opcContainerCommit(opcContainer *c, bool trim) {
+typedef struct OPC_CONTAINER_DEFRAG_STRUCT {
+    opcContainer *c;
+    uint32_t *segment_array; // the new order
+    uint32_t segment_items;
+    uint32_t *media_array; // parts which are no XML go last
+    uint32_t media_items;
+    bool *placed_array; // [part_items]
+} opcContainerDefrag;
+
+static void opcContainerDefragPlace(opcContainerDefrag *defrag, opcContainerPart *part, bool media) {
+    uint32_t const i=(uint32_t)(part-defrag->c->part_array);
+    if (!defrag->placed_array[i]) {
+        defrag->placed_array[i]=true;
+        if (media) {
+            defrag->media_array[defrag->media_items++]=i;
+        } else {
+            // the part is directly followed by its relations
+            if ((uint32_t)-1!=part->first_segment_id) defrag->segment_array[defrag->segment_items++]=part->first_segment_id;
+            if ((uint32_t)-1!=part->rel_segment_id) defrag->segment_array[defrag->segment_items++]=part->rel_segment_id;
+        }
+    }
+}
+
+static bool opcContainerDefragIsMedia(opcContainer *c, opcContainerPart *part) {
+    const xmlChar *type=opcPartGetType(c, part->name);
+    int const len=(NULL!=type?xmlStrlen(type):0);
+    return len<3 || 0!=xmlStrcasecmp(type+len-3, BAD_CAST("xml")); // e.g. application/xml or ...+xml
+}
+
+static opc_error_t opcContainerDefragVisit(void *userctx, opcPart source, opcRelation relation, opcPart part, uint32_t depth) {
+    (void)source; (void)relation; (void)depth;
+    opcContainerDefrag *defrag=(opcContainerDefrag *)userctx;
+    opcContainerPart *cp=opcContainerInsertPart(defrag->c, part, false);
+    if (NULL!=cp) {
+        opcContainerDefragPlace(defrag, cp, opcContainerDefragIsMedia(defrag->c, cp));
+    }
+    return OPC_ERROR_NONE;
+}
+
+static opc_error_t opcContainerDefragSegments(opcContainer *c, opcIO_t *io) {
+    // content types and root relations first, then the parts in depth first order of the relations, media last.
+    // The segments are moved in place, or written to io in this order if given (see opcZipCommitTo).
+    opc_error_t ret=OPC_ERROR_MEMORY;
+    opcContainerDefrag defrag;
+    opc_bzero_mem(&defrag, sizeof(defrag));
+    defrag.c=c;
+    defrag.segment_array=(uint32_t *)opcHelperMalloc(c->io.allocator, (2*c->part_items+2)*sizeof(uint32_t));
+    defrag.media_array=(uint32_t *)opcHelperMalloc(c->io.allocator, (c->part_items+1)*sizeof(uint32_t));
+    defrag.placed_array=(bool *)opcHelperMalloc(c->io.allocator, (c->part_items+1)*sizeof(bool));
+    if (NULL!=defrag.segment_array && NULL!=defrag.media_array && NULL!=defrag.placed_array) {
+        opc_bzero_mem(defrag.placed_array, (c->part_items+1)*sizeof(bool));
+        if ((uint32_t)-1!=c->content_types_segment_id) defrag.segment_array[defrag.segment_items++]=c->content_types_segment_id;
+        if ((uint32_t)-1!=c->rels_segment_id) defrag.segment_array[defrag.segment_items++]=c->rels_segment_id;
+        if (OPC_ERROR_NONE==(ret=opcRelationTraverse(c, OPC_PART_INVALID, NULL, 0, OPC_TRAVERSE_DEPTH_FIRST, opcContainerDefragVisit, &defrag))) {
+            for(uint32_t i=0;i<c->part_items;i++) { // unreachable parts
+                opcContainerDefragPlace(&defrag, &c->part_array[i], opcContainerDefragIsMedia(c, &c->part_array[i]));
+            }
+            for(uint32_t i=0;i<defrag.media_items;i++) {
+                opcContainerPart *part=&c->part_array[defrag.media_array[i]];
+                if ((uint32_t)-1!=part->first_segment_id) defrag.segment_array[defrag.segment_items++]=part->first_segment_id;
+                if ((uint32_t)-1!=part->rel_segment_id) defrag.segment_array[defrag.segment_items++]=part->rel_segment_id;
+            }
+            assert(defrag.segment_items<=2*c->part_items+2);
+            ret=(NULL!=io?opcZipCommitTo(c->storage, io, defrag.segment_array, defrag.segment_items)
+                         :opcZipDefrag(c->storage, defrag.segment_array, defrag.segment_items));
+        }
+    }
+    if (NULL!=defrag.segment_array) opcHelperFree(c->io.allocator, defrag.segment_array);
+    if (NULL!=defrag.media_array) opcHelperFree(c->io.allocator, defrag.media_array);
+    if (NULL!=defrag.placed_array) opcHelperFree(c->io.allocator, defrag.placed_array);
+    return ret;
+}
+
+static opc_error_t opcContainerCommitTransition(opcContainer *c, bool defrag) {
+    // the new container is written front to back, the original (see opcFileInitIOOverlay) is only read.
+    opcIO_t io;
+    opc_error_t ret=opcFileInitIOFile(&io, c->transition_temp_name, OPC_FILE_WRITE | OPC_FILE_READ | OPC_FILE_TRUNC);
+    if (OPC_ERROR_NONE==ret) {
+        io.allocator=c->io.allocator;
+        ret=(defrag?opcContainerDefragSegments(c, &io):opcZipCommitTo(c->storage, &io, NULL, 0));
+        if (OPC_ERROR_NONE==ret) {
+            ret=opcFileSyncIO(&io); // the data must be on the disk before the rename
+        }
+        opcFileCleanupIO(&io);
+    }
+    return ret;
+}
+
+opc_error_t opcContainerCommit(opcContainer *c, bool trim, bool defrag) {
     opc_error_t ret=OPC_ERROR_NONE;
     if (OPC_OPEN_READ_ONLY!=c->mode) {
         opcContainerWriteContentTypes(c);
+        opcContainerLoadAllRelations(c); // unchanged relations are written as well
         opcContainerWriteAllRels(c);
-        ret=opcZipCommit(c->storage, trim);
+        if (NULL!=c->transition_temp_name) {
+            ret=opcContainerCommitTransition(c, defrag); // segment ids change, i.e. the container must be closed afterwards
+        } else {
+            if (defrag) {
+                ret=opcContainerDefragSegments(c, NULL); // segment ids change, i.e. the container must be closed afterwards
+            }
+            if (OPC_ERROR_NONE==ret) {
+                ret=opcZipCommit(c->storage, trim);
+            }
+        }
     }
     return ret;
 }
 
 opc_error_t opcContainerClose(opcContainer *c, opcContainerCloseMode mode) {
-    bool trim=(mode!=OPC_CLOSE_NOW);
-    opc_error_t ret=opcContainerCommit(c, trim);
+    opc_error_t ret=opcContainerCommit(c, mode!=OPC_CLOSE_NOW, OPC_CLOSE_DEFRAG==mode);
     opcZipClose(c->storage, NULL); c->storage=NULL;
+    if (NULL!=c->transition_temp_name) {
+        if (OPC_ERROR_NONE==ret) {
+            ret=opcFileReplace(c->transition_file_name, c->transition_temp_name);
+        } else {
+            remove((const char *)c->transition_temp_name); // the original is left as it is
+        }
+    }
     opcContainerFree(c);
     return ret;
 }
@@ -1326,14 +2030,18 @@ uint32_t opcRelationAdd(opcContainer *container, opcPart src, const xmlChar *rid
     uint32_t ret=-1;
     opcContainerRelation **relation_array=NULL;
     uint32_t *relation_items=NULL;
+    const xmlChar *source=NULL; // the root relations
     if (OPC_PART_INVALID==src) {
+        opcContainerLoadRelations(container, NULL);
         relation_array=&container->relation_array;
         relation_items=&container->relation_items;
     } else {
         opcContainerPart *src_part=opcContainerInsertPart(container, src, false);
         if (NULL!=src_part) {
+            opcContainerLoadRelations(container, src_part);
             relation_array=&src_part->relation_array;
             relation_items=&src_part->relation_items;
+            source=src_part->name;
         }
     }
     opcContainerPart *dest_part=opcContainerInsertPart(container, dest, false);
@@ -1346,10 +2054,11 @@ uint32_t opcRelationAdd(opcContainer *container, opcPart src, const xmlChar *rid
 
     if (NULL!=relation_array && NULL!=dest_part) {
         opcContainerRelationType *rel_type=(NULL!=type?opcContainerInsertRelationType(container, type, true):NULL);
-        opcContainerRelation *rel=opcContainerInsertRelation(relation_array, relation_items, rel_id, (NULL!=rel_type?rel_type->type:NULL), 0, dest_part->name);
+        opcContainerRelation *rel=opcContainerInsertRelation(container, relation_array, relation_items, rel_id, (NULL!=rel_type?rel_type->type:NULL), 0, dest_part->name);
         if (NULL!=rel) {
             assert(rel>=*relation_array && rel<*relation_array+*relation_items);
             assert(0==rel->target_mode);
+            opcContainerAddIncomingRelation(container, source, rel);
             ret=rel_id;
         }
     }
@@ -1361,11 +2070,13 @@ uint32_t opcRelationAddExternal(opcContainer *container, opcPart src, const xmlC
     opcContainerRelation **relation_array=NULL;
     uint32_t *relation_items=NULL;
     if (OPC_PART_INVALID==src) {
+        opcContainerLoadRelations(container, NULL);
         relation_array=&container->relation_array;
         relation_items=&container->relation_items;
     } else {
         opcContainerPart *src_part=opcContainerInsertPart(container, src, false);
         if (NULL!=src_part) {
+            opcContainerLoadRelations(container, src_part);
             relation_array=&src_part->relation_array;
             relation_items=&src_part->relation_items;
         }
@@ -1380,7 +2091,7 @@ uint32_t opcRelationAddExternal(opcContainer *container, opcPart src, const xmlC
 
     if (NULL!=relation_array && NULL!=_target) {
         opcContainerRelationType *rel_type=(NULL!=type?opcContainerInsertRelationType(container, type, true):NULL);
-        opcContainerRelation *rel=opcContainerInsertRelation(relation_array, relation_items, rel_id, (NULL!=rel_type?rel_type->type:NULL), 0, _target->target);
+        opcContainerRelation *rel=opcContainerInsertRelation(container, relation_array, relation_items, rel_id, (NULL!=rel_type?rel_type->type:NULL), 0, _target->target);
         if (NULL!=rel) {
             assert(rel>=*relation_array && rel<*relation_array+*relation_items);
             rel->target_mode=1;
@@ -1402,7 +2113,7 @@ opc_error_t opcQNameLevelAdd(opcQNameLevel_t **list_array, uint32_t *list_items,
     uint32_t i=0;
     opc_error_t ret=OPC_ERROR_NONE;
     if (!findItem(*list_array, *list_items, item, 0, qname_level_cmp_fct, &i)) {
-        if (NULL!=ensureItem((void**)list_array, *list_items, sizeof(opcQNameLevel_t))) {
+        if (NULL!=ensureItem(NULL, (void**)list_array, *list_items, sizeof(opcQNameLevel_t))) {
             ensureGap(*list_array, *list_items, i);
             (*list_array)[i]=*item;
         } else {
@@ -1440,7 +2151,7 @@ opc_error_t opcQNameLevelCleanup(opcQNameLevel_t *list_array, uint32_t *list_ite
 
 opc_error_t opcQNameLevelPush(opcQNameLevel_t **list_array, uint32_t *list_items, opcQNameLevel_t *item) {
     opc_error_t ret=OPC_ERROR_NONE;
-    if (NULL!=(ensureItem((void**)list_array, *list_items, sizeof(opcQNameLevel_t)))) {
+    if (NULL!=(ensureItem(NULL, (void**)list_array, *list_items, sizeof(opcQNameLevel_t)))) {
         (*list_array)[*list_items]=*item;
         (*list_items)++;
     } else {
@@ -1462,6 +2173,7 @@ bool opcQNameLevelPopIfMatch(opcQNameLevel_t *list_array, uint32_t *list_items,
 
 
 const xmlChar *opcRelationTypeFirst(opcContainer *container) {
+    opcContainerLoadAllRelations(container);
     if (container->relationtype_items>0) {
         return container->relationtype_array[0].type;
     } else {
@@ -1479,6 +2191,7 @@ const xmlChar *opcRelationTypeNext(opcContainer *container, const xmlChar *type)
 }
 
 const xmlChar *opcExternalTargetFirst(opcContainer *container) {
+    opcContainerLoadAllRelations(container);
     if (container->externalrelation_items>0) {
         return container->externalrelation_array[0].target;
     } else {
@@ -67,6 +67,8 @@ extern "C" {
     typedef enum {
         /**
          Opens the OPC container denoted by \a fileName in READ-ONLY mode. The \a destName parameter must be \a NULL.
+         Where available the file is read via pread(), so input streams do not share a file position.
+         \see opcFileInitIOFd
          \hideinitializer
          */
         OPC_OPEN_READ_ONLY=0, 
@@ -83,18 +85,72 @@ extern "C" {
         /**
          This mode will open the container denoted by \a fileName in READ-ONLY mode and the container denoted by 
          \a destName in write-only mode. Any modifications will be written to the container denoted by \a destName 
-         and the unmodified streams from \a fileName will be written to \a destName on closing.
-         \warning Currently not implemented.
+         and \a fileName is left untouched. The unmodified streams are copied raw from \a fileName to \a destName,
+         i.e. with their compressed data, CRC and sizes as they are, so only the parts which are written again get
+         compressed. The copy is made on opening and then modified like in \a OPC_OPEN_READ_WRITE mode, i.e. the 
+         space of replaced parts is reclaimed by \a OPC_CLOSE_TRIM.
+         \a fileName and \a destName must be different files. Only supported by \ref opcContainerOpen.
          \hideinitializer
          */
         OPC_OPEN_TEMPLATE=3,
         /**
          Like the OPC_OPEN_TEMPLATE mode, but the \a destName will be renamed to the \a fileName on closing. If \a destName 
          is \a NULL, then the name of the temporary file will be generated automatically.
-         \warning Currently not implemented.
+         \a fileName is only read, modifications are kept in an anonymous scratch file (see \ref opcFileInitIOOverlay). 
+         On closing the new container is written front to back into \a destName, copying unmodified parts raw and 
+         leaving out deleted ones (in the order of \a OPC_CLOSE_DEFRAG if closed with it). It is synced to the disk and then renamed 
+         over \a fileName, so other readers see either the old or the new container but never a half-written one.
+         If anything fails the temporary file is removed and \a fileName is left as it is. \a destName should be in 
+         the same directory (i.e. the same file system) as \a fileName, otherwise the rename fails.
          \hideinitializer
          */
-        OPC_OPEN_TRANSITION=4
+        OPC_OPEN_TRANSITION=4,
+        /**
+         Flag which can be combined with \a OPC_OPEN_READ_ONLY, i.e. OPC_OPEN_READ_ONLY|OPC_OPEN_MMAP. The container 
+         denoted by \a fileName will be mapped into memory and read without any intermediate copies.
+         If the file can not be mapped then it is opened like in \a OPC_OPEN_READ_ONLY mode.
+         \see opcFileInitIOMmap
+         \hideinitializer
+         */
+        OPC_OPEN_MMAP=0x100,
+        /**
+         Flag which can be combined with \a OPC_OPEN_READ_ONLY (and \a OPC_OPEN_MMAP). The container can then be read 
+         from several threads at the same time, i.e. \ref opcContainerOpenInputStream, \ref opcContainerMapPart, 
+         \ref opcXmlReaderOpen, \ref opcXmlReaderReadDoc and all functions which query parts, types and relations
+         can be called concurrently. A single input stream must only be used by one thread at a time. Read errors 
+         are reported per stream, e.g. by \ref opcContainerCloseInputStream.
+         All local headers and relations are read on opening and every input stream reads at its own file offset, 
+         so opening fails if the IO does not support positional reads (see \ref opcFileInitIOFd).
+         \hideinitializer
+         */
+        OPC_OPEN_THREAD_SAFE=0x200,
+        /**
+         Flag which can be combined with all modes. By default the relations of the root and of each part are 
+         parsed on demand, i.e. the first time a function like \ref opcRelationFirst or \ref opcRelationFind 
+         touches them. With this flag all relations are parsed on opening, so relation errors are reported 
+         right away. Implied by \a OPC_OPEN_THREAD_SAFE.
+         \hideinitializer
+         */
+        OPC_OPEN_EAGER_RELATIONS=0x400,
+        /**
+         Flag which can be combined with all modes. Input streams compute the CRC-32 of the data while reading and
+         \ref opcContainerCloseInputStream returns \a OPC_ERROR_CRC if it does not match the checksum stored in the
+         container. Only streams which were read completely from the start (i.e. without \ref opcContainerSeekInputStream) 
+         are checked. \ref opcContainerExtractParts checks mapped parts as well, \ref opcContainerMapPart does not.
+         \hideinitializer
+         */
+        OPC_OPEN_VERIFY_CRC=0x800,
+        /**
+         Flag which can be combined with \a OPC_OPEN_WRITE_ONLY. The container is written strictly sequentially 
+         without any seeks or reads, so e.g. a pipe or a socket can be passed to \ref opcContainerOpenIO with 
+         \a ioread, \a ioseek and \a iotrim set to \a NULL. Each local header is written as soon as its output stream 
+         is created, the data follows and the CRC and sizes are written in a data descriptor (bit 3) when the stream 
+         is closed. Content types, relations and the central directory are written by \ref opcContainerClose.
+         Only one output stream can be open at a time and every part can be written only once. Parts can not be 
+         read back, deleted parts are left in the stream but not listed in the central directory.
+         \hideinitializer
+         */
+        OPC_OPEN_STREAMING=0x1000
     } opcContainerOpenMode; 
     
     /** Modes for opcContainerClose.
@@ -113,9 +169,11 @@ extern "C" {
          */
         OPC_CLOSE_TRIM = 1,
         /**
-         Close the OPC container like in \a OPC_CLOSE_TRIM mode, but additionally remove any 
-         "interleaved" parts by reordering them.
-         \warning Currently not implemented. Same semantic as OPC_CLOSE_TRIM.       
+         Close the OPC container like in \a OPC_CLOSE_TRIM mode, but additionally reorder the parts physically, 
+         so the container can be processed in one forward pass: \c [Content_Types].xml and \c _rels/.rels come
+         first, then every part followed by its relations part and the parts it references (depth first), then 
+         the parts which are not reachable by relations and finally all parts which are not XML, e.g. images.
+         Only parts which are not in place already are moved, each of them twice (via the end of the file).
          \hideinitializer
          */
         OPC_CLOSE_DEFRAG = 2
@@ -144,10 +202,31 @@ extern "C" {
      @param[in] mode. For more details see \ref opcContainerOpenMode.
      @return \a NULL if failed. 
      */
-    opcContainer* opcContainerOpenMem(const uint8_t *data, uint32_t data_len,
+    opcContainer* opcContainerOpenMem(const uint8_t *data, size_t data_len,
                                       opcContainerOpenMode mode, 
                                       void *userContext);
 
+    /**
+     Like \ref opcContainerOpen, but all memory of the container is allocated by \c allocator:
+     the container and its index, streams, zlib state and the MCE state of XML readers and writers.
+     Memory allocated by libxml2 itself (e.g. the parsers) still comes from xmlMalloc.
+     @param[in] allocator. Callbacks and context, copied by the container. \a NULL selects xmlMalloc.
+     \see opcAllocator
+     */
+    opcContainer* opcContainerOpenEx(const xmlChar *fileName, 
+                                     opcContainerOpenMode mode, 
+                                     void *userContext, 
+                                     const xmlChar *destName,
+                                     const opcAllocator *allocator);
+
+    /**
+     Like \ref opcContainerOpenMem, using \c allocator, see \ref opcContainerOpenEx.
+     */
+    opcContainer* opcContainerOpenMemEx(const uint8_t *data, size_t data_len,
+                                        opcContainerOpenMode mode, 
+                                        void *userContext,
+                                        const opcAllocator *allocator);
+
     /**
      Opens a ZIP-based OPC container from memory.
      @param[in] ioread. 
@@ -169,9 +248,24 @@ extern "C" {
                                      opcFileTrimCallback *iotrim,
                                      opcFileFlushCallback *ioflush,
                                      void *iocontext,
-                                     size_t file_size,
+                                     opc_ofs_t file_size,
                                      opcContainerOpenMode mode, 
                                      void *userContext);
+
+    /**
+     Like \ref opcContainerOpenIO, using \c allocator, see \ref opcContainerOpenEx.
+     */
+    opcContainer* opcContainerOpenIOEx(opcFileReadCallback *ioread,
+                                       opcFileWriteCallback *iowrite,
+                                       opcFileCloseCallback *ioclose,
+                                       opcFileSeekCallback *ioseek,
+                                       opcFileTrimCallback *iotrim,
+                                       opcFileFlushCallback *ioflush,
+                                       void *iocontext,
+                                       opc_ofs_t file_size,
+                                       opcContainerOpenMode mode, 
+                                       void *userContext,
+                                       const opcAllocator *allocator);
     
     /**
      Close an OPC container.
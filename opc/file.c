@@ -29,6 +29,7 @@
  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
  OF THE POSSIBILITY OF SUCH DAMAGE.
 */
+#define _FILE_OFFSET_BITS 64 // 64 bit off_t for fseeko/ftello/ftruncate, needed for ZIP64 on 32 bit platforms
 #include <opc/file.h>
 #include <stdio.h>
 #include <libxml/xmlmemory.h>
@@ -38,6 +39,27 @@
 #include <unistd.h>
 #endif
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdlib.h>
+#define OPC_HAVE_MMAP
+#define OPC_HAVE_PREAD
+#endif
+
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#define opc_fseek _fseeki64
+#define opc_ftell _ftelli64
+#else
+#define opc_fseek fseeko
+#define opc_ftell ftello
+#endif
+
 static void *opcFileOpen(const xmlChar *filename, int flags) {
     char mode[5];
     int mode_ofs=0;
@@ -82,18 +104,18 @@ static int opcFileWrite(void *iocontext, const char *buffer, int len) {
     return fwrite(buffer, sizeof(char), len, (FILE*)iocontext);
 }
 
-static size_t opcFileSeek(void *iocontext, size_t ofs) {
-    int ret=fseek((FILE*)iocontext, ofs, SEEK_SET);
+static opc_ofs_t opcFileSeek(void *iocontext, opc_ofs_t ofs) {
+    int ret=opc_fseek((FILE*)iocontext, ofs, SEEK_SET);
     if (ret>=0) {
-        return ftell((FILE*)iocontext);
+        return opc_ftell((FILE*)iocontext);
     } else {
         return ret;
     }
 }
 
-static int opcFileTrim(void *iocontext, size_t new_size) {
+static int opcFileTrim(void *iocontext, opc_ofs_t new_size) {
 #ifdef WIN32
-    return _chsize(fileno((FILE*)iocontext), new_size);
+    return _chsize_s(fileno((FILE*)iocontext), new_size);
 #else
     return ftruncate(fileno((FILE*)iocontext), new_size);
 #endif
@@ -103,23 +125,23 @@ static int opcFileFlush(void *iocontext) {
     return fflush((FILE*)iocontext);
 }
 
-static uint32_t opcFileLength(void *iocontext) {
-    size_t current=ftell((FILE*)iocontext);
-    OPC_ENSURE(fseek((FILE*)iocontext, 0, SEEK_END)>=0);
-    size_t length=ftell((FILE*)iocontext);
-    OPC_ENSURE(fseek((FILE*)iocontext, current, SEEK_SET)>=0);
-    assert(current==ftell((FILE*)iocontext));
+static opc_ofs_t opcFileLength(void *iocontext) {
+    opc_ofs_t current=opc_ftell((FILE*)iocontext);
+    OPC_ENSURE(opc_fseek((FILE*)iocontext, 0, SEEK_END)>=0);
+    opc_ofs_t length=opc_ftell((FILE*)iocontext);
+    OPC_ENSURE(opc_fseek((FILE*)iocontext, current, SEEK_SET)>=0);
+    assert(current==(opc_ofs_t)opc_ftell((FILE*)iocontext));
     return length;
 }
 
 
 struct __opcZipMemContext {
     const uint8_t *data;
-    uint32_t data_len;
-    uint32_t data_pos;    
+    size_t data_len;
+    size_t data_pos;    
 };
 
-static void *opcMemOpen(const uint8_t *data, uint32_t data_len) {
+static void *opcMemOpen(const uint8_t *data, size_t data_len) {
     struct __opcZipMemContext *mem=(struct __opcZipMemContext *)xmlMalloc(sizeof(struct __opcZipMemContext));
     memset(mem, 0, sizeof(*mem));
     mem->data_len=data_len;
@@ -137,11 +159,18 @@ static int opcMemClose(void *iocontext) {
 
 static int opcMemRead(void *iocontext, char *buffer, int len) {
     struct __opcZipMemContext *mem=(struct __opcZipMemContext*)iocontext;
-    uint32_t max=(mem->data_pos+len<=mem->data_len?len:mem->data_len-mem->data_pos);
+    size_t max=(mem->data_pos+len<=mem->data_len?(size_t)len:mem->data_len-mem->data_pos);
     assert(max>=0 && mem->data_pos+max<=mem->data_len);
     memcpy(buffer, mem->data+mem->data_pos, max);
     mem->data_pos+=max;    
-    return max;
+    return (int)max;
+}
+
+static int opcMemReadAt(void *iocontext, opc_ofs_t pos, char *buffer, int len) {
+    struct __opcZipMemContext *mem=(struct __opcZipMemContext*)iocontext;
+    size_t max=(pos>=mem->data_len?0:(pos+len<=mem->data_len?(size_t)len:mem->data_len-(size_t)pos));
+    memcpy(buffer, mem->data+pos, max);
+    return (int)max;
 }
 
 static int opcMemWrite(void *iocontext, const char *buffer, int len) {
@@ -149,7 +178,7 @@ static int opcMemWrite(void *iocontext, const char *buffer, int len) {
     return -1;
 }
 
-static size_t opcMemSeek(void *iocontext, size_t ofs) {
+static opc_ofs_t opcMemSeek(void *iocontext, opc_ofs_t ofs) {
     struct __opcZipMemContext *mem=(struct __opcZipMemContext*)iocontext;
     if (ofs<=mem->data_len) {
         mem->data_pos=ofs;
@@ -159,7 +188,8 @@ static size_t opcMemSeek(void *iocontext, size_t ofs) {
     return mem->data_pos;
 }
 
-static int opcMemTrim(void *iocontext, size_t new_size) {
+static int opcMemTrim(void *iocontext, opc_ofs_t new_size) {
+    (void)iocontext; (void)new_size;
     assert(0); // not valid for mem
     return -1;
 }
@@ -168,6 +198,237 @@ static int opcMemFlush(void *iocontext) {
     return 0;
 }
 
+#ifdef OPC_HAVE_PREAD
+struct __opcZipFdContext {
+    int fd;
+};
+
+static void *opcFdOpen(const xmlChar *filename, int flags) {
+    struct __opcZipFdContext *ctx=NULL;
+    int oflags=O_RDONLY;
+    if (flags & OPC_FILE_WRITE) {
+        oflags=O_RDWR | O_CREAT | ((flags & OPC_FILE_TRUNC)?O_TRUNC:0);
+    }
+    int fd=open((const char *)filename, oflags, 0666);
+    if (fd>=0) {
+        if (NULL!=(ctx=(struct __opcZipFdContext *)xmlMalloc(sizeof(struct __opcZipFdContext)))) {
+            ctx->fd=fd;
+        } else {
+            close(fd);
+        }
+    }
+    return ctx;
+}
+
+static int opcFdClose(void *iocontext) {
+    struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)iocontext;
+    int ret=close(ctx->fd);
+    xmlFree(ctx);
+    return ret;
+}
+
+static int opcFdRead(void *iocontext, char *buffer, int len) {
+    struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)iocontext;
+    int ofs=0;
+    while(ofs<len) {
+        ssize_t ret=read(ctx->fd, buffer+ofs, len-ofs);
+        if (ret>0) {
+            ofs+=(int)ret;
+        } else if (0==ret) {
+            break; // end of file
+        } else if (EINTR!=errno) {
+            return -1;
+        }
+    }
+    return ofs;
+}
+
+static int opcFdReadAt(void *iocontext, opc_ofs_t pos, char *buffer, int len) {
+    struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)iocontext;
+    int ofs=0;
+    while(ofs<len) {
+        ssize_t ret=pread(ctx->fd, buffer+ofs, len-ofs, (off_t)(pos+ofs));
+        if (ret>0) {
+            ofs+=(int)ret;
+        } else if (0==ret) {
+            break; // end of file
+        } else if (EINTR!=errno) {
+            return -1;
+        }
+    }
+    return ofs;
+}
+
+static int opcFdWrite(void *iocontext, const char *buffer, int len) {
+    struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)iocontext;
+    int ofs=0;
+    while(ofs<len) {
+        ssize_t ret=write(ctx->fd, buffer+ofs, len-ofs);
+        if (ret>0) {
+            ofs+=(int)ret;
+        } else if (0==ret) {
+            return (ofs>0?ofs:-1); // no progress, e.g. the device is full
+        } else if (EINTR!=errno) {
+            return -1;
+        }
+    }
+    return ofs;
+}
+
+static opc_ofs_t opcFdSeek(void *iocontext, opc_ofs_t ofs) {
+    struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)iocontext;
+    return (opc_ofs_t)lseek(ctx->fd, (off_t)ofs, SEEK_SET);
+}
+
+static int opcFdTrim(void *iocontext, opc_ofs_t new_size) {
+    struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)iocontext;
+    return ftruncate(ctx->fd, (off_t)new_size);
+}
+
+static int opcFdFlush(void *iocontext) {
+    (void)iocontext;
+    return 0; // nothing is buffered
+}
+
+static opc_ofs_t opcFdLength(void *iocontext) {
+    struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)iocontext;
+    struct stat st;
+    OPC_ENSURE(0==fstat(ctx->fd, &st));
+    return (opc_ofs_t)st.st_size;
+}
+#endif
+
+#ifdef OPC_HAVE_MMAP
+struct __opcZipMmapContext {
+    struct __opcZipMemContext mem; // must be first, so the opcMem* callbacks can be used
+    void *addr;
+    size_t len;
+};
+
+static void *opcMmapOpen(const xmlChar *filename) {
+    struct __opcZipMmapContext *map=NULL;
+    int fd=open((const char *)filename, O_RDONLY);
+    if (fd>=0) {
+        struct stat st;
+        if (0==fstat(fd, &st) && st.st_size>0 && (uint64_t)st.st_size<=SIZE_MAX) {
+            void *addr=mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (MAP_FAILED!=addr && NULL!=(map=(struct __opcZipMmapContext *)xmlMalloc(sizeof(struct __opcZipMmapContext)))) {
+                memset(map, 0, sizeof(*map));
+                map->addr=addr;
+                map->len=(size_t)st.st_size;
+                map->mem.data=(const uint8_t *)addr;
+                map->mem.data_len=map->len;
+                map->mem.data_pos=0;
+                madvise(map->addr, map->len, MADV_RANDOM); // directories and headers first, see opcFileAdviseIO
+            } else if (MAP_FAILED!=addr) {
+                munmap(addr, (size_t)st.st_size);
+            }
+        }
+        close(fd); // the mapping stays valid
+    }
+    return map;
+}
+
+static int opcMmapClose(void *iocontext) {
+    struct __opcZipMmapContext *map=(struct __opcZipMmapContext*)iocontext;
+    int ret=munmap(map->addr, map->len);
+    xmlFree(map);
+    return ret;
+}
+#endif
+
+struct __opcZipOverlayContext {
+    opcIO_t base; // only read, everything before ofs
+    FILE *scratch; // everything from ofs on
+    opc_ofs_t ofs;
+    opc_ofs_t pos;
+    opc_ofs_t scratch_pos; // -1 if the scratch file has to be seeked before the next read or write
+    bool scratch_write;
+};
+
+static bool opcOverlaySeekScratch(struct __opcZipOverlayContext *overlay, bool write) {
+    // switching between reading and writing needs a seek as well.
+    opc_ofs_t const ofs=overlay->pos-overlay->ofs;
+    if (ofs!=overlay->scratch_pos || write!=overlay->scratch_write) {
+        if (opc_fseek(overlay->scratch, ofs, SEEK_SET)<0) {
+            overlay->scratch_pos=-1;
+            return false;
+        }
+        overlay->scratch_pos=ofs;
+        overlay->scratch_write=write;
+    }
+    return true;
+}
+
+static int opcOverlayClose(void *iocontext) {
+    struct __opcZipOverlayContext *overlay=(struct __opcZipOverlayContext*)iocontext;
+    int ret=overlay->base._ioclose(overlay->base.iocontext);
+    if (0!=fclose(overlay->scratch)) ret=-1;
+    xmlFree(overlay);
+    return ret;
+}
+
+static int opcOverlayRead(void *iocontext, char *buffer, int len) {
+    struct __opcZipOverlayContext *overlay=(struct __opcZipOverlayContext*)iocontext;
+    int ret=0;
+    if (overlay->pos<overlay->ofs) {
+        int const max=(overlay->ofs-overlay->pos<(opc_ofs_t)len?(int)(overlay->ofs-overlay->pos):len);
+        if (NULL!=overlay->base.data) {
+            memcpy(buffer, overlay->base.data+overlay->pos, max);
+            ret=max;
+        } else if (NULL!=overlay->base._ioreadat) {
+            ret=overlay->base._ioreadat(overlay->base.iocontext, overlay->pos, buffer, max);
+        } else if (overlay->base._ioseek(overlay->base.iocontext, overlay->pos)==overlay->pos) {
+            ret=overlay->base._ioread(overlay->base.iocontext, buffer, max);
+        } else {
+            ret=-1;
+        }
+        if (ret>0) overlay->pos+=ret;
+    }
+    if (ret>=0 && ret<len && overlay->pos>=overlay->ofs) {
+        if (opcOverlaySeekScratch(overlay, false)) {
+            int const scratch_len=(int)fread(buffer+ret, sizeof(char), len-ret, overlay->scratch);
+            overlay->scratch_pos+=scratch_len;
+            overlay->pos+=scratch_len;
+            ret+=scratch_len;
+        } else {
+            ret=-1;
+        }
+    }
+    return ret;
+}
+
+static int opcOverlayWrite(void *iocontext, const char *buffer, int len) {
+    struct __opcZipOverlayContext *overlay=(struct __opcZipOverlayContext*)iocontext;
+    if (overlay->pos<overlay->ofs || !opcOverlaySeekScratch(overlay, true)) {
+        return -1; // the base is never written
+    }
+    int const ret=(int)fwrite(buffer, sizeof(char), len, overlay->scratch);
+    overlay->scratch_pos+=ret;
+    overlay->pos+=ret;
+    return ret;
+}
+
+static opc_ofs_t opcOverlaySeek(void *iocontext, opc_ofs_t ofs) {
+    struct __opcZipOverlayContext *overlay=(struct __opcZipOverlayContext*)iocontext;
+    overlay->pos=ofs;
+    return ofs;
+}
+
+static int opcOverlayTrim(void *iocontext, opc_ofs_t new_size) {
+    struct __opcZipOverlayContext *overlay=(struct __opcZipOverlayContext*)iocontext;
+    if (new_size<overlay->ofs || 0!=opcFileFlush(overlay->scratch)) {
+        return -1;
+    }
+    overlay->scratch_pos=-1;
+    return opcFileTrim(overlay->scratch, new_size-overlay->ofs);
+}
+
+static int opcOverlayFlush(void *iocontext) {
+    struct __opcZipOverlayContext *overlay=(struct __opcZipOverlayContext*)iocontext;
+    return opcFileFlush(overlay->scratch);
+}
+
 opc_error_t opcFileInitIO(opcIO_t *io,
                           opcFileReadCallback *ioread,
                           opcFileWriteCallback *iowrite,
@@ -176,7 +437,7 @@ opc_error_t opcFileInitIO(opcIO_t *io,
                           opcFileTrimCallback *iotrim,
                           opcFileFlushCallback *ioflush,
                           void *iocontext,
-                          size_t file_size,
+                          opc_ofs_t file_size,
                           int flags) {
     opc_bzero_mem(io, sizeof(*io));
     io->_ioread=ioread;
@@ -212,7 +473,35 @@ opc_error_t opcFileInitIOFile(opcIO_t *io, const xmlChar *filename, int flags) {
     return ret;
 }
 
-opc_error_t opcFileInitIOMemory(opcIO_t *io, const uint8_t *data, uint32_t data_len, int flags) {
+opc_error_t opcFileInitIOFd(opcIO_t *io, const xmlChar *filename, int flags) {
+    opc_error_t ret=OPC_ERROR_NONE;
+#ifdef OPC_HAVE_PREAD
+    void *iocontext=opcFdOpen(filename, flags);
+    if (iocontext!=NULL) {
+        ret=opcFileInitIO(io,
+                          opcFdRead, 
+                          opcFdWrite, 
+                          opcFdClose, 
+                          opcFdSeek, 
+                          opcFdTrim, 
+                          opcFdFlush,
+                          iocontext, 
+                          opcFdLength(iocontext), 
+                          flags);
+        if (OPC_ERROR_NONE==ret) {
+            io->_ioreadat=opcFdReadAt;
+        }
+    } else {
+        ret=OPC_ERROR_STREAM;
+    }
+#else
+    ret=OPC_ERROR_STREAM; // no pread available
+#endif
+    if (OPC_ERROR_NONE!=ret && OPC_ERROR_NONE==io->state.err) io->state.err=ret; // propagate error to stream
+    return ret;
+}
+
+opc_error_t opcFileInitIOMemory(opcIO_t *io, const uint8_t *data, size_t data_len, int flags) {
     opc_error_t ret=OPC_ERROR_NONE;
     void *iocontext=opcMemOpen(data, data_len);
     if (iocontext!=NULL) {
@@ -226,6 +515,10 @@ opc_error_t opcFileInitIOMemory(opcIO_t *io, const uint8_t *data, uint32_t data_
                           iocontext, 
                           data_len, 
                           flags);
+        if (OPC_ERROR_NONE==ret) {
+            io->data=data;
+            io->_ioreadat=opcMemReadAt;
+        }
     } else {
         ret=OPC_ERROR_STREAM;
     }
@@ -233,6 +526,201 @@ opc_error_t opcFileInitIOMemory(opcIO_t *io, const uint8_t *data, uint32_t data_
     return ret;
 }
 
+opc_error_t opcFileInitIOMmap(opcIO_t *io, const xmlChar *filename, int flags) {
+    opc_error_t ret=OPC_ERROR_NONE;
+#ifdef OPC_HAVE_MMAP
+    struct __opcZipMmapContext *map=(0==(flags & OPC_FILE_WRITE)?(struct __opcZipMmapContext *)opcMmapOpen(filename):NULL);
+    if (NULL!=map) {
+        ret=opcFileInitIO(io, 
+                          opcMemRead, 
+                          opcMemWrite, 
+                          opcMmapClose, 
+                          opcMemSeek, 
+                          opcMemTrim, 
+                          opcMemFlush, 
+                          map, 
+                          map->len, 
+                          flags);
+        if (OPC_ERROR_NONE==ret) {
+            io->data=map->mem.data;
+            io->_ioreadat=opcMemReadAt;
+        }
+    } else {
+        ret=OPC_ERROR_STREAM;
+    }
+#else
+    ret=OPC_ERROR_STREAM; // no mmap available
+#endif
+    if (OPC_ERROR_NONE!=ret && OPC_ERROR_NONE==io->state.err) io->state.err=ret; // propagate error to stream
+    return ret;
+}
+
+opc_error_t opcFileInitIOOverlay(opcIO_t *io, opc_ofs_t ofs) {
+    assert(NULL!=io->iocontext && ofs<=io->file_size);
+    opc_error_t ret=OPC_ERROR_NONE;
+    struct __opcZipOverlayContext *overlay=(struct __opcZipOverlayContext *)xmlMalloc(sizeof(struct __opcZipOverlayContext));
+    FILE *scratch=(NULL!=overlay?tmpfile():NULL);
+    if (NULL!=scratch) {
+        memset(overlay, 0, sizeof(*overlay));
+        overlay->base=*io;
+        overlay->scratch=scratch;
+        overlay->ofs=ofs;
+        overlay->pos=io->state.buf_pos;
+        overlay->scratch_pos=-1;
+        // the state and the allocator are kept, the base is only accessed through the overlay from now on.
+        opcFileRawState const state=io->state;
+        const opcAllocator *allocator=io->allocator;
+        ret=opcFileInitIO(io, 
+                          opcOverlayRead, 
+                          opcOverlayWrite, 
+                          opcOverlayClose, 
+                          opcOverlaySeek, 
+                          opcOverlayTrim, 
+                          opcOverlayFlush, 
+                          overlay, 
+                          overlay->base.file_size, 
+                          overlay->base.flags | OPC_FILE_WRITE);
+        io->state=state;
+        io->allocator=allocator;
+    } else {
+        if (NULL!=overlay) xmlFree(overlay);
+        ret=OPC_ERROR_STREAM;
+    }
+    return ret;
+}
+
+opc_error_t opcFileAdviseIO(opcIO_t *io, opc_ofs_t ofs, opc_ofs_t len, opcFileAdvice advice) {
+#ifdef OPC_HAVE_MMAP
+    if (NULL!=io->iocontext && opcMmapClose==io->_ioclose && ofs<io->file_size) {
+        struct __opcZipMmapContext *map=(struct __opcZipMmapContext*)io->iocontext;
+        size_t const page=(size_t)sysconf(_SC_PAGESIZE);
+        size_t const start=(size_t)ofs-(size_t)ofs%page; // madvise needs a page aligned address
+        size_t const end=(ofs+len<map->len?(size_t)(ofs+len):map->len);
+        int const mode=(opcFileAdviceSequential==advice?MADV_SEQUENTIAL:(opcFileAdviceRandom==advice?MADV_RANDOM:(opcFileAdviceWillNeed==advice?MADV_WILLNEED:MADV_NORMAL)));
+        if (0!=madvise((uint8_t*)map->addr+start, end-start, mode)) {
+            return OPC_ERROR_STREAM;
+        }
+    }
+#endif
+#if defined(OPC_HAVE_PREAD) && defined(POSIX_FADV_WILLNEED)
+    if (NULL!=io->iocontext && opcFdClose==io->_ioclose && opcFileAdviceWillNeed==advice) {
+        struct __opcZipFdContext *ctx=(struct __opcZipFdContext*)io->iocontext;
+        if (0!=posix_fadvise(ctx->fd, (off_t)ofs, (off_t)len, POSIX_FADV_WILLNEED)) {
+            return OPC_ERROR_STREAM;
+        }
+    }
+#endif
+    return OPC_ERROR_NONE;
+}
+
+opc_error_t opcFileCopyIO(opcIO_t *dest, opcIO_t *src) {
+    assert(NULL!=dest && NULL!=src && NULL!=dest->_iowrite);
+    opc_error_t err=OPC_ERROR_NONE;
+    uint8_t buf[16*1024];
+    for(opc_ofs_t ofs=0;OPC_ERROR_NONE==err && ofs<src->file_size;) {
+        const uint8_t *data=buf;
+        int len=(src->file_size-ofs>sizeof(buf)?(int)sizeof(buf):(int)(src->file_size-ofs));
+        if (NULL!=src->data) {
+            data=src->data+ofs; // no need to copy mapped files
+        } else if (NULL!=src->_ioreadat) {
+            len=src->_ioreadat(src->iocontext, ofs, (char *)buf, len);
+        } else {
+            len=src->_ioread(src->iocontext, (char *)buf, len);
+        }
+        for(int out=0;OPC_ERROR_NONE==err && out<len;) {
+            int const ret=(len>0?dest->_iowrite(dest->iocontext, (const char *)data+out, len-out):0);
+            if (ret>0) {
+                out+=ret;
+            } else {
+                err=OPC_ERROR_STREAM;
+            }
+        }
+        if (len>0) {
+            ofs+=len;
+        } else {
+            err=OPC_ERROR_STREAM; // file is shorter than expected
+        }
+    }
+    if (OPC_ERROR_NONE==err) {
+        dest->state.buf_pos+=src->file_size;
+        if (dest->state.buf_pos>dest->file_size) dest->file_size=dest->state.buf_pos;
+    } else if (OPC_ERROR_NONE==dest->state.err) {
+        dest->state.err=err; // propagate error to stream
+    }
+    return err;
+}
+
+opc_error_t opcFileSyncIO(opcIO_t *io) {
+    int ret=(NULL!=io->_ioflush?io->_ioflush(io->iocontext):0);
+    if (0==ret && NULL!=io->iocontext && opcFileClose==io->_ioclose) {
+#ifdef WIN32
+        ret=_commit(_fileno((FILE*)io->iocontext));
+#elif defined(OPC_HAVE_PREAD)
+        ret=fsync(fileno((FILE*)io->iocontext));
+#endif
+    }
+#ifdef OPC_HAVE_PREAD
+    if (0==ret && NULL!=io->iocontext && opcFdClose==io->_ioclose) {
+        ret=fsync(((struct __opcZipFdContext*)io->iocontext)->fd);
+    }
+#endif
+    return (0==ret?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+}
+
+opc_error_t opcFileTempName(xmlChar *temp_name, uint32_t temp_max, const xmlChar *filename) {
+    // the temporary file is created next to filename, so it can be renamed to filename later.
+    int len=snprintf((char *)temp_name, temp_max, "%s.XXXXXX", (const char *)filename);
+    if (len<0 || (uint32_t)len>=temp_max) {
+        return OPC_ERROR_STREAM;
+    }
+#ifdef WIN32
+    return (0==_mktemp_s((char *)temp_name, len+1)?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+#elif defined(OPC_HAVE_PREAD)
+    int fd=mkstemp((char *)temp_name); // creates the file, i.e. the name can not be taken by anybody else
+    if (fd<0) {
+        return OPC_ERROR_STREAM;
+    }
+    struct stat st;
+    if (0==stat((const char *)filename, &st)) {
+        fchmod(fd, st.st_mode & 07777); // mkstemp uses 0600, the replacement should look like the original
+    }
+    close(fd);
+    return OPC_ERROR_NONE;
+#else
+    snprintf((char *)temp_name, temp_max, "%s.tmp", (const char *)filename);
+    return OPC_ERROR_NONE;
+#endif
+}
+
+opc_error_t opcFileReplace(const xmlChar *filename, const xmlChar *temp_name) {
+#ifdef WIN32
+    return (MoveFileExA((const char *)temp_name, (const char *)filename, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+#else
+    if (0!=rename((const char *)temp_name, (const char *)filename)) {
+        return OPC_ERROR_STREAM;
+    }
+#ifdef OPC_HAVE_PREAD
+    // the rename itself is persisted by syncing the directory.
+    char dir[OPC_MAX_PATH];
+    const char *slash=strrchr((const char *)filename, '/');
+    size_t const dir_len=(NULL!=slash?(size_t)(slash-(const char *)filename):0);
+    if (dir_len<sizeof(dir)) {
+        if (NULL!=slash) {
+            memcpy(dir, filename, dir_len); dir[dir_len]=0;
+        } else {
+            dir[0]='.'; dir[1]=0;
+        }
+        int fd=open(0==dir_len && NULL!=slash?"/":dir, O_RDONLY);
+        if (fd>=0) {
+            fsync(fd);
+            close(fd);
+        }
+    }
+#endif
+    return OPC_ERROR_NONE;
+#endif
+}
+
 opc_error_t opcFileCleanupIO(opcIO_t *io) {
     if (NULL!=io->iocontext) {
         io->_ioclose(io->iocontext);
@@ -80,6 +80,17 @@ extern "C" {
       */
     typedef int opcFileReadCallback(void *iocontext, char *buffer, int len);
 
+     /**
+      Callback to read a file at a given offset without changing the file position. 
+      E.g. for a file descriptor context this can be implemented as
+      \code
+      static int opcFileReadAt(void *iocontext, opc_ofs_t ofs, char *buffer, int len) {
+          return pread(*(int*)iocontext, buffer, len, ofs);
+      }
+      \endcode
+      */
+    typedef int opcFileReadAtCallback(void *iocontext, opc_ofs_t ofs, char *buffer, int len);
+
      /**
       Callback to write a file. E.g. for a FILE * context this can be implemented as
       \code
@@ -103,22 +114,22 @@ extern "C" {
      /**
       Callback to seek a file. E.g. for a FILE * context this can be implemented as
       \code
-      static size_t opcFileSeek(void *iocontext, size_t ofs) {
-          int ret=fseek((FILE*)iocontext, ofs, SEEK_SET);
+      static opc_ofs_t opcFileSeek(void *iocontext, opc_ofs_t ofs) {
+          int ret=fseeko((FILE*)iocontext, ofs, SEEK_SET);
           if (ret>=0) {
-              return ftell((FILE*)iocontext);
+              return ftello((FILE*)iocontext);
           } else {
               return ret;
           }
       }
       \endcode
       */
-    typedef size_t opcFileSeekCallback(void *iocontext, size_t ofs);
+    typedef opc_ofs_t opcFileSeekCallback(void *iocontext, opc_ofs_t ofs);
 
      /**
       Callback to trim a file. E.g. for a FILE * context this can be implemented as
       \code
-      static int opcFileTrim(void *iocontext, size_t new_size) {
+      static int opcFileTrim(void *iocontext, opc_ofs_t new_size) {
       #ifdef WIN32
           return _chsize(fileno((FILE*)iocontext), new_size);
       #else
@@ -127,7 +138,7 @@ extern "C" {
       }
       \endcode
       */
-    typedef int opcFileTrimCallback(void *iocontext, size_t new_size);
+    typedef int opcFileTrimCallback(void *iocontext, opc_ofs_t new_size);
 
      /**
       Callback to flush a file. E.g. for a FILE * context this can be implemented as
@@ -144,9 +155,19 @@ extern "C" {
       */
     typedef struct OPC_FILERAWSTATE_STRUCT {
         opc_error_t err;
-        size_t   buf_pos; // current pos in file
+        opc_ofs_t buf_pos; // current pos in file
     } opcFileRawState;
 
+    /** 
+      Access pattern hints for \ref opcFileAdviseIO.
+      */
+    typedef enum OPC_FILEADVICE_ENUM {
+        opcFileAdviceNormal,
+        opcFileAdviceSequential,
+        opcFileAdviceRandom,
+        opcFileAdviceWillNeed // the range will be read soon, i.e. start reading it ahead
+    } opcFileAdvice;
+
     /**
      File IO context.
      */
@@ -160,7 +181,10 @@ extern "C" {
         void *iocontext;
         int flags;
         opcFileRawState state;
-        size_t file_size;
+        opc_ofs_t file_size;
+        const uint8_t *data; // if not NULL then the whole (read-only) file is available in memory, see opcFileInitIOMmap
+        opcFileReadAtCallback *_ioreadat; // optional, if not NULL then input streams do not share the file position, see opcFileInitIOFd
+        const opcAllocator *allocator; // NULL for xmlMalloc, see opcContainerOpenEx
     } opcIO_t;
 
     /**
@@ -174,7 +198,7 @@ extern "C" {
                               opcFileTrimCallback *iotrim,
                               opcFileFlushCallback *ioflush,
                               void *iocontext,
-                              size_t file_size,
+                              opc_ofs_t file_size,
                               int flags);
 
     /**
@@ -182,11 +206,67 @@ extern "C" {
       */
     opc_error_t opcFileInitIOFile(opcIO_t *io, const xmlChar *filename, int flags);
 
+    /**
+      Initialize an IO context for a file using a plain POSIX file descriptor.
+      Reads are done via pread(), so every input stream keeps its own file offset and interleaved reads 
+      from several streams do not need any seeks. There is no additional buffering, i.e. stdio is bypassed.
+      Returns an error if pread() is not available on the platform.
+      */
+    opc_error_t opcFileInitIOFd(opcIO_t *io, const xmlChar *filename, int flags);
+
     /**
       Initialize an IO for memory.
       \warning Currently supports READ-ONLY file access.
       */
-    opc_error_t opcFileInitIOMemory(opcIO_t *io, const uint8_t *data, uint32_t data_len, int flags);
+    opc_error_t opcFileInitIOMemory(opcIO_t *io, const uint8_t *data, size_t data_len, int flags);
+
+    /**
+      Initialize an IO context for a file which is mapped into memory.
+      The ZIP layer will read directly from the mapping without copying the data into its own buffers.
+      \warning Supports READ-ONLY file access only. Returns an error if the file can not be mapped, e.g. if 
+      mmap is not available on the platform.
+      */
+    opc_error_t opcFileInitIOMmap(opcIO_t *io, const xmlChar *filename, int flags);
+
+    /**
+      Puts an overlay on top of the initialized \c io: everything before \c ofs is read from the original \c io, which 
+      is never written again. Everything from \c ofs on lives in an anonymous temporary file, i.e. writing there 
+      leaves the original untouched. The original is closed together with the overlay.
+      \see OPC_OPEN_TRANSITION
+      */
+    opc_error_t opcFileInitIOOverlay(opcIO_t *io, opc_ofs_t ofs);
+
+    /**
+      Gives the IO context a hint about how the range \c ofs to \c ofs+len will be accessed.
+      Currently only used for memory mapped files (i.e. madvise) and, for \c opcFileAdviceWillNeed, for 
+      file descriptors (i.e. posix_fadvise). All other IO contexts ignore the hint.
+      */
+    opc_error_t opcFileAdviseIO(opcIO_t *io, opc_ofs_t ofs, opc_ofs_t len, opcFileAdvice advice);
+
+    /**
+      Appends the whole content of \c src to \c dest at the current position of \c dest, byte by byte.
+      \c src is read from the start, i.e. it must not have been read before unless it supports positional reads.
+      \see OPC_OPEN_TEMPLATE
+      */
+    opc_error_t opcFileCopyIO(opcIO_t *dest, opcIO_t *src);
+
+    /**
+      Flushes \c io and, for files, forces the data to the disk (i.e. fsync).
+      */
+    opc_error_t opcFileSyncIO(opcIO_t *io);
+
+    /**
+      Generates a unique name for a temporary file in the directory of \c filename and, where available, creates
+      the (empty) file with the permissions of \c filename.
+      \see OPC_OPEN_TRANSITION
+      */
+    opc_error_t opcFileTempName(xmlChar *temp_name, uint32_t temp_max, const xmlChar *filename);
+
+    /**
+      Atomically replaces \c filename by \c temp_name, i.e. renames \c temp_name to \c filename.
+      \see OPC_OPEN_TRANSITION
+      */
+    opc_error_t opcFileReplace(const xmlChar *filename, const xmlChar *temp_name);
 
     /**
       Cleanup an IO context, i.e. release all system resources.
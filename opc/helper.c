@@ -32,6 +32,20 @@
 #include <opc/helper.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <zlib.h>
+#include <libxml/xmlmemory.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define OPC_HAVE_CRC32_PCLMUL
+#include <immintrin.h>
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__)) && (defined(__linux__) || defined(__APPLE__))
+#define OPC_HAVE_CRC32_ARMV8
+#include <arm_acle.h>
+#ifdef __linux__
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
 
 static uint32_t opcHelperEncodeFilename(const xmlChar *name, char *buf, int buf_len, bool rels_segment) {
     int name_len=xmlStrlen(name);
@@ -205,3 +219,173 @@ opc_error_t opcHelperSplitFilename(uint8_t *filename, uint32_t filename_length,
     }
     return ret;
 }
+
+#ifdef OPC_HAVE_CRC32_PCLMUL
+// Folds 64 bytes at a time with carry-less multiplications and reduces the result with Barrett reduction,
+// see "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction" (Intel, 2009). 
+// len must be a multiple of 16 and at least 64. crc is the non-inverted crc register.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t opcHelperCrc32Pclmul(uint32_t crc, const uint8_t *buf, size_t len) {
+    static const uint64_t k1k2[2] __attribute__((aligned(16)))={ 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t k3k4[2] __attribute__((aligned(16)))={ 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t k5k0[2] __attribute__((aligned(16)))={ 0x0163cd6124, 0x0000000000 };
+    static const uint64_t poly[2] __attribute__((aligned(16)))={ 0x01db710641, 0x01f7011641 };
+    assert(len>=64 && 0==len%16);
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+    x1=_mm_loadu_si128((const __m128i *)(buf+0x00));
+    x2=_mm_loadu_si128((const __m128i *)(buf+0x10));
+    x3=_mm_loadu_si128((const __m128i *)(buf+0x20));
+    x4=_mm_loadu_si128((const __m128i *)(buf+0x30));
+    x1=_mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0=_mm_load_si128((const __m128i *)k1k2);
+    buf+=64;
+    len-=64;
+    while (len>=64) { // fold four blocks in parallel
+        x5=_mm_clmulepi64_si128(x1, x0, 0x00);
+        x6=_mm_clmulepi64_si128(x2, x0, 0x00);
+        x7=_mm_clmulepi64_si128(x3, x0, 0x00);
+        x8=_mm_clmulepi64_si128(x4, x0, 0x00);
+        x1=_mm_clmulepi64_si128(x1, x0, 0x11);
+        x2=_mm_clmulepi64_si128(x2, x0, 0x11);
+        x3=_mm_clmulepi64_si128(x3, x0, 0x11);
+        x4=_mm_clmulepi64_si128(x4, x0, 0x11);
+        y5=_mm_loadu_si128((const __m128i *)(buf+0x00));
+        y6=_mm_loadu_si128((const __m128i *)(buf+0x10));
+        y7=_mm_loadu_si128((const __m128i *)(buf+0x20));
+        y8=_mm_loadu_si128((const __m128i *)(buf+0x30));
+        x1=_mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2=_mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3=_mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4=_mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf+=64;
+        len-=64;
+    }
+    // fold the four blocks into one
+    x0=_mm_load_si128((const __m128i *)k3k4);
+    x5=_mm_clmulepi64_si128(x1, x0, 0x00);
+    x1=_mm_clmulepi64_si128(x1, x0, 0x11);
+    x1=_mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5=_mm_clmulepi64_si128(x1, x0, 0x00);
+    x1=_mm_clmulepi64_si128(x1, x0, 0x11);
+    x1=_mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5=_mm_clmulepi64_si128(x1, x0, 0x00);
+    x1=_mm_clmulepi64_si128(x1, x0, 0x11);
+    x1=_mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+    while (len>=16) { // fold the remaining blocks
+        x2=_mm_loadu_si128((const __m128i *)buf);
+        x5=_mm_clmulepi64_si128(x1, x0, 0x00);
+        x1=_mm_clmulepi64_si128(x1, x0, 0x11);
+        x1=_mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf+=16;
+        len-=16;
+    }
+    // fold 128 bits to 64 bits
+    x2=_mm_clmulepi64_si128(x1, x0, 0x10);
+    x3=_mm_setr_epi32(~0, 0, ~0, 0);
+    x1=_mm_srli_si128(x1, 8);
+    x1=_mm_xor_si128(x1, x2);
+    x0=_mm_loadl_epi64((const __m128i *)k5k0);
+    x2=_mm_srli_si128(x1, 4);
+    x1=_mm_and_si128(x1, x3);
+    x1=_mm_clmulepi64_si128(x1, x0, 0x00);
+    x1=_mm_xor_si128(x1, x2);
+    // Barrett reduction to 32 bits
+    x0=_mm_load_si128((const __m128i *)poly);
+    x2=_mm_and_si128(x1, x3);
+    x2=_mm_clmulepi64_si128(x2, x0, 0x10);
+    x2=_mm_and_si128(x2, x3);
+    x2=_mm_clmulepi64_si128(x2, x0, 0x00);
+    x1=_mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static bool opcHelperCrc32HwSupported(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+#ifdef OPC_HAVE_CRC32_ARMV8
+// The ARMv8 CRC32 instructions implement the zlib polynomial. crc is the non-inverted crc register.
+__attribute__((target("+crc")))
+static uint32_t opcHelperCrc32Armv8(uint32_t crc, const uint8_t *buf, size_t len) {
+    while (len>0 && 0!=((uintptr_t)buf&7)) {
+        crc=__crc32b(crc, *buf++); len--;
+    }
+    while (len>=8) {
+        uint64_t v;
+        memcpy(&v, buf, sizeof(v));
+        crc=__crc32d(crc, v);
+        buf+=8; len-=8;
+    }
+    while (len>0) {
+        crc=__crc32b(crc, *buf++); len--;
+    }
+    return crc;
+}
+
+static bool opcHelperCrc32HwSupported(void) {
+#ifdef __APPLE__
+    return true; // all Apple ARM64 CPUs implement CRC32
+#else
+    return 0!=(getauxval(AT_HWCAP) & HWCAP_CRC32);
+#endif
+}
+#endif
+
+#if defined(OPC_HAVE_CRC32_PCLMUL) || defined(OPC_HAVE_CRC32_ARMV8)
+static bool hw_supported=false; // set once by opcHelperCrc32Init() before any worker thread runs
+#endif
+
+void opcHelperCrc32Init(void) {
+#if defined(OPC_HAVE_CRC32_PCLMUL) || defined(OPC_HAVE_CRC32_ARMV8)
+    hw_supported=opcHelperCrc32HwSupported();
+#endif
+}
+
+uint32_t opcHelperCrc32(uint32_t crc, const uint8_t *buf, size_t len) {
+#if defined(OPC_HAVE_CRC32_PCLMUL)
+    if (hw_supported && len>=64) {
+        size_t const chunk_len=len&~(size_t)15;
+        crc=~opcHelperCrc32Pclmul(~crc, buf, chunk_len);
+        buf+=chunk_len;
+        len-=chunk_len;
+    }
+#elif defined(OPC_HAVE_CRC32_ARMV8)
+    if (hw_supported) {
+        return ~opcHelperCrc32Armv8(~crc, buf, len);
+    }
+#endif
+    while (len>0) { // zlib's crc32 takes an uInt
+        uInt const chunk_len=(len<0x40000000?(uInt)len:0x40000000);
+        crc=(uint32_t)crc32(crc, buf, chunk_len);
+        buf+=chunk_len;
+        len-=chunk_len;
+    }
+    return crc;
+}
+
+void *opcHelperMalloc(const opcAllocator *allocator, size_t size) {
+    return (NULL!=allocator?allocator->_malloc(allocator->ctx, size):xmlMalloc(size));
+}
+
+void *opcHelperRealloc(const opcAllocator *allocator, void *ptr, size_t size) {
+    return (NULL!=allocator?allocator->_realloc(allocator->ctx, ptr, size):xmlRealloc(ptr, size));
+}
+
+void opcHelperFree(const opcAllocator *allocator, void *ptr) {
+    if (NULL!=allocator) {
+        allocator->_free(allocator->ctx, ptr);
+    } else {
+        xmlFree(ptr);
+    }
+}
+
+xmlChar *opcHelperStrndup(const opcAllocator *allocator, const xmlChar *str, uint32_t len) {
+    xmlChar *ret=(NULL!=str?(xmlChar *)opcHelperMalloc(allocator, len+1):NULL);
+    if (NULL!=ret) {
+        memcpy(ret, str, len);
+        ret[len]=0;
+    }
+    return ret;
+}
@@ -57,4 +57,36 @@ extern "C" {
       */
     opc_error_t opcHelperSplitFilename(uint8_t *filename, uint32_t filename_length, uint32_t *segment_number, bool *last_segment, bool *rel_segment);
 
+    /**
+      Updates the CRC-32 \c crc with \c len bytes from \c buf. The result is the same as zlib's crc32(), i.e. 
+      start with \c crc=0. Uses the PCLMULQDQ (x86) or CRC32 (ARMv8) instructions if the CPU supports them.
+      */
+    uint32_t opcHelperCrc32(uint32_t crc, const uint8_t *buf, size_t len);
+
+    /**
+      Detects whether the CPU supports the instructions used by opcHelperCrc32(). Called once by opcInitLibrary(); 
+      without it opcHelperCrc32() uses zlib's crc32().
+      */
+    void opcHelperCrc32Init(void);
+
+    /**
+      Allocates \c size bytes with \c allocator or with xmlMalloc if \c allocator is \a NULL.
+      */
+    void *opcHelperMalloc(const opcAllocator *allocator, size_t size);
+
+    /**
+      Resizes \c ptr with \c allocator or with xmlRealloc if \c allocator is \a NULL.
+      */
+    void *opcHelperRealloc(const opcAllocator *allocator, void *ptr, size_t size);
+
+    /**
+      Releases \c ptr with \c allocator or with xmlFree if \c allocator is \a NULL.
+      */
+    void opcHelperFree(const opcAllocator *allocator, void *ptr);
+
+    /**
+      Duplicates the first \c len characters of \c str with \c allocator. Returns \a NULL if \c str is \a NULL.
+      */
+    xmlChar *opcHelperStrndup(const opcAllocator *allocator, const xmlChar *str, uint32_t len);
+
 #endif /* OPC_HELPER_H */
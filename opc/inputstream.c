@@ -30,5 +30,158 @@
  OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <opc/opc.h>
+#include <opc/helper.h>
 #include "internal.h"
 
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define OPC_HAVE_PTHREAD
+#endif
+
+#define OPC_EXTRACT_BUFFER_SIZE (64*1024)
+#define OPC_EXTRACT_MAP_CHUNK_SIZE (1<<30)
+
+typedef struct OPC_CONTAINER_EXTRACT_STRUCT {
+    opcContainer *container;
+    const opcPart *parts;
+    uint32_t *segment_array; // first segment of each part or -1, resolved before the workers start
+    uint32_t part_items;
+    uint32_t next_part;
+    opcContainerExtractCallback *callback;
+    void *userctx;
+    opc_error_t err; // first error
+#ifdef OPC_HAVE_PTHREAD
+    pthread_mutex_t lock;
+#endif
+} opcContainerExtract;
+
+static opc_error_t opcContainerExtractPart(opcContainer *container, opcPart part, uint32_t segment_id, uint8_t *buf, opcContainerExtractCallback *callback, void *userctx) {
+    // only the zip is accessed here, looking up the part could modify the container, see opcContainerExtractParts.
+    opc_error_t err=OPC_ERROR_NONE;
+    const uint8_t *data=NULL;
+    opc_ofs_t data_len=0;
+    if ((uint32_t)-1==segment_id) {
+        err=OPC_ERROR_STREAM; // no such part
+    } else if (OPC_ERROR_NONE==opcZipMapSegment(container->storage, segment_id, &data, &data_len)) {
+        uint32_t crc=0;
+        while(OPC_ERROR_NONE==err && data_len>0) {
+            uint32_t const len=(data_len<OPC_EXTRACT_MAP_CHUNK_SIZE?(uint32_t)data_len:OPC_EXTRACT_MAP_CHUNK_SIZE);
+            if (container->verify_crc) {
+                crc=opcHelperCrc32(crc, data, len);
+            }
+            err=callback(userctx, part, data, len, false);
+            data+=len;
+            data_len-=len;
+        }
+        uint32_t data_crc=0;
+        if (OPC_ERROR_NONE==err && container->verify_crc 
+         && OPC_ERROR_NONE==opcZipGetSegmentInfo(container->storage, segment_id, NULL, NULL, &data_crc) && crc!=data_crc) {
+            err=OPC_ERROR_CRC;
+        }
+    } else {
+        opcZipInputStream *stream=opcZipOpenInputStream(container->storage, segment_id);
+        if (NULL!=stream) {
+            uint32_t len=0;
+            while(OPC_ERROR_NONE==err && (len=opcZipReadInputStream(container->storage, stream, buf, OPC_EXTRACT_BUFFER_SIZE))>0) {
+                err=callback(userctx, part, buf, len, false);
+            }
+            opc_error_t const close_err=opcZipCloseInputStream(container->storage, stream);
+            if (OPC_ERROR_NONE==err) err=close_err; // e.g. a corrupt stream
+        } else {
+            err=OPC_ERROR_STREAM;
+        }
+    }
+    if (OPC_ERROR_NONE==err) {
+        err=callback(userctx, part, NULL, 0, true);
+    }
+    return err;
+}
+
+static void *opcContainerExtractWorker(void *arg) {
+    opcContainerExtract *extract=(opcContainerExtract *)arg;
+    uint8_t *buf=(uint8_t *)opcHelperMalloc(extract->container->io.allocator, OPC_EXTRACT_BUFFER_SIZE);
+    bool done=false;
+    while(!done) {
+        uint32_t i=0;
+#ifdef OPC_HAVE_PTHREAD
+        pthread_mutex_lock(&extract->lock);
+#endif
+        if (NULL==buf && OPC_ERROR_NONE==extract->err) {
+            extract->err=OPC_ERROR_MEMORY;
+        }
+        done=(OPC_ERROR_NONE!=extract->err || extract->next_part>=extract->part_items);
+        i=extract->next_part++;
+#ifdef OPC_HAVE_PTHREAD
+        pthread_mutex_unlock(&extract->lock);
+#endif
+        if (!done) {
+            opc_error_t err=opcContainerExtractPart(extract->container, extract->parts[i], extract->segment_array[i], buf, extract->callback, extract->userctx);
+            if (OPC_ERROR_NONE!=err) {
+#ifdef OPC_HAVE_PTHREAD
+                pthread_mutex_lock(&extract->lock);
+#endif
+                if (OPC_ERROR_NONE==extract->err) extract->err=err;
+#ifdef OPC_HAVE_PTHREAD
+                pthread_mutex_unlock(&extract->lock);
+#endif
+            }
+        }
+    }
+    if (NULL!=buf) {
+        opcHelperFree(extract->container->io.allocator, buf);
+    }
+    return NULL;
+}
+
+opc_error_t opcContainerExtractParts(opcContainer *container, const opcPart *parts, uint32_t part_items, opcContainerExtractCallback *callback, void *userctx, uint32_t threads) {
+    assert(NULL!=container && (NULL!=parts || 0==part_items) && NULL!=callback);
+    opcContainerExtract extract;
+    opc_bzero_mem(&extract, sizeof(extract));
+    extract.container=container;
+    extract.parts=parts;
+    extract.part_items=part_items;
+    extract.callback=callback;
+    extract.userctx=userctx;
+    // parts are resolved here, a lookup may rebuild the part hash which must not happen while the workers run.
+    extract.segment_array=(part_items>0?(uint32_t *)opcHelperMalloc(container->io.allocator, part_items*sizeof(uint32_t)):NULL);
+    if (part_items>0 && NULL==extract.segment_array) {
+        return OPC_ERROR_MEMORY;
+    }
+    for(uint32_t i=0;i<part_items;i++) {
+        opcContainerPart *cp=(OPC_PART_INVALID!=parts[i]?opcContainerInsertPart(container, parts[i], false):NULL);
+        extract.segment_array[i]=(NULL!=cp && cp->first_segment_id<container->storage->segment_items?cp->first_segment_id:(uint32_t)-1);
+    }
+#ifdef OPC_HAVE_PTHREAD
+    if (0==threads) {
+        long const cpus=sysconf(_SC_NPROCESSORS_ONLN);
+        threads=(cpus>0?(uint32_t)cpus:1);
+    }
+    if (threads>OPC_MAX_THREADS) threads=OPC_MAX_THREADS;
+    if (threads>part_items) threads=part_items;
+    if (threads>1 && (NULL==container->io._ioreadat || OPC_ERROR_NONE!=opcZipLoadAllHeaders(container->storage))) {
+        threads=1; // the streams would share the file position resp. opening a stream would modify the zip
+    }
+    pthread_t *thread_array=(threads>1?(pthread_t *)opcHelperMalloc(container->io.allocator, (threads-1)*sizeof(pthread_t)):NULL);
+    uint32_t thread_items=0;
+    pthread_mutex_init(&extract.lock, NULL);
+    while(NULL!=thread_array && thread_items+1<threads && 0==pthread_create(&thread_array[thread_items], NULL, opcContainerExtractWorker, &extract)) {
+        thread_items++;
+    }
+    opcContainerExtractWorker(&extract); // the calling thread helps
+    for(uint32_t i=0;i<thread_items;i++) {
+        pthread_join(thread_array[i], NULL);
+    }
+    pthread_mutex_destroy(&extract.lock);
+    if (NULL!=thread_array) {
+        opcHelperFree(container->io.allocator, thread_array);
+    }
+#else
+    opcContainerExtractWorker(&extract); // no threads available
+#endif
+    if (NULL!=extract.segment_array) {
+        opcHelperFree(container->io.allocator, extract.segment_array);
+    }
+    return extract.err;
+}
@@ -51,12 +51,44 @@ extern "C" {
       */
     opcContainerInputStream* opcContainerOpenInputStream(opcContainer *container, const xmlChar *name);
 
+    /**
+      Returns the content of the \c part without copying it, i.e. \c *data will point directly into the container.
+      This is only possible if the container was opened via \ref opcContainerOpenMem or with \c OPC_OPEN_MMAP
+      and if the part is stored uncompressed. In all other cases an error is returned and the part must be read
+      using \ref opcContainerOpenInputStream.
+      The pointer is valid until the container is closed.
+      \code
+      const uint8_t *data=NULL;
+      opc_ofs_t data_len=0;
+      if (OPC_ERROR_NONE!=opcContainerMapPart(c, part, &data, &data_len)) {
+          // fall back to opcContainerOpenInputStream...
+      }
+      \endcode
+      */
+    opc_error_t opcContainerMapPart(opcContainer *container, opcPart part, const uint8_t **data, opc_ofs_t *data_len);
+
     /**
      Reads maximal \c buffer_len bytes from the input \c stream to \c buffer. 
      \return The number of byes read or "0" in case of an error or end-of-stream.
      */
     uint32_t opcContainerReadInputStream(opcContainerInputStream* stream, uint8_t *buffer, uint32_t buffer_len);
 
+    /**
+     Positions the input \c stream at the uncompressed offset \c ofs, so that the next \ref opcContainerReadInputStream
+     returns the bytes starting at \c ofs. Stored parts are repositioned directly. For deflated parts inflating restarts 
+     at the nearest checkpoint before \c ofs; the checkpoints are collected on demand and cached for the life of the container.
+     \note Collecting checkpoints modifies the container. When reading from several threads (see \c OPC_OPEN_THREAD_SAFE)
+     call \ref opcContainerBuildSeekIndex for the part before sharing it.
+     \return OPC_ERROR_SEEK if \c ofs is behind the end of the part.
+     */
+    opc_error_t opcContainerSeekInputStream(opcContainerInputStream* stream, opc_ofs_t ofs);
+
+    /**
+     Collects all seek checkpoints of \c part in one pass, so that subsequent calls to \ref opcContainerSeekInputStream 
+     on this part never need to inflate more than \c OPC_SEEK_INDEX_SPAN bytes.
+     */
+    opc_error_t opcContainerBuildSeekIndex(opcContainer *container, opcPart part);
+
     /**
       Closes the input stream and releases all system resources.
       */
@@ -67,6 +99,31 @@ extern "C" {
       */
     opcCompressionOption_t opcContainerGetInputStreamCompressionOption(opcContainerInputStream* stream);
 
+    /**
+      Callback for \ref opcContainerExtractParts. Is called for every chunk of \c data of the \c part in order.
+      After the last chunk it is called once more with \c last set to true and no data.
+      Returning anything else than OPC_ERROR_NONE aborts the extraction.
+      */
+    typedef opc_error_t opcContainerExtractCallback(void *userctx, opcPart part, const uint8_t *data, uint32_t data_len, bool last);
+
+    /**
+      Reads the \c part_items parts in \c parts and passes their content to \c callback.
+      The parts are read by \c threads threads (including the calling one) at the same time, i.e. the callback must be
+      thread safe. All callbacks of one part are made from the same thread. If \c threads is 0, then one thread per 
+      processor is used, but never more than \ref OPC_MAX_THREADS. If the container can not be read concurrently (see \ref opcFileInitIOFd), then all parts are 
+      read by the calling thread.
+      No other function must be called on \c container until opcContainerExtractParts returns.
+      \return The first error, either reading a part or returned by the \c callback.
+      \code
+      static opc_error_t extract(void *userctx, opcPart part, const uint8_t *data, uint32_t data_len, bool last) {
+          ...
+      }
+      ...
+      opcContainerExtractParts(c, parts, part_items, extract, NULL, 0);
+      \endcode
+      */
+    opc_error_t opcContainerExtractParts(opcContainer *container, const opcPart *parts, uint32_t part_items, opcContainerExtractCallback *callback, void *userctx, uint32_t threads);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif    
@@ -39,6 +39,7 @@
 #define OPC_INTERNAL_H
 
 #include <opc/config.h>
+#include <opc/helper.h>
 #include <opc/container.h>
 #include <opc/zip.h>
 #include <zlib.h>
@@ -52,47 +53,85 @@ extern "C" {
         opcFileRawState state;
         uint32_t   buf_ofs;
         uint32_t   buf_len;
+        uint32_t   read_at :1; // read at state.buf_pos without using the shared opcIO_t.state, see opcZipOpenInputStream
+        const uint8_t *data; // either buf or a window into opcIO_t.data
         uint8_t buf[OPC_DEFLATE_BUFFER_SIZE];
     } opcFileRawBuffer;
 
 
+    typedef struct OPC_ZIPSEEKPOINT_STRUCT {
+        opc_ofs_t compressed_ofs; // relative to the start of the segment's data
+        opc_ofs_t uncompressed_ofs;
+        uint32_t bits; // number of bits of the byte before compressed_ofs which are needed
+        uint32_t window_len;
+        uint8_t *window; // the last window_len (max. 32K) uncompressed bytes, i.e. the inflate dictionary
+    } opcZipSeekPoint;
+
+    typedef struct OPC_ZIPSEEKINDEX_STRUCT {
+        opcZipSeekPoint *point_array;
+        uint32_t point_items;
+        bool complete; // covers the whole segment
+    } opcZipSeekIndex;
+
     typedef struct OPC_ZIPSEGMENT_STRUCT {
         uint32_t deleted_segment :1;
         uint32_t rels_segment :1;
+        uint32_t zip64_segment :1; // header_size includes the ZIP64 extra field
         uint32_t next_segment_id;
         const xmlChar *partName; // NOT!!! owned by me... owned by opcContainer
-        size_t stream_ofs;
-        size_t segment_size;
+        opc_ofs_t stream_ofs;
+        opc_ofs_t segment_size;
         uint16_t padding;
         uint32_t header_size;
         uint16_t bit_flag;
         uint32_t crc32;
         uint16_t compression_method;
-        size_t compressed_size;
-        size_t uncompressed_size;
+        opc_ofs_t compressed_size;
+        opc_ofs_t uncompressed_size;
         uint32_t growth_hint; 
+        opcZipSeekIndex *seek_index; // built on demand, see opcZipSeekInputStream
     } opcZipSegment;
 
     struct OPC_ZIP_STRUCT {
         opcIO_t *io;
+        const opcZipCodec *codec;
+        opcZipCodec zlib_codec; // the zlib codec allocating through io->allocator
+        bool verify_crc; // check the crc of input streams on closing
+        bool streaming; // write-only, segments are appended one after the other without seeking, see OPC_OPEN_STREAMING
+        uint32_t streaming_segment_id; // segment of the open output stream in streaming mode or -1
         uint32_t first_free_segment_id;
         opcZipSegment *segment_array;
         uint32_t segment_items;
     };
 
     typedef struct OPC_ZIPINFLATESTATE_STRUCT {
-        z_stream stream;
+        const opcZipCodec *codec;
+        void *codec_state; // NULL for STORE
         uint16_t compression_method;
-        int inflate_state;
-        size_t compressed_size;
+        bool eof;
+        bool verify_crc;
+        uint32_t crc32; // of the uncompressed data read so far if verify_crc
+        opc_ofs_t compressed_size;
+        opc_ofs_t total_in;
+        opc_ofs_t total_out;
     } opcZipInflateState;
 
     struct OPC_ZIPOUTPUTSTREAM_STRUCT {
         uint32_t segment_id;
         uint16_t compression_method;
+        uint16_t bit_flag;
+        bool detached; // data is collected in data until opcZipAttachOutputStream
+        opc_error_t err; // of a detached stream, otherwise io->state.err is used
+        uint8_t *data /*[data_size]*/;
+        opc_ofs_t data_len;
+        opc_ofs_t data_size;
+        struct OPC_ZIPPARALLELDEFLATE_STRUCT *parallel; // NULL unless compressed by several threads, see opcZipSetOutputStreamThreads
         uint32_t crc32;
-        z_stream stream;
-        int inflate_state;
+        const opcZipCodec *codec;
+        void *codec_state; // NULL for STORE
+        bool finished;
+        opc_ofs_t total_in;
+        opc_ofs_t total_out;
         uint32_t buf_len;
         uint32_t buf_ofs;
         uint32_t buf_size;
@@ -127,6 +166,7 @@ extern "C" {
         opcContainer *container; // weak reference
         const xmlChar *partName;
         bool rels_segment;
+        bool detached; // see opcContainerCreateDetachedOutputStream
     };
 
     typedef struct OPC_CONTAINER_RELATION_TYPE_STRUCT {
@@ -150,6 +190,24 @@ extern "C" {
         xmlChar* target_ptr; // 0==targetMode: points to xmlChar owned part_array, 1==targetMode: points to xmlChar owned by externalrelation_array
     } opcContainerRelation;
 
+    typedef struct OPC_CONTAINER_RELATION_TYPE_ENTRY_STRUCT {
+        const xmlChar *relation_type; // interned, i.e. compared by pointer
+        uint32_t relation_pos; // position in the relation_array
+    } opcContainerRelationTypeEntry;
+
+    typedef struct OPC_CONTAINER_RELATION_TYPE_INDEX_STRUCT {
+        opcContainerRelationTypeEntry *index_array; // ordered by relation_type, then by relation_pos
+        uint32_t index_items;
+        uint32_t generation; // container->relation_generation the index was built for
+    } opcContainerRelationTypeIndex;
+
+    typedef struct OPC_CONTAINER_INCOMING_RELATION_STRUCT {
+        const xmlChar *target; // name of the target part, owned by part_array
+        const xmlChar *source; // name of the source part or NULL for the root relations
+        uint32_t relation_id;
+        bool deleted; // kept in place until compacted, see opcContainerRemoveIncomingRelation
+    } opcContainerIncomingRelation;
+
     typedef struct OPC_CONTAINER_PART_STRUCT {
         xmlChar *name;
         const xmlChar *type; // owned by type_array
@@ -159,6 +217,8 @@ extern "C" {
         uint32_t rel_segment_id;
         opcContainerRelation *relation_array;
         uint32_t relation_items;
+        opcContainerRelationTypeIndex relation_type_index; // see opcContainerGetRelationTypeIndex
+        bool relations_loaded; // see opcContainerLoadRelations
     } opcContainerPart;
 
     typedef struct OPC_CONTAINER_PART_PREFIX_STRUCT {
@@ -178,13 +238,34 @@ extern "C" {
         const xmlChar *type; // owned by opcContainerType
     } opcContainerExtension;
 
+    typedef struct OPC_CONTAINER_STRING_BLOCK_STRUCT {
+        struct OPC_CONTAINER_STRING_BLOCK_STRUCT *next;
+        uint32_t size;
+        uint32_t used;
+        xmlChar data[];
+    } opcContainerStringBlock;
+
     struct OPC_CONTAINER_STRUCT {
         opcIO_t io;
         opcZip *storage;
         opcContainerOpenMode mode;
+        bool thread_safe; // see OPC_OPEN_THREAD_SAFE
+        bool eager_relations; // see OPC_OPEN_EAGER_RELATIONS
+        bool verify_crc; // see OPC_OPEN_VERIFY_CRC
+        bool streaming; // see OPC_OPEN_STREAMING
+        const xmlChar *transition_file_name; // replaced by transition_temp_name on closing, see OPC_OPEN_TRANSITION
+        const xmlChar *transition_temp_name; // NULL unless opened in transition mode
+        opcAllocator allocator; // see opcContainerOpenEx, io.allocator points here if given
+        opcContainerStringBlock *string_block; // owns the names, types and targets below
 
         opcContainerPart *part_array;
         uint32_t part_items;
+        uint32_t *part_hash_array; // part_array index+1 or 0, see opcContainerInsertPart
+        uint32_t part_hash_size; // power of two
+        bool part_hash_valid;
+        uint32_t part_hash_misses; // lookups since the hash became invalid, see opcContainerInsertPart
+        bool part_array_unsorted; // parts are appended while loading and sorted once afterwards
+        uint32_t part_cursor; // index of the part last returned by opcPartGetFirst/opcPartGetNext
         opcContainerRelPrefix *relprefix_array;
         uint32_t relprefix_items;
         opcContainerType *type_array;
@@ -199,6 +280,13 @@ extern "C" {
         uint32_t rels_segment_id;
         opcContainerRelation *relation_array;
         uint32_t relation_items;
+        opcContainerRelationTypeIndex relation_type_index; // root relations, see opcContainerGetRelationTypeIndex
+        uint32_t relation_generation; // bumped whenever a relation array changes, outdates the type indices
+        opcContainerIncomingRelation *incoming_array; // ordered by target, source and relation_id, see opcContainerBuildIncomingRelations
+        uint32_t incoming_items;
+        uint32_t incoming_deleted; // number of deleted entries in incoming_array
+        bool incoming_valid; // all relations are loaded and internal relations are mirrored in incoming_array
+        bool relations_loaded; // root relations, see opcContainerLoadRelations
         void *userContext;
     };
 
@@ -209,10 +297,12 @@ extern "C" {
 
     opcContainerExtension *opcContainerInsertExtension(opcContainer *container, const xmlChar *extension, bool insert);
     opcContainerPart *opcContainerInsertPart(opcContainer *container, const xmlChar *name, bool insert);
+    void opcContainerLoadRelations(opcContainer *container, opcContainerPart *part);
+    void opcContainerLoadAllRelations(opcContainer *container);
     opc_error_t opcContainerDeletePart(opcContainer *container, const xmlChar *name);
     opcContainerRelation *opcContainerFindRelation(opcContainer *container, opcContainerRelation *relation_array, uint32_t relation_items, opcRelation relation);
     opc_error_t opcContainerDeleteRelation(opcContainer *container, opcContainerRelation **relation_array, uint32_t *relation_items, opcRelation relation);
-    opcContainerRelation *opcContainerInsertRelation(opcContainerRelation **relation_array, uint32_t *relation_items, 
+    opcContainerRelation *opcContainerInsertRelation(opcContainer *container, opcContainerRelation **relation_array, uint32_t *relation_items, 
                                                      uint32_t relation_id,
                                                      xmlChar *relation_type,
                                                      uint32_t target_mode, xmlChar *target_ptr);
@@ -222,6 +312,13 @@ extern "C" {
 
     bool opcContainerDeletePartEx(opcContainer *container, const xmlChar *partName, bool rels_segment);
 
+    opcContainerRelationTypeIndex *opcContainerGetRelationTypeIndex(opcContainer *container, opcContainerRelation *relation_array, uint32_t relation_items, opcContainerRelationTypeIndex *index);
+    opcContainerRelation *opcContainerFindRelationByType(opcContainer *container, opcContainerRelation *relation_array, uint32_t relation_items, opcContainerRelationTypeIndex *index, const xmlChar *type, opcContainerRelation *after);
+    bool opcContainerBuildIncomingRelations(opcContainer *container);
+    void opcContainerAddIncomingRelation(opcContainer *container, const xmlChar *source, const opcContainerRelation *rel);
+    void opcContainerCompactIncomingRelations(opcContainer *container);
+    void opcContainerRemoveIncomingRelation(opcContainer *container, const xmlChar *source, const opcContainerRelation *rel);
+    opcContainerIncomingRelation *opcContainerFindIncomingRelation(opcContainer *container, const xmlChar *target, const xmlChar *source, opcRelation relation);
     opcContainerRelation *opcContainerFindRelationById(opcContainer *container, opcContainerRelation *relation_array, uint32_t relation_items, const xmlChar *relation_id);
 
     opc_error_t opcQNameLevelAdd(opcQNameLevel_t **list_array, uint32_t *list_items, opcQNameLevel_t *item);
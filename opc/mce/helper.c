@@ -1,5 +1,11 @@
 #include <libxml/xmlmemory.h>
 #include <opc/mce/helper.h>
+#include <opc/helper.h>
+
+static void *mceEnsureItem(const opcAllocator *allocator, void *array, uint32_t items, size_t item_size) {
+    // the capacity is implied by the item count: arrays grow in powers of two (starting with 4 items).
+    return (0==items || (items>=4 && 0==(items&(items-1)))?opcHelperRealloc(allocator, array, (0==items?4:2*items)*item_size):array);
+}
 
 static bool mceQNameLevelLookupEx(mceQNameLevelSet_t *qname_level_set, const xmlChar *ns, const xmlChar *ln, uint32_t *pos, bool ignore_ln) {
     uint32_t i=0;
@@ -27,7 +33,7 @@ bool mceQNameLevelAdd(mceQNameLevelSet_t *qname_level_set, const xmlChar *ns, co
     bool ret=false;
     if (!mceQNameLevelLookupEx(qname_level_set, ns, ln, &i, false)) {
         mceQNameLevel_t *new_list_array=NULL;
-        if (NULL!=(new_list_array=(mceQNameLevel_t *)xmlRealloc(qname_level_set->list_array, (1+qname_level_set->list_items)*sizeof(*qname_level_set->list_array)))) {
+        if (NULL!=(new_list_array=(mceQNameLevel_t *)mceEnsureItem(qname_level_set->allocator, qname_level_set->list_array, qname_level_set->list_items, sizeof(*qname_level_set->list_array)))) {
             qname_level_set->list_array=new_list_array;
             for (uint32_t k=qname_level_set->list_items;k>i;k--) {
                 qname_level_set->list_array[k]=qname_level_set->list_array[k-1];
@@ -36,8 +42,8 @@ bool mceQNameLevelAdd(mceQNameLevelSet_t *qname_level_set, const xmlChar *ns, co
             assert(i>=0 && i<qname_level_set->list_items);
             memset(&qname_level_set->list_array[i], 0, sizeof(qname_level_set->list_array[i]));
             qname_level_set->list_array[i].level=level;
-            qname_level_set->list_array[i].ln=(NULL!=ln?xmlStrdup(ln):NULL);
-            qname_level_set->list_array[i].ns=xmlStrdup(ns);
+            qname_level_set->list_array[i].ln=(NULL!=ln?opcHelperStrndup(qname_level_set->allocator, ln, xmlStrlen(ln)):NULL);
+            qname_level_set->list_array[i].ns=(NULL!=ns?opcHelperStrndup(qname_level_set->allocator, ns, xmlStrlen(ns)):NULL);
             if (qname_level_set->max_level<level) qname_level_set->max_level=level;
             ret=true;
         }
@@ -54,8 +60,8 @@ bool mceQNameLevelCleanup(mceQNameLevelSet_t *qname_level_set, uint32_t level) {
         for(uint32_t j=0;j<qname_level_set->list_items;j++) {
             if (qname_level_set->list_array[j].level>=level) {
                 assert(qname_level_set->list_array[j].level==level); // cleanup should be called for every level...
-                if (NULL!=qname_level_set->list_array[j].ln) xmlFree(qname_level_set->list_array[j].ln);
-                if (NULL!=qname_level_set->list_array[j].ns) xmlFree(qname_level_set->list_array[j].ns);
+                if (NULL!=qname_level_set->list_array[j].ln) opcHelperFree(qname_level_set->allocator, qname_level_set->list_array[j].ln);
+                if (NULL!=qname_level_set->list_array[j].ns) opcHelperFree(qname_level_set->allocator, qname_level_set->list_array[j].ns);
             } else {
                 if (qname_level_set->list_array[j].level>qname_level_set->max_level) {
                     qname_level_set->max_level=qname_level_set->list_array[j].level;
@@ -73,7 +79,7 @@ bool mceQNameLevelCleanup(mceQNameLevelSet_t *qname_level_set, uint32_t level) {
 bool mceSkipStackPush(mceSkipStack_t *skip_stack, uint32_t level_start, uint32_t level_end, mceSkipState_t state) {
     bool ret=false;
     mceSkipItem_t *new_stack_array=NULL;
-    if (NULL!=(new_stack_array=(mceSkipItem_t *)xmlRealloc(skip_stack->stack_array, (1+skip_stack->stack_items)*sizeof(*skip_stack->stack_array)))) {
+    if (NULL!=(new_stack_array=(mceSkipItem_t *)mceEnsureItem(skip_stack->allocator, skip_stack->stack_array, skip_stack->stack_items, sizeof(*skip_stack->stack_array)))) {
         skip_stack->stack_array=new_stack_array;
         memset(&skip_stack->stack_array[skip_stack->stack_items], 0, sizeof(skip_stack->stack_array[skip_stack->stack_items]));
         skip_stack->stack_array[skip_stack->stack_items].level_start=level_start;
@@ -101,7 +107,22 @@ bool mceSkipStackSkip(mceSkipStack_t *skip_stack, uint32_t level) {
 }
 
 bool mceCtxInit(mceCtx_t *ctx) {
+    return mceCtxInitEx(ctx, NULL);
+}
+
+bool mceCtxInitEx(mceCtx_t *ctx, const opcAllocator *allocator) {
     memset(ctx, 0, sizeof(*ctx));
+    ctx->allocator=allocator;
+    ctx->ignorable_set.allocator=allocator;
+    ctx->understands_set.allocator=allocator;
+    ctx->processcontent_set.allocator=allocator;
+    ctx->suspended_set.allocator=allocator;
+#if (MCE_NAMESPACE_SUBSUMPTION_ENABLED)
+    ctx->subsume_namespace_set.allocator=allocator;
+    ctx->subsume_exclude_set.allocator=allocator;
+    ctx->subsume_prefix_set.allocator=allocator;
+#endif
+    ctx->skip_stack.allocator=allocator;
     mceCtxSuspendProcessing(ctx, BAD_CAST("http://schemas.openxmlformats.org/presentationml/2006/main"), BAD_CAST("extLst"));
     return true;
 }
@@ -123,15 +144,15 @@ bool mceCtxCleanup(mceCtx_t *ctx) {
     OPC_ENSURE(mceQNameLevelCleanup(&ctx->subsume_prefix_set, 0));
 #endif
     
-    if (NULL!=ctx->ignorable_set.list_array) xmlFree(ctx->ignorable_set.list_array);
-    if (NULL!=ctx->understands_set.list_array) xmlFree(ctx->understands_set.list_array);
-    if (NULL!=ctx->skip_stack.stack_array) xmlFree(ctx->skip_stack.stack_array);
-    if (NULL!=ctx->processcontent_set.list_array) xmlFree(ctx->processcontent_set.list_array);
-    if (NULL!=ctx->suspended_set.list_array) xmlFree(ctx->suspended_set.list_array);
+    if (NULL!=ctx->ignorable_set.list_array) opcHelperFree(ctx->allocator, ctx->ignorable_set.list_array);
+    if (NULL!=ctx->understands_set.list_array) opcHelperFree(ctx->allocator, ctx->understands_set.list_array);
+    if (NULL!=ctx->skip_stack.stack_array) opcHelperFree(ctx->allocator, ctx->skip_stack.stack_array);
+    if (NULL!=ctx->processcontent_set.list_array) opcHelperFree(ctx->allocator, ctx->processcontent_set.list_array);
+    if (NULL!=ctx->suspended_set.list_array) opcHelperFree(ctx->allocator, ctx->suspended_set.list_array);
 #if (MCE_NAMESPACE_SUBSUMPTION_ENABLED)
-    if (NULL!=ctx->subsume_namespace_set.list_array) xmlFree(ctx->subsume_namespace_set.list_array);
-    if (NULL!=ctx->subsume_exclude_set.list_array) xmlFree(ctx->subsume_exclude_set.list_array);
-    if (NULL!=ctx->subsume_prefix_set.list_array) xmlFree(ctx->subsume_prefix_set.list_array);
+    if (NULL!=ctx->subsume_namespace_set.list_array) opcHelperFree(ctx->allocator, ctx->subsume_namespace_set.list_array);
+    if (NULL!=ctx->subsume_exclude_set.list_array) opcHelperFree(ctx->allocator, ctx->subsume_exclude_set.list_array);
+    if (NULL!=ctx->subsume_prefix_set.list_array) opcHelperFree(ctx->allocator, ctx->subsume_prefix_set.list_array);
 #endif
     return true;
 }
@@ -79,6 +79,7 @@ extern "C" {
         mceQNameLevel_t *list_array;
         uint32_t list_items;
         uint32_t max_level;
+        const opcAllocator *allocator; // NULL for xmlMalloc
     } mceQNameLevelSet_t;
 
     /**
@@ -87,6 +88,7 @@ extern "C" {
     typedef struct MCE_SKIP_STACK {
         mceSkipItem_t *stack_array;
         uint32_t stack_items;
+        const opcAllocator *allocator; // NULL for xmlMalloc
     } mceSkipStack_t;
 
 
@@ -115,6 +117,7 @@ extern "C" {
         mceError_t error;
         bool mce_disabled;        
         uint32_t suspended_level;
+        const opcAllocator *allocator; // NULL for xmlMalloc, see mceCtxInitEx
     } mceCtx_t;
 
     /**
@@ -158,6 +161,12 @@ extern "C" {
     */
     bool mceCtxInit(mceCtx_t *ctx);
 
+    /**
+      Initialize the mceCtx_t \c ctx. All sets and stacks of \c ctx are allocated by \c allocator, which must 
+      outlive \c ctx.
+    */
+    bool mceCtxInitEx(mceCtx_t *ctx, const opcAllocator *allocator);
+
     /**
       Cleanup, i.e. release all resourced from the mceCtx_t \c ctx.
     */
@@ -30,10 +30,15 @@
  OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <opc/mce/textreader.h>
+#include <opc/helper.h>
 
 int mceTextReaderInit(mceTextReader_t *mceTextReader, xmlTextReaderPtr reader) {
+    return mceTextReaderInitEx(mceTextReader, reader, NULL);
+}
+
+int mceTextReaderInitEx(mceTextReader_t *mceTextReader, xmlTextReaderPtr reader, const opcAllocator *allocator) {
     memset(mceTextReader, 0, sizeof(*mceTextReader));
-    mceCtxInit(&mceTextReader->mceCtx);
+    mceCtxInitEx(&mceTextReader->mceCtx, allocator);
     mceTextReader->reader=reader;
     return (NULL!=mceTextReader->reader?0:-1);
 }
@@ -45,9 +50,9 @@ int mceTextReaderCleanup(mceTextReader_t *mceTextReader) {
     return 0;
 }
 
-static xmlChar *xmlStrDupArray(const xmlChar *value) {
+static xmlChar *xmlStrDupArray(const opcAllocator *allocator, const xmlChar *value) {
     uint32_t len=xmlStrlen(value);
-    xmlChar *ret=(xmlChar *)xmlMalloc((2+len)*sizeof(xmlChar));
+    xmlChar *ret=(xmlChar *)opcHelperMalloc(allocator, (2+len)*sizeof(xmlChar));
     uint32_t j=0;
     for(uint32_t i=0;i<len;i++) {
         while(i<len && (value[i]==' ' || value[i]=='\t' || value[i]=='\r' || value[i]=='\n')) i++; // skip preceeding spaces
@@ -123,7 +128,7 @@ static void mceTextReaderProcessAttributes(xmlTextReader *reader, mceCtx_t *ctx,
             do {
                 if (0==xmlStrcmp(BAD_CAST("Ignorable"), xmlTextReaderConstLocalName(reader)) &&
                     0==xmlStrcmp(BAD_CAST(ns_mce), xmlTextReaderConstNamespaceUri(reader))) {
-                        xmlChar *v=xmlStrDupArray(xmlTextReaderConstValue(reader));
+                        xmlChar *v=xmlStrDupArray(ctx->allocator, xmlTextReaderConstValue(reader));
                         int prefix_len=0;
                         for(xmlChar *prefix=xmlStrArrayFirst(v, &prefix_len);xmlStrArrayValid(prefix);prefix=xmlStrArrayNext(prefix, &prefix_len)) {
                             xmlChar *ns_=xmlTextReaderLookupNamespace(reader, prefix);
@@ -132,10 +137,10 @@ static void mceTextReaderProcessAttributes(xmlTextReader *reader, mceCtx_t *ctx,
                             }
                             xmlFree(ns_);
                         }
-                        xmlFree(v);
+                        opcHelperFree(ctx->allocator, v);
                 } else if (0==xmlStrcmp(BAD_CAST("ProcessContent"), xmlTextReaderConstLocalName(reader)) &&
                            0==xmlStrcmp(BAD_CAST(ns_mce), xmlTextReaderConstNamespaceUri(reader))) {
-                        xmlChar *v=xmlStrDupArray(xmlTextReaderConstValue(reader));
+                        xmlChar *v=xmlStrDupArray(ctx->allocator, xmlTextReaderConstValue(reader));
                         int qname_len=0;
                         for(xmlChar *qname=xmlStrArrayFirst(v, &qname_len);xmlStrArrayValid(qname);qname=xmlStrArrayNext(qname, &qname_len)) {
                             int prefix=0; while(qname[prefix]!=':' && qname[prefix]!=0) prefix++;
@@ -147,14 +152,15 @@ static void mceTextReaderProcessAttributes(xmlTextReader *reader, mceCtx_t *ctx,
                             };
                             xmlChar *ns_=xmlTextReaderLookupNamespace(reader, qname+prefix);
                             if (NULL!=ns_ && NULL==mceQNameLevelLookup(&ctx->understands_set, ns_, NULL, false)) {
-                                OPC_ENSURE(mceQNameLevelAdd(&ctx->processcontent_set, ns_, xmlStrdup(qname+ln), level));
+                                OPC_ENSURE(mceQNameLevelAdd(&ctx->processcontent_set, ns_, qname+ln, level));
 
                             }
+                            if (NULL!=ns_) xmlFree(ns_);
                         }
-                        xmlFree(v);
+                        opcHelperFree(ctx->allocator, v);
                 } else if (0==xmlStrcmp(BAD_CAST("MustUnderstand"), xmlTextReaderConstLocalName(reader)) &&
                            0==xmlStrcmp(BAD_CAST(ns_mce), xmlTextReaderConstNamespaceUri(reader))) {
-                        xmlChar *v=xmlStrDupArray(xmlTextReaderConstValue(reader));
+                        xmlChar *v=xmlStrDupArray(ctx->allocator, xmlTextReaderConstValue(reader));
                         int prefix_len=0;
                         for(xmlChar *prefix=xmlStrArrayFirst(v, &prefix_len);xmlStrArrayValid(prefix);prefix=xmlStrArrayNext(prefix, &prefix_len)) {
                             xmlChar *ns_=xmlTextReaderLookupNamespace(reader, prefix);
@@ -162,7 +168,7 @@ static void mceTextReaderProcessAttributes(xmlTextReader *reader, mceCtx_t *ctx,
                                 mceRaiseError(reader, ctx, MCE_ERROR_MUST_UNDERSTAND, BAD_CAST("MustUnderstand namespace \"%s\""), ns_);
                             }
                         }
-                        xmlFree(v);
+                        opcHelperFree(ctx->allocator, v);
 #if (MCE_NAMESPACE_SUBSUMPTION_ENABLED)
                 } else if (0==xmlStrcmp(BAD_CAST(ns_xml), xmlTextReaderConstNamespaceUri(reader))) {
                     mceQNameLevel_t *qnl=mceQNameLevelLookup(&ctx->subsume_prefix_set, xmlTextReaderConstValue(reader), NULL, true);
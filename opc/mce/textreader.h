@@ -86,6 +86,12 @@ extern "C" {
     */
     int mceTextReaderInit(mceTextReader_t *mceTextReader, xmlTextReaderPtr reader);
 
+    /**
+      Like \ref mceTextReaderInit, but the MCE state is allocated by \c allocator (\a NULL selects xmlMalloc).
+      \see mceCtxInitEx
+    */
+    int mceTextReaderInitEx(mceTextReader_t *mceTextReader, xmlTextReaderPtr reader, const opcAllocator *allocator);
+
     /**
       Cleanup MCE reader, i.e. free all resources. Also calls xmlTextReaderClose and xmlFreeTextReader.
       \see http://xmlsoft.org/html/libxml-xmlreader.html#xmlTextReaderClose
@@ -30,6 +30,7 @@
  OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 #include <opc/mce/textwriter.h>
+#include <opc/helper.h>
 
 struct MCE_TEXTWRITER_STRUCT {
     xmlTextWriterPtr writer;
@@ -37,19 +38,27 @@ struct MCE_TEXTWRITER_STRUCT {
     mceQNameLevelSet_t registered_set;
     mceQNameLevelSet_t processcontent_set;
     const xmlChar *ns_mce;
+    const opcAllocator *allocator;
 };
 
 
 mceTextWriter *mceTextWriterCreateIO(xmlOutputWriteCallback iowrite, xmlOutputCloseCallback  ioclose, void *ioctx, xmlCharEncodingHandlerPtr encoder) {
-    mceTextWriter *w=(mceTextWriter*)xmlMalloc(sizeof(mceTextWriter));
+    return mceTextWriterCreateIOEx(iowrite, ioclose, ioctx, encoder, NULL);
+}
+
+mceTextWriter *mceTextWriterCreateIOEx(xmlOutputWriteCallback iowrite, xmlOutputCloseCallback  ioclose, void *ioctx, xmlCharEncodingHandlerPtr encoder, const opcAllocator *allocator) {
+    mceTextWriter *w=(mceTextWriter*)opcHelperMalloc(allocator, sizeof(mceTextWriter));
     if (NULL!=w) {
         memset(w, 0, sizeof(*w));
+        w->allocator=allocator;
+        w->registered_set.allocator=allocator;
+        w->processcontent_set.allocator=allocator;
         xmlOutputBufferPtr out=xmlOutputBufferCreateIO(iowrite, ioclose, ioctx, encoder);
         w->writer=xmlNewTextWriter(out);
         if (NULL==w->writer) {
             // creation failed
             xmlOutputBufferClose(out);
-            xmlFree(w);
+            opcHelperFree(allocator, w);
             w=NULL;
         } else {
             // creation OK
@@ -64,9 +73,9 @@ int mceTextWriterFree(mceTextWriter *w) {
     int ret=0;
     if (NULL!=w) {
         xmlFreeTextWriter(w->writer);
-        if (NULL!=w->registered_set.list_array) xmlFree(w->registered_set.list_array);
-        if (NULL!=w->processcontent_set.list_array) xmlFree(w->processcontent_set.list_array);
-        xmlFree(w);
+        if (NULL!=w->registered_set.list_array) opcHelperFree(w->allocator, w->registered_set.list_array);
+        if (NULL!=w->processcontent_set.list_array) opcHelperFree(w->allocator, w->processcontent_set.list_array);
+        opcHelperFree(w->allocator, w);
         ret=1;
     }
     return ret;
@@ -151,7 +160,7 @@ int mceTextWriterStartElement(mceTextWriter *w, const xmlChar *ns, const xmlChar
                     assert(NULL!=qName); // namespace not registered?
                     if (NULL!=qName) {
                         uint32_t len=(v_len>0?xmlStrlen(BAD_CAST(" ")):0)+xmlStrlen(qName->ln)+xmlStrlen(BAD_CAST(":"))+xmlStrlen(w->processcontent_set.list_array[i].ln)+1;
-                        v=(xmlChar *)xmlRealloc(v, v_len+len);
+                        v=(xmlChar *)opcHelperRealloc(w->allocator, v, v_len+len);
                         if (v_len>0) { v[v_len++]=' '; len--; }
                         int l=xmlStrPrintf(v+v_len, len, BAD_CAST("%s:%s"), qName->ln, w->processcontent_set.list_array[i].ln);
                         assert(1+l==len); // cause by terminating "0"
@@ -165,7 +174,7 @@ int mceTextWriterStartElement(mceTextWriter *w, const xmlChar *ns, const xmlChar
                 if (NULL!=mceQName) {
                     xmlTextWriterWriteAttributeNS(w->writer, mceQName->ln, BAD_CAST("ProcessContent"), NULL, v);
                 }
-                xmlFree(v); v=NULL;
+                opcHelperFree(w->allocator, v); v=NULL;
             }
         }
     } else {
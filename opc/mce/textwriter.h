@@ -70,6 +70,11 @@ extern "C" {
       */
     mceTextWriter *mceTextWriterCreateIO(xmlOutputWriteCallback iowrite, xmlOutputCloseCallback  ioclose, void *ioctx, xmlCharEncodingHandlerPtr encoder);
 
+    /**
+      Like \ref mceTextWriterCreateIO, but the writer and its MCE state are allocated by \c allocator (\a NULL selects xmlMalloc).
+      */
+    mceTextWriter *mceTextWriterCreateIOEx(xmlOutputWriteCallback iowrite, xmlOutputCloseCallback  ioclose, void *ioctx, xmlCharEncodingHandlerPtr encoder, const opcAllocator *allocator);
+
     /**
       Helper which create a new MCE text writer for a FILE handle.
       */
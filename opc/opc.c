@@ -30,10 +30,12 @@
  OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include <opc/opc.h>
+#include <opc/helper.h>
 #include <libxml/xmlreader.h>
 
 opc_error_t opcInitLibrary() {
     xmlInitParser();
+    opcHelperCrc32Init();
     return OPC_ERROR_NONE;
 }
 
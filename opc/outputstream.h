@@ -53,6 +53,38 @@ extern "C" {
       */
     opcContainerOutputStream* opcContainerCreateOutputStream(opcContainer *container, const xmlChar *name, opcCompressionOption_t compression_option);
 
+    /** 
+      Like \ref opcContainerCreateOutputStream, but the data is compressed into a buffer of the stream and the part is 
+      appended to the \c container when the stream is closed, replacing its previous content. 
+      Different detached streams can be written by different threads at the same time, since \ref opcContainerWriteOutputStream
+      does not touch the \c container. Creating and closing streams must not run concurrently with other calls on the 
+      \c container, i.e. the parts are appended in the order in which their streams are closed.
+      If the container was opened with an allocator, it must be thread-safe.
+      \code
+      opcContainerOutputStream *out[2];
+      out[0]=opcContainerCreateDetachedOutputStream(c, BAD_CAST("xl/worksheets/sheet1.xml"), OPC_COMPRESSIONOPTION_NORMAL);
+      out[1]=opcContainerCreateDetachedOutputStream(c, BAD_CAST("xl/worksheets/sheet2.xml"), OPC_COMPRESSIONOPTION_NORMAL);
+      // ...write out[0] and out[1] from two threads and join them...
+      opcContainerCloseOutputStream(out[0]);
+      opcContainerCloseOutputStream(out[1]);
+      \endcode
+      \note Make sure the part exists! 
+      \see opcPartCreate.
+      */
+    opcContainerOutputStream* opcContainerCreateDetachedOutputStream(opcContainer *container, const xmlChar *name, opcCompressionOption_t compression_option);
+
+    /**
+      Compresses the \c stream with up to \c threads threads, or one per CPU if \c threads is 0, but at most 
+      \ref OPC_MAX_THREADS. The data is split into
+      blocks of \ref OPC_PARALLEL_DEFLATE_BLOCK_SIZE bytes, which are deflated at the same time, each using the end of
+      the previous block as dictionary. The result is a single regular deflate stream, only slightly larger than a
+      sequentially compressed one. Use this for large parts such as big worksheets or media.
+      Must be called before the first \ref opcContainerWriteOutputStream. Has no effect for stored parts or if a 
+      custom codec is installed with \ref opcZipSetDefaultCodec.
+      \return Returns OPC_ERROR_STREAM if data has been written already.
+      */
+    opc_error_t opcContainerSetOutputStreamThreads(opcContainerOutputStream* stream, uint32_t threads);
+
     /**
       Write \c buffer_len bytes from \c buffer to \c stream. 
       \return Returns the number of bytes written.
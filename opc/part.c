@@ -95,18 +95,29 @@ opc_error_t opcPartDelete(opcContainer *container, const xmlChar *absolutePath)
 
 
 opcPart opcPartGetFirst(opcContainer *container) {
+    if (NULL!=container && !container->thread_safe) container->part_cursor=0;
     return (NULL!=container && container->part_items>0?container->part_array[0].name:OPC_PART_INVALID);
 }
 
 opcPart opcPartGetNext(opcContainer *container, opcPart part) {
-    opcContainerPart *cp=(NULL!=container?opcContainerInsertPart(container, part, false):NULL);
+    opcContainerPart *cp=NULL;
+    if (NULL!=container && container->part_cursor<container->part_items && container->part_array[container->part_cursor].name==part) {
+        cp=&container->part_array[container->part_cursor]; // usual iteration, no lookup needed
+    } else if (NULL!=container) {
+        cp=opcContainerInsertPart(container, part, false);
+    }
     if (NULL!=cp) {
         do { cp++; } while(cp<container->part_array+container->part_items && -1==cp->first_segment_id);
     }
-    return (NULL!=cp && cp<container->part_array+container->part_items?cp->name:NULL);
+    if (NULL!=cp && cp<container->part_array+container->part_items) {
+        if (!container->thread_safe) container->part_cursor=(uint32_t)(cp-container->part_array);
+        return cp->name;
+    } else {
+        return NULL;
+    }
 }
 
-size_t opcPartGetSize(opcContainer *c, opcPart part) {
+opc_ofs_t opcPartGetSize(opcContainer *c, opcPart part) {
    assert(OPC_PART_INVALID!=part);
     opcContainerPart *cp=(OPC_PART_INVALID!=part?opcContainerInsertPart(c, part, false):NULL);
     if (NULL!=cp && cp->first_segment_id>=0 && cp->first_segment_id<c->storage->segment_items) {
@@ -109,7 +109,7 @@ extern "C" {
     /**
       Returns the size in bytes of the \c part.
       */
-    size_t opcPartGetSize(opcContainer *c, opcPart part);
+    opc_ofs_t opcPartGetSize(opcContainer *c, opcPart part);
 
 #ifdef __cplusplus
 } /* extern "C" */
@@ -33,21 +33,25 @@
 #include "internal.h"
 
 
-opcContainerRelation *opcContainerFindRelationByType(opcContainer *container, opcContainerRelation *relation_array, uint32_t relation_items, const xmlChar *mimeType) {
-    for(uint32_t i=0;i<relation_items;i++) {
-        if (0==xmlStrcmp(relation_array[i].relation_type, mimeType)) {
-            return &relation_array[i];
-        }
+static opcContainerRelation* _opcRelationFindByType(opcContainer *container, opcPart part, const xmlChar *type, opcContainerRelation *after) {
+    if (OPC_PART_INVALID==part) {
+        opcContainerLoadRelations(container, NULL);
+        return opcContainerFindRelationByType(container, container->relation_array, container->relation_items, &container->relation_type_index, type, after);
+    } else {
+        opcContainerPart *cp=opcContainerInsertPart(container, part, false);
+        if (NULL!=cp) opcContainerLoadRelations(container, cp);
+        return (cp!=NULL?opcContainerFindRelationByType(container, cp->relation_array, cp->relation_items, &cp->relation_type_index, type, after):NULL);
     }
-    return NULL;
 }
 
 
 static opcContainerRelation* _opcRelationFind(opcContainer *container, opcPart part, opcRelation relation) {
     if (OPC_PART_INVALID==part) {
+        opcContainerLoadRelations(container, NULL);
         return opcContainerFindRelation(container, container->relation_array, container->relation_items, relation);
     } else {
         opcContainerPart *cp=opcContainerInsertPart(container, part, false);
+        if (NULL!=cp) opcContainerLoadRelations(container, cp);
         return (cp!=NULL?opcContainerFindRelation(container, cp->relation_array, cp->relation_items, relation):NULL);
     }
 }
@@ -55,18 +59,20 @@ static opcContainerRelation* _opcRelationFind(opcContainer *container, opcPart p
 opcRelation opcRelationFind(opcContainer *container, opcPart part, const xmlChar *relationId, const xmlChar *mimeType) {
     opcContainerRelation *rel=NULL;
     if (OPC_PART_INVALID==part) {
+        opcContainerLoadRelations(container, NULL);
         if (NULL!=relationId) {
             rel=opcContainerFindRelationById(container, container->relation_array, container->relation_items, relationId);
         } else if (NULL!=mimeType) {
-            rel=opcContainerFindRelationByType(container, container->relation_array, container->relation_items, mimeType);
+            rel=opcContainerFindRelationByType(container, container->relation_array, container->relation_items, &container->relation_type_index, mimeType, NULL);
         }
     } else {
         opcContainerPart *cp=opcContainerInsertPart(container, part, false);
         if (NULL!=cp) {
+            opcContainerLoadRelations(container, cp);
             if (NULL!=relationId) {
                 rel=opcContainerFindRelationById(container, cp->relation_array, cp->relation_items, relationId);
             } else if (NULL!=mimeType) {
-                rel=opcContainerFindRelationByType(container, cp->relation_array, cp->relation_items, mimeType);
+                rel=opcContainerFindRelationByType(container, cp->relation_array, cp->relation_items, &cp->relation_type_index, mimeType, NULL);
             }
         }
     }
@@ -93,9 +99,11 @@ const xmlChar *opcRelationGetExternalTarget(opcContainer *container, opcPart par
 
 opcRelation opcRelationFirst(opcContainer *container, opcPart part) {
     if (OPC_PART_INVALID==part) {
+        opcContainerLoadRelations(container, NULL);
         return (container->relation_items>0?container->relation_array[0].relation_id:OPC_RELATION_INVALID);
     } else {
         opcContainerPart *cp=opcContainerInsertPart(container, part, false);
+        if (NULL!=cp) opcContainerLoadRelations(container, cp);
         return (NULL!=cp && cp->relation_items>0?cp->relation_array[0].relation_id:OPC_RELATION_INVALID);
     }
 }
@@ -104,11 +112,13 @@ opcRelation opcRelationNext(opcContainer *container, opcPart part, opcRelation r
     opcContainerRelation *relation_array=NULL;
     uint32_t relation_items=0;
     if (OPC_PART_INVALID==part) {
+        opcContainerLoadRelations(container, NULL);
         relation_array=container->relation_array;
         relation_items=container->relation_items;
     } else {
         opcContainerPart *cp=opcContainerInsertPart(container, part, false);
         if (NULL!=cp) {
+            opcContainerLoadRelations(container, cp);
             relation_array=cp->relation_array;
             relation_items=cp->relation_items;
         }
@@ -125,6 +135,159 @@ opcRelation opcRelationNext(opcContainer *container, opcPart part, opcRelation r
     }
 }
 
+opcRelation opcRelationFirstOfType(opcContainer *container, opcPart part, const xmlChar *type) {
+    opcContainerRelation *rel=(NULL!=type?_opcRelationFindByType(container, part, type, NULL):NULL);
+    return (NULL!=rel?rel->relation_id:OPC_RELATION_INVALID);
+}
+
+opcRelation opcRelationNextOfType(opcContainer *container, opcPart part, opcRelation relation) {
+    opcContainerRelation *after=_opcRelationFind(container, part, relation);
+    opcContainerRelation *rel=(NULL!=after?_opcRelationFindByType(container, part, NULL, after):NULL);
+    return (NULL!=rel?rel->relation_id:OPC_RELATION_INVALID);
+}
+
+opcRelation opcRelationFirstIncoming(opcContainer *container, opcPart part, opcPart *source) {
+    opcContainerPart *cp=opcContainerInsertPart(container, part, false);
+    opcContainerIncomingRelation *in=(NULL!=cp?opcContainerFindIncomingRelation(container, cp->name, NULL, OPC_RELATION_INVALID):NULL);
+    if (NULL!=source) *source=(NULL!=in?(opcPart)in->source:OPC_PART_INVALID);
+    return (NULL!=in?in->relation_id:OPC_RELATION_INVALID);
+}
+
+opcRelation opcRelationNextIncoming(opcContainer *container, opcPart part, opcPart *source, opcRelation relation) {
+    opcContainerPart *cp=opcContainerInsertPart(container, part, false);
+    opcContainerPart *sp=(NULL!=source && OPC_PART_INVALID!=*source?opcContainerInsertPart(container, *source, false):NULL);
+    opcContainerIncomingRelation *in=NULL;
+    if (NULL!=cp && NULL!=source && (OPC_PART_INVALID==*source || NULL!=sp) && OPC_RELATION_INVALID!=relation) {
+        in=opcContainerFindIncomingRelation(container, cp->name, (NULL!=sp?sp->name:NULL), relation);
+    }
+    if (NULL!=source) *source=(NULL!=in?(opcPart)in->source:OPC_PART_INVALID);
+    return (NULL!=in?in->relation_id:OPC_RELATION_INVALID);
+}
+
+typedef struct OPC_RELATION_VISIT_STRUCT {
+    opcPart source; // OPC_PART_INVALID for the root relations
+    opcRelation relation; // the relation part was reached by, or the next relation of part on the depth first stack
+    opcPart part;
+    uint32_t depth;
+} opcRelationVisit;
+
+static opcRelation opcRelationTraverseNext(opcContainer *container, opcPart part, const xmlChar *type, opcRelation relation) {
+    if (OPC_RELATION_INVALID==relation) {
+        return (NULL!=type?opcRelationFirstOfType(container, part, type):opcRelationFirst(container, part));
+    } else {
+        return (NULL!=type?opcRelationNextOfType(container, part, relation):opcRelationNext(container, part, relation));
+    }
+}
+
+static opcContainerPart *opcRelationTraverseTarget(opcContainer *container, opcPart source, opcRelation relation, uint32_t *visited, uint32_t depth, uint32_t max_depth) {
+    // returns the target of relation if it exists and has not been visited yet, and marks it visited.
+    opcPart target=opcRelationGetInternalTarget(container, source, relation);
+    opcContainerPart *cp=(OPC_PART_INVALID!=target && (0==max_depth || depth<=max_depth)?opcContainerInsertPart(container, target, false):NULL);
+    if (NULL!=cp && (uint32_t)-1!=cp->first_segment_id) {
+        uint32_t const i=(uint32_t)(cp-container->part_array);
+        if (0==(visited[i/32]&(1U<<(i%32)))) {
+            visited[i/32]|=1U<<(i%32);
+            return cp;
+        }
+    }
+    return NULL;
+}
+
+static void opcRelationTraverseExpand(opcContainer *container, const opcRelationVisit *from, const xmlChar *type, uint32_t *visited, uint32_t max_depth, opcRelationVisit *visit_array, uint32_t *visit_items) {
+    opcRelationVisit const _from=*from; // from might point into visit_array
+    for(opcRelation rel=opcRelationTraverseNext(container, _from.part, type, OPC_RELATION_INVALID);
+        OPC_RELATION_INVALID!=rel;
+        rel=opcRelationTraverseNext(container, _from.part, type, rel)) {
+        opcContainerPart *cp=opcRelationTraverseTarget(container, _from.part, rel, visited, _from.depth+1, max_depth);
+        if (NULL!=cp) {
+            opcRelationVisit *next=&visit_array[(*visit_items)++];
+            next->source=_from.part;
+            next->relation=rel;
+            next->part=cp->name;
+            next->depth=_from.depth+1;
+        }
+    }
+}
+
+opc_error_t opcRelationTraverse(opcContainer *container, opcPart part, const xmlChar *type, uint32_t max_depth, int flags, opcRelationVisitCallback *visit, void *userctx) {
+    opc_error_t err=OPC_ERROR_NONE;
+    uint32_t const visited_size=(container->part_items+31)/32+1;
+    uint32_t *visited=(uint32_t *)opcHelperMalloc(container->io.allocator, visited_size*sizeof(uint32_t));
+    opcRelationVisit *visit_array=(opcRelationVisit *)opcHelperMalloc(container->io.allocator, (container->part_items+1)*sizeof(opcRelationVisit));
+    opcRelationVisit *stack_array=(0!=(flags&OPC_TRAVERSE_DEPTH_FIRST)?(opcRelationVisit *)opcHelperMalloc(container->io.allocator, (container->part_items+1)*sizeof(opcRelationVisit)):NULL);
+    uint32_t visit_items=0;
+    if (NULL==visited || NULL==visit_array || (0!=(flags&OPC_TRAVERSE_DEPTH_FIRST) && NULL==stack_array)) {
+        err=OPC_ERROR_MEMORY;
+    } else {
+        opc_bzero_mem(visited, visited_size*sizeof(uint32_t));
+        opcRelationVisit start;
+        start.source=OPC_PART_INVALID;
+        start.relation=OPC_RELATION_INVALID;
+        start.part=OPC_PART_INVALID;
+        start.depth=0;
+        if (OPC_PART_INVALID!=part) {
+            opcContainerPart *cp=opcContainerInsertPart(container, part, false);
+            if (NULL!=cp) {
+                uint32_t const i=(uint32_t)(cp-container->part_array);
+                visited[i/32]|=1U<<(i%32);
+                start.part=cp->name;
+                visit_array[visit_items++]=start;
+            } else {
+                err=OPC_ERROR_STREAM;
+            }
+        }
+        if (OPC_ERROR_NONE!=err) {
+            // unknown start part
+        } else if (NULL!=stack_array) {
+            uint32_t stack_items=0;
+            stack_array[stack_items++]=start; // relation is the last relation followed from part
+            while(stack_items>0) {
+                opcRelationVisit *top=&stack_array[stack_items-1];
+                top->relation=opcRelationTraverseNext(container, top->part, type, top->relation);
+                if (OPC_RELATION_INVALID==top->relation) {
+                    stack_items--;
+                } else {
+                    opcContainerPart *cp=opcRelationTraverseTarget(container, top->part, top->relation, visited, top->depth+1, max_depth);
+                    if (NULL!=cp) {
+                        opcRelationVisit *next=&visit_array[visit_items++];
+                        next->source=top->part;
+                        next->relation=top->relation;
+                        next->part=cp->name;
+                        next->depth=top->depth+1;
+                        assert(stack_items<=container->part_items); // every part is pushed once
+                        stack_array[stack_items]=*next;
+                        stack_array[stack_items++].relation=OPC_RELATION_INVALID;
+                    }
+                }
+            }
+        } else {
+            // visit_array is the queue, every part is queued once
+            if (OPC_PART_INVALID==part) {
+                opcRelationTraverseExpand(container, &start, type, visited, max_depth, visit_array, &visit_items);
+            }
+            for(uint32_t i=0;i<visit_items;i++) {
+                opcRelationTraverseExpand(container, &visit_array[i], type, visited, max_depth, visit_array, &visit_items);
+            }
+        }
+        if (OPC_ERROR_NONE==err && 0!=(flags&OPC_TRAVERSE_PREFETCH) && visit_items>0) {
+            uint32_t *segment_array=(uint32_t *)opcHelperMalloc(container->io.allocator, visit_items*sizeof(uint32_t));
+            if (NULL!=segment_array) {
+                for(uint32_t i=0;i<visit_items;i++) {
+                    segment_array[i]=opcContainerInsertPart(container, visit_array[i].part, false)->first_segment_id;
+                }
+                opcZipPrefetchSegments(container->storage, segment_array, visit_items); // only a hint, errors are ignored
+                opcHelperFree(container->io.allocator, segment_array);
+            }
+        }
+        for(uint32_t i=0;OPC_ERROR_NONE==err && NULL!=visit && i<visit_items;i++) {
+            err=visit(userctx, visit_array[i].source, visit_array[i].relation, visit_array[i].part, visit_array[i].depth);
+        }
+    }
+    if (NULL!=visited) opcHelperFree(container->io.allocator, visited);
+    if (NULL!=visit_array) opcHelperFree(container->io.allocator, visit_array);
+    if (NULL!=stack_array) opcHelperFree(container->io.allocator, stack_array);
+    return err;
+}
 
 void opcRelationGetInformation(opcContainer *container, opcPart part, opcRelation relation, const xmlChar **prefix, uint32_t *counter, const xmlChar **type) {
     opcContainerRelation* rel=NULL;
@@ -144,10 +307,13 @@ void opcRelationGetInformation(opcContainer *container, opcPart part, opcRelatio
 
 opc_error_t opcRelationDelete(opcContainer *container, opcPart part, const xmlChar *relationId, const xmlChar *mimeType) {
     opcRelation relation=opcRelationFind(container, part, relationId, mimeType);
+    opcContainerRelation *rel=_opcRelationFind(container, part, relation);
     if (OPC_PART_INVALID==part) {
+        if (NULL!=rel) opcContainerRemoveIncomingRelation(container, NULL, rel);
         return opcContainerDeleteRelation(container, &container->relation_array, &container->relation_items, relation);
     } else {
         opcContainerPart *cp=opcContainerInsertPart(container, part, false);
+        if (NULL!=cp && NULL!=rel) opcContainerRemoveIncomingRelation(container, cp->name, rel);
         return (cp!=NULL?opcContainerDeleteRelation(container, &cp->relation_array, &cp->relation_items, relation):OPC_ERROR_STREAM);
     }
 }
\ No newline at end of file
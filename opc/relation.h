@@ -50,7 +50,7 @@ extern "C" {
 /**
   Constant which represents an invalid relation.
 */
-#define OPC_RELATION_INVALID (-1)
+#define OPC_RELATION_INVALID ((opcRelation)-1)
 
     /**
       Find a relation originating from \c part in \c container with \c relationId and/or \c mimeType.
@@ -96,6 +96,51 @@ extern "C" {
       \see opcRelationFirst
       */
     opcRelation opcRelationNext(opcContainer *container, opcPart part, opcRelation relation);
+
+    /**
+      Returns the first relation of \c part with the relation type \c type or OPC_RELATION_INVALID.
+      Relations are indexed by their type, so this does not scan all relations of \c part.
+      The following code will visit all image relations of a part:
+      \code
+        for(opcRelation rel=opcRelationFirstOfType(c, part, type);
+            OPC_RELATION_INVALID!=rel;
+            rel=opcRelationNextOfType(c, part, rel)) {
+            opcPart image=opcRelationGetInternalTarget(c, part, rel);
+        }
+      \endcode
+      \see opcRelationNextOfType
+      */
+    opcRelation opcRelationFirstOfType(opcContainer *container, opcPart part, const xmlChar *type);
+
+    /**
+      Returns the next relation of \c part with the same type as \c relation or OPC_RELATION_INVALID.
+      \see opcRelationFirstOfType
+      */
+    opcRelation opcRelationNextOfType(opcContainer *container, opcPart part, opcRelation relation);
+
+    /**
+      Returns the first relation targeting \c part or OPC_RELATION_INVALID, i.e. the incoming relations of \c part.
+      \c source is set to the part the relation originates from, OPC_PART_INVALID denotes the root relations.
+      The first call loads all relations of the container, afterwards the incoming relations are 
+      kept up to date by \ref opcRelationAdd, \ref opcRelationDelete and \ref opcPartDelete.
+      The following code will visit all parts referencing \c part:
+      \code
+        opcPart source=OPC_PART_INVALID;
+        for(opcRelation rel=opcRelationFirstIncoming(c, part, &source);
+            OPC_RELATION_INVALID!=rel;
+            rel=opcRelationNextIncoming(c, part, &source, rel)) {
+            printf("%s references %s\n", (OPC_PART_INVALID!=source?source:BAD_CAST("/")), part);
+        }
+      \endcode
+      \see opcRelationNextIncoming
+      */
+    opcRelation opcRelationFirstIncoming(opcContainer *container, opcPart part, opcPart *source);
+
+    /**
+      Returns the incoming relation of \c part after \c relation from \c source and updates \c source.
+      \see opcRelationFirstIncoming
+      */
+    opcRelation opcRelationNextIncoming(opcContainer *container, opcPart part, opcPart *source, opcRelation relation);
     
     /**
       Returns the internal target.
@@ -117,6 +162,40 @@ extern "C" {
       */
     const xmlChar *opcRelationGetType(opcContainer *container, opcPart part, opcRelation relation);
 
+    /**
+      Visit the parts depth first instead of breadth first.
+      \see opcRelationTraverse
+      */
+#define OPC_TRAVERSE_DEPTH_FIRST 0x1
+
+    /**
+      Read all reachable parts ahead, in the order they are stored in the package, before the first part is visited.
+      \see opcRelationTraverse
+      */
+#define OPC_TRAVERSE_PREFETCH 0x2
+
+    /**
+      Called by \ref opcRelationTraverse for every reachable \c part.
+      \c source and \c relation denote the relation \c part was reached by. The start part is visited with 
+      OPC_RELATION_INVALID and a \c depth of 0.
+      Return anything but OPC_ERROR_NONE to stop the traversal.
+      */
+    typedef opc_error_t opcRelationVisitCallback(void *userctx, opcPart source, opcRelation relation, opcPart part, uint32_t depth);
+
+    /**
+      Visits all parts reachable from \c part by internal relations once. If \c part is OPC_PART_INVALID then 
+      the traversal starts at the root relations. Only relations of type \c type are followed unless \c type is NULL.
+      Parts deeper than \c max_depth are not visited unless \c max_depth is 0.
+      \c flags is a combination of OPC_TRAVERSE_DEPTH_FIRST and OPC_TRAVERSE_PREFETCH.
+      The reachable parts are determined before \c visit is called, so \c visit may open the parts.
+      \c visit may be NULL, e.g. to just read the parts ahead with OPC_TRAVERSE_PREFETCH.
+      The following code will read everything a slide references:
+      \code
+        opcRelationTraverse(c, slide, NULL, 0, OPC_TRAVERSE_PREFETCH, load_part, &ctx);
+      \endcode
+      */
+    opc_error_t opcRelationTraverse(opcContainer *container, opcPart part, const xmlChar *type, uint32_t max_depth, int flags, opcRelationVisitCallback *visit, void *userctx);
+
     /** 
       Get information about a relation.
       \see opcRelationFirst
@@ -35,10 +35,11 @@
 opc_error_t opcXmlReaderOpenEx(opcContainer *container, mceTextReader_t *mceTextReader, const xmlChar *partName, bool rels_segment, const char * URL, const char * encoding, int options) {
     opcContainerInputStream* stream=opcContainerOpenInputStreamEx(container, partName, rels_segment);
     if (NULL!=stream) {
-        if (0==mceTextReaderInit(mceTextReader, 
-                                 xmlReaderForIO((xmlInputReadCallback)opcContainerReadInputStream, 
-                                                (xmlInputCloseCallback)opcContainerCloseInputStream, 
-                                                stream, URL, encoding, options))) {
+        if (0==mceTextReaderInitEx(mceTextReader, 
+                                   xmlReaderForIO((xmlInputReadCallback)opcContainerReadInputStream, 
+                                                  (xmlInputCloseCallback)opcContainerCloseInputStream, 
+                                                  stream, URL, encoding, options),
+                                   container->io.allocator)) {
             return OPC_ERROR_NONE;
         } else {
             return OPC_ERROR_STREAM;
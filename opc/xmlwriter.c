@@ -31,6 +31,7 @@
  */
 #include <opc/opc.h>
 #include <opc/mce/textreader.h>
+#include "internal.h"
 
 
 static int opcTextWriterWrite(void * context, const char * buffer, int len) {
@@ -47,7 +48,7 @@ mceTextWriter *mceTextWriterOpen(opcContainer *c, opcPart part, opcCompressionOp
     opcContainerOutputStream *stream=opcContainerCreateOutputStream(c, part, compression_option);
     mceTextWriter *w=NULL;
     if (NULL!=stream) {
-        w=mceTextWriterCreateIO(opcTextWriterWrite, opcTextWriterClose, stream, NULL);
+        w=mceTextWriterCreateIOEx(opcTextWriterWrite, opcTextWriterClose, stream, NULL, c->io.allocator);
     }
     return w;
 }
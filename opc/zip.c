@@ -37,13 +37,42 @@
 #include <stdio.h>
 #include "internal.h"
 
-static void* ensureItem(void **array_, uint32_t items, uint32_t item_size) {
-    *array_=xmlRealloc(*array_, (items+1)*item_size);
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <unistd.h>
+#define OPC_HAVE_PTHREAD
+#endif
+
+#define OPC_DEFLATE_DICT_SIZE (32*1024) // the deflate window, i.e. the dictionary of a parallel deflate job
+
+static void* ensureItem(const opcAllocator *allocator, void **array_, uint32_t items, uint32_t item_size) {
+    // the capacity is implied by the item count: arrays grow in powers of two (starting with 4 items).
+    if (0==items || (items>=4 && 0==(items&(items-1)))) {
+        void *array=opcHelperRealloc(allocator, *array_, (0==items?4:2*items)*item_size);
+        if (NULL==array) return NULL;
+        *array_=array;
+    }
     return *array_;
 }
 
 static opcZipSegment* ensureSegment(opcZip *zip) {
-    return ((opcZipSegment*)ensureItem((void**)&zip->segment_array, zip->segment_items, sizeof(opcZipSegment)))+zip->segment_items;
+    opcZipSegment *array=(opcZipSegment*)ensureItem(zip->io->allocator, (void**)&zip->segment_array, zip->segment_items, sizeof(opcZipSegment));
+    return (NULL!=array?array+zip->segment_items:NULL);
+}
+
+static void opcZipSegmentFreeSeekIndex(opcZip *zip, opcZipSegment *segment) {
+    if (NULL!=segment->seek_index) {
+        for(uint32_t i=0;i<segment->seek_index->point_items;i++) {
+            if (NULL!=segment->seek_index->point_array[i].window) {
+                opcHelperFree(zip->io->allocator, segment->seek_index->point_array[i].window);
+            }
+        }
+        if (NULL!=segment->seek_index->point_array) {
+            opcHelperFree(zip->io->allocator, segment->seek_index->point_array);
+        }
+        opcHelperFree(zip->io->allocator, segment->seek_index);
+        segment->seek_index=NULL;
+    }
 }
 
 
@@ -52,7 +81,7 @@ static inline uint32_t _opcZipFileRead(opcIO_t *io, uint8_t *buf, uint32_t buf_l
     uint32_t ret=0;
     if (OPC_ERROR_NONE==io->state.err) {
         int len=io->_ioread(io->iocontext, (char *)buf, buf_len);
-        if (ret<0) {
+        if (len<0) {
             io->state.err=OPC_ERROR_STREAM;
         } else {
             ret=(uint32_t)len;
@@ -67,7 +96,7 @@ static inline uint32_t _opcZipFileWrite(opcIO_t *io, const uint8_t *buf, uint32_
     uint32_t ret=0;
     if (OPC_ERROR_NONE==io->state.err) {
         int len=io->_iowrite(io->iocontext, (const char *)buf, buf_len);
-        if (ret<0) {
+        if (len<0) {
             io->state.err=OPC_ERROR_STREAM;
         } else {
             ret=(uint32_t)len;
@@ -88,9 +117,9 @@ static inline opc_error_t _opcZipFileClose(opcIO_t *io) {
     return io->state.err;
 }
 
-static inline size_t _opcZipFileSeek(opcIO_t *io, size_t ofs, opcFileSeekMode whence) {
+static inline opc_ofs_t _opcZipFileSeek(opcIO_t *io, opc_ofs_t ofs, opcFileSeekMode whence) {
     assert(NULL!=io && (opcFileSeekSet==whence || opcFileSeekCur==whence || opcFileSeekEnd==whence));
-    size_t abs=io->state.buf_pos;
+    opc_ofs_t abs=io->state.buf_pos;
     if (OPC_ERROR_NONE==io->state.err) {
         switch (whence) {
         case opcFileSeekSet: abs=ofs; break;
@@ -101,7 +130,7 @@ static inline size_t _opcZipFileSeek(opcIO_t *io, size_t ofs, opcFileSeekMode wh
             io->state.err=OPC_ERROR_STREAM;
         } else if (io->state.buf_pos!=abs) {
             if (NULL!=io->_ioseek) {
-                int _ofs=io->_ioseek(io->iocontext, abs);
+                opc_ofs_t _ofs=io->_ioseek(io->iocontext, abs);
                 if (_ofs!=abs) {
                     io->state.err=OPC_ERROR_STREAM;
                 } else {
@@ -115,7 +144,7 @@ static inline size_t _opcZipFileSeek(opcIO_t *io, size_t ofs, opcFileSeekMode wh
     return abs;
 }
 
-static inline opc_error_t _opcZipFileGrow(opcIO_t *io, uint32_t abs) {
+static inline opc_error_t _opcZipFileGrow(opcIO_t *io, opc_ofs_t abs) {
     if (OPC_ERROR_NONE==io->state.err) {
         if (abs>io->file_size) {
             io->file_size=abs; //@TODO add error handling here if e.g. file can not grow because disk is full etc...
@@ -125,10 +154,10 @@ static inline opc_error_t _opcZipFileGrow(opcIO_t *io, uint32_t abs) {
 }
 
 
-opc_error_t _opcZipFileMove(opcIO_t *io, size_t dest, size_t src, size_t len) {
-    uint8_t buf[1024];
+opc_error_t _opcZipFileMove(opcIO_t *io, opc_ofs_t dest, opc_ofs_t src, opc_ofs_t len) {
+    uint8_t buf[16*1024];
     while(len>0) {
-        size_t delta=(dest<src?src-dest:dest-src);
+        opc_ofs_t delta=(dest<src?src-dest:dest-src);
         uint32_t chunk=(delta>sizeof(buf)?(uint32_t)sizeof(buf):(uint32_t)delta);
         if (chunk>len) chunk=len;
         OPC_ENSURE(src==_opcZipFileSeek(io, src, opcFileSeekSet));
@@ -144,7 +173,7 @@ opc_error_t _opcZipFileMove(opcIO_t *io, size_t dest, size_t src, size_t len) {
     return io->state.err;
 }
 
-opc_error_t _opcZipFileTrim(opcIO_t *io, size_t new_size) {
+opc_error_t _opcZipFileTrim(opcIO_t *io, opc_ofs_t new_size) {
     assert(new_size<=io->file_size);
     int ret=(NULL!=io->_iotrim?io->_iotrim(io->iocontext, new_size):-1);
     return (0==ret?OPC_ERROR_NONE:OPC_ERROR_STREAM);
@@ -155,12 +184,142 @@ opc_error_t _opcZipFileFlush(opcIO_t *io) {
     return (0==ret?OPC_ERROR_NONE:OPC_ERROR_STREAM);
 }
 
+static voidpf opcZipZlibAlloc(voidpf opaque, uInt items, uInt size) {
+    return opcHelperMalloc((const opcAllocator *)opaque, (size_t)items*size);
+}
+
+static void opcZipZlibFree(voidpf opaque, voidpf address) {
+    opcHelperFree((const opcAllocator *)opaque, address);
+}
+
+static void opcZipZlibInitStream(z_stream *stream, const opcAllocator *allocator) {
+    opc_bzero_mem(stream, sizeof(*stream)); // i.e. zalloc, zfree and opaque are Z_NULL
+    if (NULL!=allocator) {
+        stream->zalloc=opcZipZlibAlloc;
+        stream->zfree=opcZipZlibFree;
+        stream->opaque=(voidpf)allocator; // also used to free the z_stream itself
+    }
+}
+
+static void *opcZipZlibInflateInit(void *codec_ctx, opc_ofs_t compressed_size, opc_ofs_t uncompressed_size) {
+    (void)compressed_size; (void)uncompressed_size; // zlib finds the end of the stream itself
+    // codec_ctx is the allocator of the zip, see opcZipCreate
+    z_stream *stream=(z_stream *)opcHelperMalloc((const opcAllocator *)codec_ctx, sizeof(z_stream));
+    if (NULL!=stream) {
+        opcZipZlibInitStream(stream, (const opcAllocator *)codec_ctx);
+        if (Z_OK!=inflateInit2(stream, -MAX_WBITS)) {
+            opcHelperFree((const opcAllocator *)codec_ctx, stream); stream=NULL;
+        }
+    }
+    return stream;
+}
+
+static opc_error_t opcZipZlibInflate(void *state, const uint8_t **next_in, uint32_t *avail_in, uint8_t **next_out, uint32_t *avail_out, bool *eof) {
+    z_stream *stream=(z_stream *)state;
+    stream->next_in=(Bytef*)*next_in;
+    stream->avail_in=*avail_in;
+    stream->next_out=*next_out;
+    stream->avail_out=*avail_out;
+    int const ret=inflate(stream, Z_SYNC_FLUSH);
+    *next_in=stream->next_in;
+    *avail_in=stream->avail_in;
+    *next_out=stream->next_out;
+    *avail_out=stream->avail_out;
+    *eof=(Z_STREAM_END==ret);
+    return (Z_OK==ret || Z_STREAM_END==ret?OPC_ERROR_NONE:OPC_ERROR_DEFLATE);
+}
+
+static opc_error_t opcZipZlibInflateEnd(void *state) {
+    const opcAllocator *allocator=(const opcAllocator *)((z_stream *)state)->opaque;
+    int const ret=inflateEnd((z_stream *)state);
+    opcHelperFree(allocator, state);
+    return (Z_OK==ret?OPC_ERROR_NONE:OPC_ERROR_DEFLATE);
+}
+
+static int opcZipZlibLevel(opcCompressionOption_t compression_option) {
+    int level=Z_DEFAULT_COMPRESSION;
+    switch (compression_option) {
+    default: 
+    case OPC_COMPRESSIONOPTION_NORMAL: level=Z_DEFAULT_COMPRESSION; 
+        break;
+    case OPC_COMPRESSIONOPTION_MAXIMUM: level=Z_BEST_COMPRESSION; 
+        break;
+    case OPC_COMPRESSIONOPTION_FAST: level=Z_BEST_SPEED; 
+        break;
+    case OPC_COMPRESSIONOPTION_SUPERFAST: level=Z_BEST_SPEED; 
+        break;
+    }
+    return level;
+}
+
+static void *opcZipZlibDeflateInit(void *codec_ctx, opcCompressionOption_t compression_option) {
+    z_stream *stream=(z_stream *)opcHelperMalloc((const opcAllocator *)codec_ctx, sizeof(z_stream));
+    if (NULL!=stream) {
+        opcZipZlibInitStream(stream, (const opcAllocator *)codec_ctx);
+        if (Z_OK!=deflateInit2(stream, opcZipZlibLevel(compression_option), Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)) {
+            opcHelperFree((const opcAllocator *)codec_ctx, stream); stream=NULL;
+        }
+    }
+    return stream;
+}
+
+static opc_error_t opcZipZlibDeflate(void *state, const uint8_t **next_in, uint32_t *avail_in, uint8_t **next_out, uint32_t *avail_out, bool finish, bool *eof) {
+    z_stream *stream=(z_stream *)state;
+    stream->next_in=(Bytef*)*next_in;
+    stream->avail_in=*avail_in;
+    stream->next_out=*next_out;
+    stream->avail_out=*avail_out;
+    int const ret=deflate(stream, (finish?Z_FINISH:Z_NO_FLUSH));
+    *next_in=stream->next_in;
+    *avail_in=stream->avail_in;
+    *next_out=stream->next_out;
+    *avail_out=stream->avail_out;
+    *eof=(Z_STREAM_END==ret);
+    return (Z_OK==ret || Z_STREAM_END==ret?OPC_ERROR_NONE:OPC_ERROR_DEFLATE);
+}
+
+static opc_error_t opcZipZlibDeflateEnd(void *state) {
+    const opcAllocator *allocator=(const opcAllocator *)((z_stream *)state)->opaque;
+    int const ret=deflateEnd((z_stream *)state);
+    opcHelperFree(allocator, state);
+    return (Z_OK==ret?OPC_ERROR_NONE:OPC_ERROR_DEFLATE);
+}
+
+static const opcZipCodec opcZipZlibCodec={
+    opcZipZlibInflateInit,
+    opcZipZlibInflate,
+    opcZipZlibInflateEnd,
+    opcZipZlibDeflateInit,
+    opcZipZlibDeflate,
+    opcZipZlibDeflateEnd,
+    NULL
+};
+
+static const opcZipCodec *opcZipDefaultCodec=&opcZipZlibCodec;
+
+void opcZipSetDefaultCodec(const opcZipCodec *codec) {
+    opcZipDefaultCodec=(NULL!=codec?codec:&opcZipZlibCodec);
+}
+
+const opcZipCodec *opcZipGetDefaultCodec(void) {
+    return opcZipDefaultCodec;
+}
+
+// Returns the default codec, or zlib_codec if that is zlib, which then allocates with allocator.
+static const opcZipCodec *opcZipInitCodec(opcZipCodec *zlib_codec, const opcAllocator *allocator) {
+    *zlib_codec=opcZipZlibCodec;
+    zlib_codec->codec_ctx=(void*)allocator;
+    return (&opcZipZlibCodec==opcZipDefaultCodec?zlib_codec:opcZipDefaultCodec);
+}
+
 opcZip *opcZipCreate(opcIO_t *io) {
-    opcZip *zip=(opcZip*)xmlMalloc(sizeof(opcZip));
+    opcZip *zip=(opcZip*)opcHelperMalloc(io->allocator, sizeof(opcZip));
     if (NULL!=zip) {
         memset(zip, 0, sizeof(*zip));
         zip->first_free_segment_id=-1;
+        zip->streaming_segment_id=-1;
         zip->io=io; 
+        zip->codec=opcZipInitCodec(&zip->zlib_codec, io->allocator);
     }
     return zip;
 }
@@ -177,17 +336,20 @@ void opcZipClose(opcZip *zip, opcZipSegmentReleaseCallback* releaseCallback) {
         }
         assert(NULL!=zip->io->_ioclose);
         OPC_ENSURE(0==zip->io->_ioclose(zip->io->iocontext));
+        for(uint32_t i=0;i<zip->segment_items;i++) {
+            opcZipSegmentFreeSeekIndex(zip, &zip->segment_array[i]);
+        }
         if (NULL!=zip->segment_array) {
-            xmlFree(zip->segment_array);
+            opcHelperFree(zip->io->allocator, zip->segment_array);
             zip->segment_array=NULL;
         }
-        xmlFree(zip);
+        opcHelperFree(zip->io->allocator, zip);
     }
 }
 
 
 
-static inline opc_error_t _opcZipFileSeekRawState(opcIO_t *io, opcFileRawState *rawState, uint32_t new_ofs) {
+static inline opc_error_t _opcZipFileSeekRawState(opcIO_t *io, opcFileRawState *rawState, opc_ofs_t new_ofs) {
     if (OPC_ERROR_NONE==rawState->err) {
         rawState->err=io->state.err;
     }
@@ -259,15 +421,24 @@ static inline int opcZipRawWriteU32(opcIO_t *io, opcFileRawState *raw, uint32_t
     return i;
 }
 
+static inline int opcZipRawWriteU64(opcIO_t *io, opcFileRawState *raw, uint64_t val) {
+    int i=0;
+    while(OPC_ERROR_NONE==raw->err && (size_t)i<sizeof(val) && 1==opcZipRawWriteU8(io, raw, (uint8_t)(val>>(i<<3)))) {
+        i++;
+    }
+    return i;
+}
+
 
 static opc_error_t opcZipInitRawBuffer(opcIO_t *io, opcFileRawBuffer *rawBuffer) {
     opc_bzero_mem(rawBuffer, sizeof(*rawBuffer));
     return opcZipInitRawState(io, &rawBuffer->state);;
 }
 
-static inline uint16_t opcZipCalculateHeaderSize(const char *name8, uint16_t name8_len, bool extra, uint16_t *name8_max) {
+static inline uint16_t opcZipCalculateHeaderSize(const char *name8, uint16_t name8_len, bool extra, bool zip64, uint16_t *name8_max) {
+    (void)name8; // only the length is needed
     uint16_t len=(NULL!=name8_max?*name8_max:name8_len);
-    return 4*4+7*2+(extra?4*2:0)+len;
+    return 4*4+7*2+(zip64?4+2*8:0)+(extra?4*2:0)+len;
 }
 
 static uint32_t opcZipRawWriteSegmentHeaderEx(opcIO_t *io, 
@@ -276,71 +447,109 @@ static uint32_t opcZipRawWriteSegmentHeaderEx(opcIO_t *io,
                                                   uint16_t bit_flag,
                                                   uint32_t crc32,
                                                   uint16_t compression_method,
-                                                  size_t compressed_size,
-                                                  size_t uncompressed_size,
+                                                  opc_ofs_t compressed_size,
+                                                  opc_ofs_t uncompressed_size,
                                                   uint16_t header_size,
-                                                  uint16_t growth_hint) {
+                                                  uint16_t growth_hint,
+                                                  bool zip64) {
     uint32_t ret=0;
-    assert(opcZipCalculateHeaderSize(name8, name8_len, false, NULL)<=header_size);
-    bool extra=opcZipCalculateHeaderSize(name8, name8_len, true, NULL)<=header_size;
-    if (opcZipCalculateHeaderSize(name8, name8_len, extra, NULL)<=header_size) {
-        uint16_t padding=(extra?header_size-opcZipCalculateHeaderSize(name8, name8_len, extra, NULL):0);
+    assert(opcZipCalculateHeaderSize(name8, name8_len, false, zip64, NULL)<=header_size);
+    assert(zip64 || (compressed_size<OPC_ZIP64_LIMIT && uncompressed_size<OPC_ZIP64_LIMIT));
+    bool extra=opcZipCalculateHeaderSize(name8, name8_len, true, zip64, NULL)<=header_size;
+    if (opcZipCalculateHeaderSize(name8, name8_len, extra, zip64, NULL)<=header_size) {
+        uint16_t padding=(extra?header_size-opcZipCalculateHeaderSize(name8, name8_len, extra, zip64, NULL):0);
+        uint16_t const zip64_len=(zip64?4+2*8:0);
         assert(padding==0 || extra); // padding!=0 implies extra... you need the extra header to be able to add padding!
         if ((4==(ret+=opcZipRawWriteU32(io, rawState, 0x04034b50)))
-        && (6==(ret+=opcZipRawWriteU16(io, rawState, 20)))  //version needed to extract
+        && (6==(ret+=opcZipRawWriteU16(io, rawState, (zip64?45:20))))  //version needed to extract
         && (8==(ret+=opcZipRawWriteU16(io, rawState, bit_flag)))  // bit flag
         && (10==(ret+=opcZipRawWriteU16(io, rawState, compression_method)))  // compression method
         && (12==(ret+=opcZipRawWriteU16(io, rawState, 0x0)))  // last mod file time
         && (14==(ret+=opcZipRawWriteU16(io, rawState, 0x0)))  // last mod file date
         && (18==(ret+=opcZipRawWriteU32(io, rawState, crc32)))  // crc32
-        && (22==(ret+=opcZipRawWriteU32(io, rawState, compressed_size)))  // compressed size
-        && (26==(ret+=opcZipRawWriteU32(io, rawState, uncompressed_size)))  // uncompressed size
+        && (22==(ret+=opcZipRawWriteU32(io, rawState, (zip64?OPC_ZIP64_LIMIT:(uint32_t)compressed_size))))  // compressed size
+        && (26==(ret+=opcZipRawWriteU32(io, rawState, (zip64?OPC_ZIP64_LIMIT:(uint32_t)uncompressed_size))))  // uncompressed size
         && (28==(ret+=opcZipRawWriteU16(io, rawState, name8_len)))  // filename length
-        && (30==(ret+=opcZipRawWriteU16(io, rawState, (extra?4*2+padding:0))))  // extra length
+        && (30==(ret+=opcZipRawWriteU16(io, rawState, zip64_len+(extra?4*2+padding:0))))  // extra length
         && (30+name8_len==(ret+=opcZipRawWrite(io, rawState, (uint8_t *)name8, name8_len)))
-        && (!extra || 32+name8_len==(ret+=opcZipRawWriteU16(io, rawState, 0xa220)))  // extra: Microsoft Open Packaging Growth Hint
-        && (!extra || 34+name8_len==(ret+=opcZipRawWriteU16(io, rawState, 2+2+padding)))  // extra: size of Sig + PadVal + Padding
-        && (!extra || 36+name8_len==(ret+=opcZipRawWriteU16(io, rawState, 0xa028)))  // extra: verification signature (A028)
-        && (!extra || 38+name8_len==(ret+=opcZipRawWriteU16(io, rawState, growth_hint)))  // extra: Initial padding value
-        && (!extra || 38+name8_len+padding==(ret+=opcZipRawWriteZero(io, rawState, padding)))) { // extra: filled with NULL characters
-            assert(opcZipCalculateHeaderSize(name8, name8_len, extra, NULL)+padding==ret);
-        }
-        return (opcZipCalculateHeaderSize(name8, name8_len, extra, NULL)+padding==ret?ret:0);
+        && (!zip64 || 32U+name8_len==(ret+=opcZipRawWriteU16(io, rawState, 0x0001)))  // extra: ZIP64 extended information
+        && (!zip64 || 34U+name8_len==(ret+=opcZipRawWriteU16(io, rawState, 2*8)))  // extra: size of the two sizes below
+        && (!zip64 || 42U+name8_len==(ret+=opcZipRawWriteU64(io, rawState, uncompressed_size)))  // extra: uncompressed size
+        && (!zip64 || 50U+name8_len==(ret+=opcZipRawWriteU64(io, rawState, compressed_size)))  // extra: compressed size
+        && (!extra || 32U+name8_len+zip64_len==(ret+=opcZipRawWriteU16(io, rawState, 0xa220)))  // extra: Microsoft Open Packaging Growth Hint
+        && (!extra || 34U+name8_len+zip64_len==(ret+=opcZipRawWriteU16(io, rawState, 2+2+padding)))  // extra: size of Sig + PadVal + Padding
+        && (!extra || 36U+name8_len+zip64_len==(ret+=opcZipRawWriteU16(io, rawState, 0xa028)))  // extra: verification signature (A028)
+        && (!extra || 38U+name8_len+zip64_len==(ret+=opcZipRawWriteU16(io, rawState, growth_hint)))  // extra: Initial padding value
+        && (!extra || 38U+name8_len+zip64_len+padding==(ret+=opcZipRawWriteZero(io, rawState, padding)))) { // extra: filled with NULL characters
+            assert(opcZipCalculateHeaderSize(name8, name8_len, extra, zip64, NULL)+padding==ret);
+        }
+        return (opcZipCalculateHeaderSize(name8, name8_len, extra, zip64, NULL)+padding==ret?ret:0);
     } else {
         return 0; // no enough space to write header!
     }
 }
 
+static uint32_t opcZipRawWriteDataDescriptor(opcIO_t *io, 
+                                             opcFileRawState *rawState, 
+                                             uint32_t crc32,
+                                             opc_ofs_t compressed_size,
+                                             opc_ofs_t uncompressed_size,
+                                             bool zip64) {
+    uint32_t ret=0;
+    // the sizes are 8 bytes iff the local header has a ZIP64 extra field (APPNOTE 4.3.9.2).
+    assert(zip64 || (compressed_size<OPC_ZIP64_LIMIT && uncompressed_size<OPC_ZIP64_LIMIT));
+    if ((4==(ret+=opcZipRawWriteU32(io, rawState, 0x08074b50)))
+    && (8==(ret+=opcZipRawWriteU32(io, rawState, crc32)))
+    && (zip64 || 12==(ret+=opcZipRawWriteU32(io, rawState, (uint32_t)compressed_size)))
+    && (zip64 || 16==(ret+=opcZipRawWriteU32(io, rawState, (uint32_t)uncompressed_size)))
+    && (!zip64 || 16==(ret+=opcZipRawWriteU64(io, rawState, compressed_size)))
+    && (!zip64 || 24==(ret+=opcZipRawWriteU64(io, rawState, uncompressed_size)))) {
+        assert((zip64?24:16)==ret);
+    }
+    return ret;
+}
+
 static opc_error_t opcZipRawWriteCentralDirectoryEx(opcIO_t *io, 
                                                   opcFileRawState *rawState, 
                                                   const char *name8, uint16_t name8_len,
                                                   uint16_t bit_flag,
                                                   uint32_t crc32,
                                                   uint16_t compression_method,
-                                                  size_t compressed_size,
-                                                  size_t uncompressed_size,
+                                                  opc_ofs_t compressed_size,
+                                                  opc_ofs_t uncompressed_size,
                                                   uint16_t header_size,
                                                   uint16_t growth_hint,
-                                                  size_t stream_ofs) {
+                                                  opc_ofs_t stream_ofs) {
     if (OPC_ERROR_NONE==rawState->err) {
+        // only the fields which do not fit into 32 bits go to the ZIP64 extra field.
+        bool const zip64_uncompressed=(uncompressed_size>=OPC_ZIP64_LIMIT);
+        bool const zip64_compressed=(compressed_size>=OPC_ZIP64_LIMIT);
+        bool const zip64_ofs=(stream_ofs>=OPC_ZIP64_LIMIT);
+        uint16_t const zip64_size=(zip64_uncompressed?8:0)+(zip64_compressed?8:0)+(zip64_ofs?8:0);
+        uint16_t const version=(zip64_size>0?45:20);
         if((4==opcZipRawWriteU32(io, rawState, 0x02014b50))
-        && (2==opcZipRawWriteU16(io, rawState, 20))  // version made by 
-        && (2==opcZipRawWriteU16(io, rawState, 20))  // version needed to extract
+        && (2==opcZipRawWriteU16(io, rawState, version))  // version made by 
+        && (2==opcZipRawWriteU16(io, rawState, version))  // version needed to extract
         && (2==opcZipRawWriteU16(io, rawState, bit_flag))  // bit flag
         && (2==opcZipRawWriteU16(io, rawState, compression_method))  // compression method
         && (2==opcZipRawWriteU16(io, rawState, 0x0))  // last mod file time
         && (2==opcZipRawWriteU16(io, rawState, 0x0))  // last mod file date
         && (4==opcZipRawWriteU32(io, rawState, crc32))  // crc32
-        && (4==opcZipRawWriteU32(io, rawState, compressed_size))  // compressed size
-        && (4==opcZipRawWriteU32(io, rawState, uncompressed_size))  // uncompressed size
+        && (4==opcZipRawWriteU32(io, rawState, (zip64_compressed?OPC_ZIP64_LIMIT:(uint32_t)compressed_size)))  // compressed size
+        && (4==opcZipRawWriteU32(io, rawState, (zip64_uncompressed?OPC_ZIP64_LIMIT:(uint32_t)uncompressed_size)))  // uncompressed size
         && (2==opcZipRawWriteU16(io, rawState, name8_len))  // filename length
-        && (2==opcZipRawWriteU16(io, rawState, 0x0))  // extra length
+        && (2==opcZipRawWriteU16(io, rawState, (zip64_size>0?4+zip64_size:0)))  // extra length
         && (2==opcZipRawWriteU16(io, rawState, 0x0))  // comment length
         && (2==opcZipRawWriteU16(io, rawState, 0x0))  // disk number start
         && (2==opcZipRawWriteU16(io, rawState, 0x0))  // internal file attributes
         && (4==opcZipRawWriteU32(io, rawState, 0x0))  // external file attributes
-        && (4==opcZipRawWriteU32(io, rawState, stream_ofs))  // relative offset of local header
-        && (name8_len==opcZipRawWrite(io, rawState, (uint8_t*)name8, name8_len))) {
+        && (4==opcZipRawWriteU32(io, rawState, (zip64_ofs?OPC_ZIP64_LIMIT:(uint32_t)stream_ofs)))  // relative offset of local header
+        && (name8_len==opcZipRawWrite(io, rawState, (uint8_t*)name8, name8_len))
+        && (0==zip64_size || 2==opcZipRawWriteU16(io, rawState, 0x0001))  // extra: ZIP64 extended information
+        && (0==zip64_size || 2==opcZipRawWriteU16(io, rawState, zip64_size))  // extra: size
+        && (!zip64_uncompressed || 8==opcZipRawWriteU64(io, rawState, uncompressed_size))  // extra: uncompressed size
+        && (!zip64_compressed || 8==opcZipRawWriteU64(io, rawState, compressed_size))  // extra: compressed size
+        && (!zip64_ofs || 8==opcZipRawWriteU64(io, rawState, stream_ofs))) { // extra: relative offset of local header
 
         } else {
             rawState->err=OPC_ERROR_STREAM;
@@ -352,18 +561,35 @@ static opc_error_t opcZipRawWriteCentralDirectoryEx(opcIO_t *io,
 
 static opc_error_t opcZipRawWriteEndOfCentralDirectoryEx(opcIO_t *io, 
                                                   opcFileRawState *rawState,
-                                                  size_t central_dir_start_ofs, 
+                                                  opc_ofs_t central_dir_start_ofs, 
                                                   uint32_t segments) {
-    size_t central_dir_end_ofs=rawState->buf_pos;
+    opc_ofs_t central_dir_end_ofs=rawState->buf_pos;
     assert(central_dir_start_ofs<=central_dir_end_ofs);
+    bool const zip64=(segments>=0xFFFF 
+                      || central_dir_end_ofs-central_dir_start_ofs>=OPC_ZIP64_LIMIT 
+                      || central_dir_start_ofs>=OPC_ZIP64_LIMIT);
     if (OPC_ERROR_NONE==rawState->err) {
-        if((4==opcZipRawWriteU32(io, rawState, 0x06054b50))
+        if((!zip64 || 4==opcZipRawWriteU32(io, rawState, 0x06064b50))  // ZIP64 end of central dir record
+        && (!zip64 || 8==opcZipRawWriteU64(io, rawState, 2*2+2*4+4*8))  // size of the remaining record
+        && (!zip64 || 2==opcZipRawWriteU16(io, rawState, 45))  // version made by
+        && (!zip64 || 2==opcZipRawWriteU16(io, rawState, 45))  // version needed to extract
+        && (!zip64 || 4==opcZipRawWriteU32(io, rawState, 0x0))  // number of this disk
+        && (!zip64 || 4==opcZipRawWriteU32(io, rawState, 0x0))  // number of the disk with the start of the central directory
+        && (!zip64 || 8==opcZipRawWriteU64(io, rawState, segments))  // total number of entries in the central directory on this disk
+        && (!zip64 || 8==opcZipRawWriteU64(io, rawState, segments))  // total number of entries in the central directory
+        && (!zip64 || 8==opcZipRawWriteU64(io, rawState, central_dir_end_ofs-central_dir_start_ofs))  // size of the central directory
+        && (!zip64 || 8==opcZipRawWriteU64(io, rawState, central_dir_start_ofs))  // offset of start of central directory
+        && (!zip64 || 4==opcZipRawWriteU32(io, rawState, 0x07064b50))  // ZIP64 end of central dir locator
+        && (!zip64 || 4==opcZipRawWriteU32(io, rawState, 0x0))  // number of the disk with the start of the ZIP64 end of central directory
+        && (!zip64 || 8==opcZipRawWriteU64(io, rawState, central_dir_end_ofs))  // relative offset of the ZIP64 end of central directory record
+        && (!zip64 || 4==opcZipRawWriteU32(io, rawState, 1))  // total number of disks
+        && (4==opcZipRawWriteU32(io, rawState, 0x06054b50))
         && (2==opcZipRawWriteU16(io, rawState, 0x0))  // number of this disk
         && (2==opcZipRawWriteU16(io, rawState, 0x0))  // number of the disk with the start of the central directory
-        && (2==opcZipRawWriteU16(io, rawState, segments))  // total number of entries in the central directory on this disk
-        && (2==opcZipRawWriteU16(io, rawState, segments))  // total number of entries in the central directory 
-        && (4==opcZipRawWriteU32(io, rawState, central_dir_end_ofs-central_dir_start_ofs))  // size of the central directory
-        && (4==opcZipRawWriteU32(io, rawState, central_dir_start_ofs))  // offset of start of central directory with respect to the starting disk number
+        && (2==opcZipRawWriteU16(io, rawState, (zip64?0xFFFF:segments)))  // total number of entries in the central directory on this disk
+        && (2==opcZipRawWriteU16(io, rawState, (zip64?0xFFFF:segments)))  // total number of entries in the central directory 
+        && (4==opcZipRawWriteU32(io, rawState, (zip64?OPC_ZIP64_LIMIT:(uint32_t)(central_dir_end_ofs-central_dir_start_ofs))))  // size of the central directory
+        && (4==opcZipRawWriteU32(io, rawState, (zip64?OPC_ZIP64_LIMIT:(uint32_t)central_dir_start_ofs)))  // offset of start of central directory with respect to the starting disk number
         && (2==opcZipRawWriteU16(io, rawState, 0x0))) {// .ZIP file comment length
 
         } else {
@@ -374,6 +600,16 @@ static opc_error_t opcZipRawWriteEndOfCentralDirectoryEx(opcIO_t *io,
 }
 
 
+static inline int _opcZipRawFileRead(opcIO_t *io, opcFileRawBuffer *raw, uint8_t *buf, uint32_t buf_len) {
+    if (raw->read_at) {
+        // the next unbuffered byte is at state.buf_pos plus the bytes still in the buffer
+        assert(NULL!=io->_ioreadat);
+        return io->_ioreadat(io->iocontext, raw->state.buf_pos+(raw->buf_len-raw->buf_ofs), (char *)buf, buf_len);
+    } else {
+        return _opcZipFileRead(io, buf, buf_len);
+    }
+}
+
 static inline int opcZipRawReadBuffer(opcIO_t *io, opcFileRawBuffer *raw, uint8_t *buffer, uint32_t buf_len) {
     assert(NULL!=raw);
     assert(OPC_ERROR_NONE!=raw->state.err || raw->buf_ofs<=raw->buf_len);
@@ -383,13 +619,13 @@ static inline int opcZipRawReadBuffer(opcIO_t *io, opcFileRawBuffer *raw, uint8_
         if (raw->buf_ofs<raw->buf_len) {
             uint32_t size=raw->buf_len-raw->buf_ofs;
             if (size>req_size) size=req_size;
-            memcpy(buffer+buf_ofs, raw->buf+raw->buf_ofs, size);
+            memcpy(buffer+buf_ofs, raw->data+raw->buf_ofs, size);
             raw->buf_ofs+=size;
             buf_ofs+=size;
             raw->state.buf_pos+=size;
         } else {
             assert(raw->buf_ofs==raw->buf_len);
-            int ret=_opcZipFileRead(io, buffer+buf_ofs, req_size);
+            int ret=_opcZipRawFileRead(io, raw, buffer+buf_ofs, req_size);
             if (0==ret) {
                 buf_len=0; // causes the loop to exit
             } else if (ret<0) {
@@ -405,29 +641,67 @@ static inline int opcZipRawReadBuffer(opcIO_t *io, opcFileRawBuffer *raw, uint8_
 
 
 
-static inline uint32_t opcZipRawPeekHeaderSignature(opcIO_t *io, opcFileRawBuffer *raw) {
-    assert(NULL!=io && NULL!=raw);
-    if (OPC_ERROR_NONE==raw->state.err && raw->buf_ofs+4>raw->buf_len) {
-        // less than four bytes available...
-        if (raw->buf_ofs>0) { // move the bytes to the beginning
+static inline void opcZipRawMapWindow(opcIO_t *io, opcFileRawBuffer *raw, uint32_t max) {
+    // the file is in memory, so let the buffer point directly into it instead of copying.
+    assert(NULL!=io->data && raw->buf_ofs<=raw->buf_len);
+    opc_ofs_t const pos=(raw->read_at?raw->state.buf_pos+(raw->buf_len-raw->buf_ofs):io->state.buf_pos-(raw->buf_len-raw->buf_ofs));
+    opc_ofs_t const avail=(pos<io->file_size?io->file_size-pos:0);
+    uint32_t const len=(avail<max?(uint32_t)avail:max);
+    if (raw->read_at || (pos+len==_opcZipFileSeek(io, pos+len, opcFileSeekSet) && OPC_ERROR_NONE==io->state.err)) {
+        raw->data=io->data+pos;
+        raw->buf_ofs=0;
+        raw->buf_len=len;
+    } else {
+        raw->state.err=OPC_ERROR_STREAM;
+        raw->buf_len=0;
+        raw->buf_ofs=0;
+    }
+}
+
+static inline void opcZipRawPeekFill(opcIO_t *io, opcFileRawBuffer *raw, uint32_t len) {
+    // make sure that at least len bytes are available in the buffer unless the end of the file is reached.
+    assert(NULL!=io && NULL!=raw && len<=sizeof(raw->buf));
+    if (OPC_ERROR_NONE==raw->state.err && raw->buf_ofs+len>raw->buf_len && NULL!=io->data) {
+        opcZipRawMapWindow(io, raw, -1);
+    } else if (OPC_ERROR_NONE==raw->state.err && raw->buf_ofs+len>raw->buf_len) {
+        // less than len bytes available...
+        if (raw->buf_ofs>0 || raw->data!=raw->buf) { // move the bytes to the beginning
             uint32_t delta=raw->buf_len-raw->buf_ofs;
-            assert(delta<=4);
-            for(uint32_t i=0;i<delta;i++) {
-                raw->buf[i]=raw->buf[i+raw->buf_ofs];
-            }
-            raw->buf_len-=raw->buf_ofs;
+            assert(delta<len);
+            memmove(raw->buf, raw->data+raw->buf_ofs, delta);
+            raw->buf_len=delta;
             raw->buf_ofs=0;
         }
+        raw->data=raw->buf;
         // fill the remaining buffer
         assert(0==raw->buf_ofs && raw->buf_len<sizeof(raw->buf));
-        int ret=_opcZipFileRead(io, raw->buf+raw->buf_len, (sizeof(raw->buf)-raw->buf_len));
-        if (ret<0) {
-            raw->state.err=OPC_ERROR_STREAM;
-        } else {
-            raw->buf_len+=ret;
-        }
+        int ret=0;
+        do {
+            ret=_opcZipRawFileRead(io, raw, raw->buf+raw->buf_len, (sizeof(raw->buf)-raw->buf_len));
+            if (ret<0) {
+                raw->state.err=OPC_ERROR_STREAM;
+            } else {
+                raw->buf_len+=ret;
+            }
+        } while(ret>0 && raw->buf_len<len);
         assert(0==raw->buf_ofs && raw->buf_len<=sizeof(raw->buf));
     }
+}
+
+static inline uint32_t opcZipGetU32(const uint8_t *data) {
+    return ((uint32_t)data[0]<<0)
+          +((uint32_t)data[1]<<8)
+          +((uint32_t)data[2]<<16)
+          +((uint32_t)data[3]<<24);
+}
+
+static inline opc_ofs_t opcZipGetSize(const uint8_t *data, uint32_t size_len) {
+    return (8==size_len?(opc_ofs_t)opcZipGetU32(data)+((opc_ofs_t)opcZipGetU32(data+4)<<32):opcZipGetU32(data));
+}
+
+static inline uint32_t opcZipRawPeekHeaderSignature(opcIO_t *io, opcFileRawBuffer *raw) {
+    assert(NULL!=io && NULL!=raw);
+    opcZipRawPeekFill(io, raw, 4);
     if (OPC_ERROR_NONE==raw->state.err && 0==raw->buf_len) {
         return 0; // end of file
     } else if (OPC_ERROR_NONE!=raw->state.err || raw->buf_ofs+4>raw->buf_len) { 
@@ -435,18 +709,18 @@ static inline uint32_t opcZipRawPeekHeaderSignature(opcIO_t *io, opcFileRawBuffe
         return -1;
     } else { 
         assert(OPC_ERROR_NONE==raw->state.err && raw->buf_ofs+4<=raw->buf_len); // enough bytes...
-        return (raw->buf[raw->buf_ofs]<<0)
-              +(raw->buf[raw->buf_ofs+1]<<8)
-              +(raw->buf[raw->buf_ofs+2]<<16)
-              +(raw->buf[raw->buf_ofs+3]<<24);
+        return opcZipGetU32(raw->data+raw->buf_ofs);
     }
 }
 
 static inline opc_error_t opcZipRawFill(opcIO_t *io, opcFileRawBuffer *raw, uint32_t max) {
     assert(OPC_ERROR_NONE!=raw->state.err || raw->buf_ofs<=raw->buf_len);
-    if (OPC_ERROR_NONE==raw->state.err && raw->buf_ofs==raw->buf_len) {
+    if (OPC_ERROR_NONE==raw->state.err && raw->buf_ofs==raw->buf_len && NULL!=io->data) {
+        opcZipRawMapWindow(io, raw, max);
+    } else if (OPC_ERROR_NONE==raw->state.err && raw->buf_ofs==raw->buf_len) {
         uint32_t const len=(sizeof(raw->buf)<max?sizeof(raw->buf):max);
-        int ret=_opcZipFileRead(io, raw->buf, len);
+        raw->data=raw->buf;
+        int ret=_opcZipRawFileRead(io, raw, raw->buf, len);
         if (ret<0) {
             raw->state.err=OPC_ERROR_STREAM;
             raw->buf_len=0;
@@ -463,24 +737,24 @@ static inline uint32_t opcZipRawInflateBuffer(opcIO_t *io, opcFileRawBuffer *raw
     assert(NULL!=raw);
     assert(OPC_ERROR_NONE!=raw->state.err || raw->buf_ofs<=raw->buf_len);
     uint32_t buf_ofs=0;
-    while(OPC_ERROR_NONE==raw->state.err &&  Z_OK==state->inflate_state && buf_ofs<buf_len) {
-        int const max_stream=state->compressed_size-state->stream.total_in;
-        if (OPC_ERROR_NONE==opcZipRawFill(io, raw, max_stream)) {
-            state->stream.next_in=raw->buf+raw->buf_ofs;
-            state->stream.avail_in=raw->buf_len-raw->buf_ofs;
-            state->stream.next_out=buffer+buf_ofs;
-            state->stream.avail_out=buf_len-buf_ofs;
-            if (Z_OK==(state->inflate_state=inflate(&state->stream, Z_SYNC_FLUSH)) || Z_STREAM_END==state->inflate_state) {
-                uint32_t const consumed_in=raw->buf_len-raw->buf_ofs-state->stream.avail_in;
-                uint32_t const consumed_out=buf_len-buf_ofs-state->stream.avail_out;
+    while(OPC_ERROR_NONE==raw->state.err && !state->eof && buf_ofs<buf_len) {
+        opc_ofs_t const max_stream=state->compressed_size-state->total_in;
+        if (OPC_ERROR_NONE==opcZipRawFill(io, raw, (max_stream<UINT32_MAX?(uint32_t)max_stream:UINT32_MAX))) {
+            const uint8_t *next_in=raw->data+raw->buf_ofs;
+            uint32_t avail_in=raw->buf_len-raw->buf_ofs;
+            uint8_t *next_out=buffer+buf_ofs;
+            uint32_t avail_out=buf_len-buf_ofs;
+            if (OPC_ERROR_NONE==(raw->state.err=state->codec->inflate(state->codec_state, &next_in, &avail_in, &next_out, &avail_out, &state->eof))) {
+                uint32_t const consumed_in=raw->buf_len-raw->buf_ofs-avail_in;
+                uint32_t const consumed_out=buf_len-buf_ofs-avail_out;
                 raw->buf_ofs+=consumed_in;
                 raw->state.buf_pos+=consumed_in;
                 buf_ofs+=consumed_out;
-                if (0==consumed_out && 0==consumed_in) {
+                state->total_in+=consumed_in;
+                state->total_out+=consumed_out;
+                if (0==consumed_out && 0==consumed_in && !state->eof) {
                     raw->state.err=OPC_ERROR_DEFLATE; // protect us from an endless loop. shlould not happen
                 }
-            } else {
-                raw->state.err=OPC_ERROR_DEFLATE;
             }
         }
     }
@@ -504,7 +778,7 @@ static inline int opcZipRawReadU8(opcIO_t *io, opcFileRawBuffer *raw, uint8_t *v
         return 0;
     } else {
         if (NULL!=val) {
-            *val=raw->buf[raw->buf_ofs];
+            *val=raw->data[raw->buf_ofs];
         }
         raw->buf_ofs++;
         raw->state.buf_pos++;
@@ -555,13 +829,13 @@ static inline int opcZipRawRead64(opcIO_t *io, opcFileRawBuffer *raw, int64_t *v
     OPC_READ_LITTLE_ENDIAN(io, raw, int64_t, val);
 }
 
-static inline int opcZipRawSkipBytes(opcIO_t *io, opcFileRawBuffer *raw, uint32_t len) {
+static inline opc_ofs_t opcZipRawSkipBytes(opcIO_t *io, opcFileRawBuffer *raw, opc_ofs_t len) {
     if (OPC_ERROR_NONE!=raw->state.err) {
         return 0;
     } else {
         //@TODO speed me up! when seek is available
         int ret=0;
-        uint32_t i=0;
+        opc_ofs_t i=0;
         uint8_t val;
         while(i<len && (1==(ret=opcZipRawReadU8(io, raw, &val)))) i++;
         return (i==len?i:ret);
@@ -602,25 +876,52 @@ static inline int opcZipRawReadString(opcIO_t *io, opcFileRawBuffer *raw, xmlCha
     return str_ofs;
 }
 
+static opc_error_t opcZipRawReadZip64Extra(opcIO_t *io, opcFileRawBuffer *raw, uint16_t extra_size, bool local_header,
+                                           opc_ofs_t *uncompressed_size,
+                                           opc_ofs_t *compressed_size,
+                                           opc_ofs_t *stream_ofs) {
+    // the local header always stores both sizes, the central directory only the fields which are set to 0xFFFFFFFF.
+    opc_ofs_t *field[3]={ uncompressed_size, compressed_size, stream_ofs };
+    for(uint32_t i=0;OPC_ERROR_NONE==raw->state.err && i<sizeof(field)/sizeof(field[0]);i++) {
+        if (NULL!=field[i] && (local_header || OPC_ZIP64_LIMIT==*field[i]) && extra_size>=8) {
+            uint64_t val=0;
+            if (8==opcZipRawReadU64(io, raw, &val)) {
+                if (OPC_ZIP64_LIMIT==*field[i]) *field[i]=val;
+                extra_size-=8;
+            } else {
+                raw->state.err=OPC_ERROR_STREAM;
+            }
+        }
+    }
+    if (extra_size!=opcZipRawSkipBytes(io, raw, extra_size) && OPC_ERROR_NONE==raw->state.err) {
+        raw->state.err=OPC_ERROR_STREAM;
+    }
+    return raw->state.err;
+}
+
 static bool opcZipRawReadLocalFileEx(opcIO_t *io, opcFileRawBuffer *raw, 
                                     xmlChar *name, uint32_t name_size, uint32_t *name_len,
                                     uint32_t *header_size,
                                     uint32_t *min_header_size,
-                                    uint32_t *compressed_size,
-                                    uint32_t *uncompressed_size,
+                                    opc_ofs_t *compressed_size,
+                                    opc_ofs_t *uncompressed_size,
                                     uint16_t *bit_flag,
                                     uint32_t *crc32,
                                     uint16_t *compression_method,
-                                    size_t *stream_ofs,
-                                    uint16_t *growth_hint) {
+                                    opc_ofs_t *stream_ofs,
+                                    uint16_t *growth_hint,
+                                    bool *zip64) {
     bool ret=false;
     uint32_t sig=opcZipRawPeekHeaderSignature(io, raw);
     if (0x04034b50==sig) {
         *stream_ofs=raw->state.buf_pos;
+        *zip64=false;
         uint32_t header_signature;
         uint16_t filename_length;
         uint16_t extra_length;
         uint16_t dummy;
+        uint32_t compressed_size32;
+        uint32_t uncompressed_size32;
         if (4==opcZipRawReadU32(io, raw, &header_signature) && header_signature==sig) // version_needed
         if (2==opcZipRawReadU16(io, raw, &dummy)) // version_needed
         if (2==opcZipRawReadU16(io, raw, bit_flag))
@@ -628,21 +929,28 @@ static bool opcZipRawReadLocalFileEx(opcIO_t *io, opcFileRawBuffer *raw,
         if (2==opcZipRawReadU16(io, raw, NULL)) // last_mod_time
         if (2==opcZipRawReadU16(io, raw, NULL)) // last_mod_date
         if (4==opcZipRawReadU32(io, raw, crc32)) // 
-        if (4==opcZipRawReadU32(io, raw, compressed_size))
-        if (4==opcZipRawReadU32(io, raw, uncompressed_size))
+        if (4==opcZipRawReadU32(io, raw, &compressed_size32))
+        if (4==opcZipRawReadU32(io, raw, &uncompressed_size32))
         if (2==opcZipRawReadU16(io, raw, &filename_length))
         if (2==opcZipRawReadU16(io, raw, &extra_length))
         if ((*name_len=opcZipRawReadString(io, raw, name, filename_length, name_size))<=filename_length) {
+            *compressed_size=compressed_size32;
+            *uncompressed_size=uncompressed_size32;
             *header_size=4*4+7*2+filename_length+extra_length;
-            *min_header_size=4*4+7*2+filename_length;
-            if (extra_length>=8) {
-                *min_header_size+=8;  // reserve space for the Microsoft Open Packaging Growth Hint
-            }
             while(OPC_ERROR_NONE==raw->state.err && extra_length>0) {
                 uint16_t extra_id;
                 uint16_t extra_size;
                 if (2==opcZipRawReadU16(io, raw, &extra_id) && 2==opcZipRawReadU16(io, raw, &extra_size)) {
                     switch(extra_id) {
+                    case 0x0001: // ZIP64 extended information
+                        if (extra_size+4<=extra_length 
+                            && OPC_ERROR_NONE==opcZipRawReadZip64Extra(io, raw, extra_size, true, uncompressed_size, compressed_size, NULL)) {
+                            *zip64=true;
+                            extra_length-=4+extra_size;
+                        } else {
+                            raw->state.err=OPC_ERROR_STREAM;
+                        }
+                        break;
                     case 0xa220: // Microsoft Open Packaging Growth Hint => ignore
                         {
                             uint16_t sig;
@@ -670,20 +978,162 @@ static bool opcZipRawReadLocalFileEx(opcIO_t *io, opcFileRawBuffer *raw,
                 }
                 
             }
+            *min_header_size=opcZipCalculateHeaderSize((const char *)name, filename_length, false, *zip64, NULL);
+            if (*header_size-*min_header_size>=8) {
+                *min_header_size+=8;  // reserve space for the Microsoft Open Packaging Growth Hint
+            }
             ret=(OPC_ERROR_NONE==raw->state.err && 0==extra_length);
         }
     }
     return ret;
 }
 
-static opc_error_t opcZipRawSkipFileData(opcIO_t *io, opcFileRawBuffer *raw, uint32_t compressed_size) {
+static bool opcZipRawReadCentralDirectoryEx(opcIO_t *io, opcFileRawBuffer *raw,
+                                            xmlChar *name, uint32_t name_size, uint32_t *name_len,
+                                            opc_ofs_t *compressed_size,
+                                            opc_ofs_t *uncompressed_size,
+                                            uint16_t *bit_flag,
+                                            uint32_t *crc32,
+                                            uint16_t *compression_method,
+                                            opc_ofs_t *stream_ofs) {
+    bool ret=false;
+    uint32_t header_signature;
+    uint16_t filename_length;
+    uint16_t extra_length;
+    uint16_t comment_length;
+    uint32_t compressed_size32;
+    uint32_t uncompressed_size32;
+    uint32_t local_header_ofs;
+    if (4==opcZipRawReadU32(io, raw, &header_signature) && 0x02014b50==header_signature)
+    if (2==opcZipRawReadU16(io, raw, NULL)) // version made by
+    if (2==opcZipRawReadU16(io, raw, NULL)) // version needed to extract
+    if (2==opcZipRawReadU16(io, raw, bit_flag))
+    if (2==opcZipRawReadU16(io, raw, compression_method))
+    if (2==opcZipRawReadU16(io, raw, NULL)) // last_mod_time
+    if (2==opcZipRawReadU16(io, raw, NULL)) // last_mod_date
+    if (4==opcZipRawReadU32(io, raw, crc32))
+    if (4==opcZipRawReadU32(io, raw, &compressed_size32))
+    if (4==opcZipRawReadU32(io, raw, &uncompressed_size32))
+    if (2==opcZipRawReadU16(io, raw, &filename_length))
+    if (2==opcZipRawReadU16(io, raw, &extra_length))
+    if (2==opcZipRawReadU16(io, raw, &comment_length))
+    if (2==opcZipRawReadU16(io, raw, NULL)) // disk number start
+    if (2==opcZipRawReadU16(io, raw, NULL)) // internal file attributes
+    if (4==opcZipRawReadU32(io, raw, NULL)) // external file attributes
+    if (4==opcZipRawReadU32(io, raw, &local_header_ofs))
+    if ((*name_len=opcZipRawReadString(io, raw, name, filename_length, name_size))<=filename_length) {
+        *compressed_size=compressed_size32;
+        *uncompressed_size=uncompressed_size32;
+        *stream_ofs=local_header_ofs;
+        while(OPC_ERROR_NONE==raw->state.err && extra_length>=4) {
+            uint16_t extra_id;
+            uint16_t extra_size;
+            if (2==opcZipRawReadU16(io, raw, &extra_id) && 2==opcZipRawReadU16(io, raw, &extra_size) && extra_size+4<=extra_length) {
+                if (0x0001==extra_id) { // ZIP64 extended information
+                    opcZipRawReadZip64Extra(io, raw, extra_size, false, uncompressed_size, compressed_size, stream_ofs);
+                } else if (extra_size!=opcZipRawSkipBytes(io, raw, extra_size) && OPC_ERROR_NONE==raw->state.err) {
+                    raw->state.err=OPC_ERROR_STREAM;
+                }
+                extra_length-=4+extra_size;
+            } else if (OPC_ERROR_NONE==raw->state.err) {
+                raw->state.err=OPC_ERROR_STREAM;
+            }
+        }
+        if (extra_length+comment_length==opcZipRawSkipBytes(io, raw, extra_length+comment_length)) {
+            ret=(OPC_ERROR_NONE==raw->state.err);
+        }
+    }
+    return ret;
+}
+
+static bool opcZipRawReadZip64EndOfCentralDirectoryEx(opcIO_t *io,
+                                                      opc_ofs_t end_of_central_dir_ofs,
+                                                      opc_ofs_t *central_dir_start_ofs,
+                                                      opc_ofs_t *central_dir_end_ofs,
+                                                      uint32_t *segments) {
+    bool ret=false;
+    opcFileRawBuffer rawBuffer;
+    uint32_t sig=0;
+    uint32_t disk=0;
+    uint64_t zip64_ofs=0;
+    uint64_t record_size=0;
+    uint64_t disk_entries=0;
+    uint64_t entries=0;
+    uint64_t dir_size=0;
+    uint64_t dir_ofs=0;
+    OPC_ENSURE(OPC_ERROR_NONE==opcZipInitRawBuffer(io, &rawBuffer));
+    if (end_of_central_dir_ofs>=20 && OPC_ERROR_NONE==_opcZipFileSeekRawState(io, &rawBuffer.state, end_of_central_dir_ofs-20))
+    if (4==opcZipRawReadU32(io, &rawBuffer, &sig) && 0x07064b50==sig) // ZIP64 end of central dir locator
+    if (4==opcZipRawReadU32(io, &rawBuffer, &disk) && 0==disk)
+    if (8==opcZipRawReadU64(io, &rawBuffer, &zip64_ofs) && zip64_ofs+2*4+3*8<=end_of_central_dir_ofs-20)
+    if (4==opcZipRawReadU32(io, &rawBuffer, NULL)) // total number of disks
+    if (OPC_ERROR_NONE==opcZipInitRawBuffer(io, &rawBuffer) && OPC_ERROR_NONE==_opcZipFileSeekRawState(io, &rawBuffer.state, zip64_ofs))
+    if (4==opcZipRawReadU32(io, &rawBuffer, &sig) && 0x06064b50==sig) // ZIP64 end of central dir record
+    if (8==opcZipRawReadU64(io, &rawBuffer, &record_size))
+    if (2==opcZipRawReadU16(io, &rawBuffer, NULL)) // version made by
+    if (2==opcZipRawReadU16(io, &rawBuffer, NULL)) // version needed to extract
+    if (4==opcZipRawReadU32(io, &rawBuffer, &disk) && 0==disk) // number of this disk
+    if (4==opcZipRawReadU32(io, &rawBuffer, &disk) && 0==disk) // number of the disk with the start of the central directory
+    if (8==opcZipRawReadU64(io, &rawBuffer, &disk_entries))
+    if (8==opcZipRawReadU64(io, &rawBuffer, &entries) && disk_entries==entries && entries<0xFFFFFFFF)
+    if (8==opcZipRawReadU64(io, &rawBuffer, &dir_size))
+    if (8==opcZipRawReadU64(io, &rawBuffer, &dir_ofs) && dir_ofs<=zip64_ofs && dir_size<=zip64_ofs-dir_ofs) {
+        *central_dir_start_ofs=dir_ofs;
+        *central_dir_end_ofs=dir_ofs+dir_size;
+        *segments=(uint32_t)entries;
+        ret=true;
+    }
+    return ret;
+}
+
+static bool opcZipRawReadEndOfCentralDirectoryEx(opcIO_t *io,
+                                                 opc_ofs_t *central_dir_start_ofs,
+                                                 opc_ofs_t *central_dir_end_ofs,
+                                                 uint32_t *segments) {
+    bool ret=false;
+    if (OPC_ERROR_NONE==io->state.err && NULL!=io->_ioseek && io->file_size>=22) {
+        // the record is 22 bytes plus a comment of at most 64K; try the common "no comment" case first.
+        uint32_t const tail_max=(io->file_size<22+0xFFFF?(uint32_t)io->file_size:22+0xFFFF);
+        uint32_t tail_len=22;
+        uint8_t *tail=(uint8_t *)opcHelperMalloc(io->allocator, tail_max);
+        while(!ret && NULL!=tail && tail_len<=tail_max && OPC_ERROR_NONE==io->state.err) {
+            opc_ofs_t const tail_ofs=io->file_size-tail_len;
+            if (tail_ofs==_opcZipFileSeek(io, tail_ofs, opcFileSeekSet) && tail_len==_opcZipFileRead(io, tail, tail_len)) {
+                for(uint32_t i=tail_len-22+1;!ret && i>0;i--) {
+                    uint8_t const *eocd=tail+i-1;
+                    uint32_t const comment_length=eocd[20]|(eocd[21]<<8);
+                    if (0x50==eocd[0] && 0x4b==eocd[1] && 0x05==eocd[2] && 0x06==eocd[3] && i-1+22+comment_length<=tail_len) {
+                        uint32_t const entries=eocd[10]|(eocd[11]<<8);
+                        uint32_t const dir_size=eocd[12]|(eocd[13]<<8)|(eocd[14]<<16)|((uint32_t)eocd[15]<<24);
+                        uint32_t const dir_ofs=eocd[16]|(eocd[17]<<8)|(eocd[18]<<16)|((uint32_t)eocd[19]<<24);
+                        if (0xFFFF==entries || OPC_ZIP64_LIMIT==dir_size || OPC_ZIP64_LIMIT==dir_ofs) {
+                            // saturated fields => the real values are in the ZIP64 end of central directory record.
+                            ret=opcZipRawReadZip64EndOfCentralDirectoryEx(io, tail_ofs+i-1, central_dir_start_ofs, central_dir_end_ofs, segments);
+                        } else if (0==(eocd[4]|eocd[5]|eocd[6]|eocd[7]) // single disk archives only
+                            && (opc_ofs_t)dir_ofs+dir_size<=tail_ofs+i-1) {
+                            *central_dir_start_ofs=dir_ofs;
+                            *central_dir_end_ofs=(opc_ofs_t)dir_ofs+dir_size;
+                            *segments=entries;
+                            ret=true;
+                        }
+                    }
+                }
+            }
+            tail_len=(tail_len<tail_max?tail_max:tail_max+1);
+        }
+        if (NULL!=tail) opcHelperFree(io->allocator, tail);
+    }
+    return ret;
+}
+
+static opc_error_t opcZipRawSkipFileData(opcIO_t *io, opcFileRawBuffer *raw, opc_ofs_t compressed_size) {
     if (compressed_size!=opcZipRawSkipBytes(io, raw, compressed_size) && OPC_ERROR_NONE==raw->state.err) {
         raw->state.err=OPC_ERROR_STREAM;
     }
     return raw->state.err;
 }
 
-static opc_error_t opcZipRawReadDataDescriptor(opcIO_t *io, opcFileRawBuffer *raw, uint16_t bit_flag, uint32_t *compressed_size, uint32_t *uncompressed_size, uint32_t *crc32, uint32_t *trailing_bytes) {
+static opc_error_t opcZipRawReadDataDescriptor(opcIO_t *io, opcFileRawBuffer *raw, uint16_t bit_flag, bool zip64, opc_ofs_t *compressed_size, opc_ofs_t *uncompressed_size, uint32_t *crc32, uint32_t *trailing_bytes) {
     assert(0==*trailing_bytes);
     if (0x8==(bit_flag & 0x8) && OPC_ERROR_NONE==raw->state.err) {
         // streaming mode
@@ -695,10 +1145,23 @@ static opc_error_t opcZipRawReadDataDescriptor(opcIO_t *io, opcFileRawBuffer *ra
             *trailing_bytes+=4;
         }
         if (OPC_ERROR_NONE==raw->state.err) {
-            if ((4==opcZipRawReadU32(io, raw, crc32))
-            && (4==opcZipRawReadU32(io, raw, compressed_size))
-            && (4==opcZipRawReadU32(io, raw, uncompressed_size))) {
+            uint32_t compressed_size32=0;
+            uint32_t uncompressed_size32=0;
+            if (zip64) { // sizes are 8 bytes if the local header has a ZIP64 extra field
+                if ((4==opcZipRawReadU32(io, raw, crc32))
+                && (8==opcZipRawReadU64(io, raw, compressed_size))
+                && (8==opcZipRawReadU64(io, raw, uncompressed_size))) {
+                    assert(OPC_ERROR_NONE==raw->state.err);
+                    *trailing_bytes+=4+2*8;
+                } else if (OPC_ERROR_NONE==raw->state.err) {
+                    raw->state.err=OPC_ERROR_STREAM;
+                }
+            } else if ((4==opcZipRawReadU32(io, raw, crc32))
+            && (4==opcZipRawReadU32(io, raw, &compressed_size32))
+            && (4==opcZipRawReadU32(io, raw, &uncompressed_size32))) {
                 assert(OPC_ERROR_NONE==raw->state.err);
+                *compressed_size=compressed_size32;
+                *uncompressed_size=uncompressed_size32;
                 *trailing_bytes+=3*4;
             } else if (OPC_ERROR_NONE==raw->state.err) {
                 raw->state.err=OPC_ERROR_STREAM;
@@ -709,25 +1172,21 @@ static opc_error_t opcZipRawReadDataDescriptor(opcIO_t *io, opcFileRawBuffer *ra
 }
 
 static opc_error_t opcZipInitInflateState(opcFileRawState *rawState,
-                                   uint32_t compressed_size,
-                                   uint32_t uncompressed_size,
+                                   const opcZipCodec *codec,
+                                   opc_ofs_t compressed_size,
+                                   opc_ofs_t uncompressed_size,
                                    uint16_t compression_method, 
                                    opcZipInflateState *state) {
     memset(state, 0, sizeof(*state));
-    state->stream.zalloc = Z_NULL;
-    state->stream.zfree = Z_NULL;
-    state->stream.opaque = Z_NULL;
-    state->stream.next_in = Z_NULL;
-    state->stream.avail_in = 0;
+    state->codec=codec;
     state->compressed_size=compressed_size;
     state->compression_method=compression_method;
-    state->inflate_state = Z_STREAM_ERROR;
     if (OPC_ERROR_NONE!=rawState->err) {
         return rawState->err;
     } else if (0==state->compression_method) { // STORE
         return rawState->err;
     } else if (8==state->compression_method) { // DEFLATE
-        if (Z_OK!=(state->inflate_state=inflateInit2(&state->stream, -MAX_WBITS))) {
+        if (NULL==(state->codec_state=codec->inflate_init(codec->codec_ctx, compressed_size, uncompressed_size))) {
             rawState->err=OPC_ERROR_DEFLATE;
         }
         return rawState->err;
@@ -738,43 +1197,57 @@ static opc_error_t opcZipInitInflateState(opcFileRawState *rawState,
 }
 
 static opc_error_t opcZipCleanupInflateState(opcFileRawState *rawState, 
-                                      uint32_t compressed_size,
-                                      uint32_t uncompressed_size,
+                                      opc_ofs_t compressed_size,
+                                      opc_ofs_t uncompressed_size,
+                                      uint32_t data_crc,
                                       opcZipInflateState *state) {
+    if (NULL!=state->codec_state) {
+        opc_error_t const err=state->codec->inflate_end(state->codec_state);
+        state->codec_state=NULL;
+        if (OPC_ERROR_NONE==rawState->err) rawState->err=err;
+    }
     if (OPC_ERROR_NONE==rawState->err) {
         if (0==state->compression_method) { // STORE
-            if (state->stream.total_in!=compressed_size) {
+            if (state->total_in!=compressed_size) {
                 rawState->err=OPC_ERROR_DEFLATE;
             }
         } else if (8==state->compression_method) { // DEFLATE
-            if (Z_OK!=(state->inflate_state=inflateEnd(&state->stream))) {
-                rawState->err=OPC_ERROR_DEFLATE;
-            } else if (state->stream.total_in!=compressed_size || state->stream.total_out!=uncompressed_size) {
+            if (state->total_in!=compressed_size || state->total_out!=uncompressed_size) {
                 rawState->err=OPC_ERROR_DEFLATE;
             }
         } else {
             rawState->err=OPC_ERROR_UNSUPPORTED_COMPRESSION;
         }
     }
+    if (OPC_ERROR_NONE==rawState->err && state->verify_crc && state->crc32!=data_crc) {
+        rawState->err=OPC_ERROR_CRC;
+    }
     return rawState->err;
 }
 
 static uint32_t opcZipRawReadFileData(opcIO_t *io, opcFileRawBuffer *rawBuffer, opcZipInflateState *state, uint8_t *buffer, uint32_t buf_len) {
+    uint32_t ret=0;
     if (8==state->compression_method) {
-        return opcZipRawInflateBuffer(io, rawBuffer, state, buffer, buf_len);
+        ret=opcZipRawInflateBuffer(io, rawBuffer, state, buffer, buf_len);
     } else if (0==state->compression_method) {
-        uint32_t const max_stream=state->compressed_size-state->stream.total_in;
-        uint32_t const max_in=buf_len<max_stream?buf_len:max_stream;
-        int ret=opcZipRawReadBuffer(io, rawBuffer, buffer, max_in);
-        state->stream.total_in+=ret;
-        return ret;
+        opc_ofs_t const max_stream=state->compressed_size-state->total_in;
+        uint32_t const max_in=buf_len<max_stream?buf_len:(uint32_t)max_stream;
+        ret=opcZipRawReadBuffer(io, rawBuffer, buffer, max_in);
+        state->total_in+=ret;
+        state->total_out+=ret;
     } else {
         return OPC_ERROR_UNSUPPORTED_COMPRESSION;
     }
+    if (state->verify_crc) {
+        state->crc32=opcHelperCrc32(state->crc32, buffer, ret);
+    }
+    return ret;
 }
 
 struct OPC_ZIPLOADER_IO_HELPER_STRUCT {
     opcIO_t *io;
+    const opcZipCodec *codec;
+    opcZipCodec zlib_codec; // see opcZipInitCodec
     opcZipInflateState inflateState;
     opcFileRawBuffer rawBuffer;
     opcZipSegmentInfo_t info;
@@ -782,7 +1255,7 @@ struct OPC_ZIPLOADER_IO_HELPER_STRUCT {
 
 static int opcZipLoaderOpen(void *iocontext) {
     struct OPC_ZIPLOADER_IO_HELPER_STRUCT *helper=(struct OPC_ZIPLOADER_IO_HELPER_STRUCT *)iocontext;
-    opc_error_t err=opcZipInitInflateState(&helper->rawBuffer.state, helper->info.compressed_size, helper->info.uncompressed_size, helper->info.compression_method, &helper->inflateState);
+    opc_error_t err=opcZipInitInflateState(&helper->rawBuffer.state, helper->codec, helper->info.compressed_size, helper->info.uncompressed_size, helper->info.compression_method, &helper->inflateState);
     return (OPC_ERROR_NONE==err?0:-1);
 }
 
@@ -794,9 +1267,9 @@ static int opcZipLoaderRead(void *iocontext, char *buffer, int len) {
 
 static int opcZipLoaderClose(void *iocontext) {
     struct OPC_ZIPLOADER_IO_HELPER_STRUCT *helper=(struct OPC_ZIPLOADER_IO_HELPER_STRUCT *)iocontext;
-    opc_error_t err=opcZipRawReadDataDescriptor(helper->io, &helper->rawBuffer, helper->info.bit_flag, &helper->info.compressed_size, &helper->info.uncompressed_size, &helper->info.data_crc, &helper->info.trailing_bytes);
+    opc_error_t err=opcZipRawReadDataDescriptor(helper->io, &helper->rawBuffer, helper->info.bit_flag, helper->info.zip64_segment, &helper->info.compressed_size, &helper->info.uncompressed_size, &helper->info.data_crc, &helper->info.trailing_bytes);
     if (OPC_ERROR_NONE==err) {
-        err=opcZipCleanupInflateState(&helper->rawBuffer.state, helper->info.compressed_size, helper->info.uncompressed_size, &helper->inflateState);
+        err=opcZipCleanupInflateState(&helper->rawBuffer.state, helper->info.compressed_size, helper->info.uncompressed_size, helper->info.data_crc, &helper->inflateState);
     }
     return (OPC_ERROR_NONE==err?0:-1);
 }
@@ -822,51 +1295,57 @@ static int opcZipLoaderSkip(void *iocontext) {
             }
         } else {
             assert(0==helper->info.compression_method);
-            uint8_t buf[3*sizeof(uint32_t)];
-            if (sizeof(buf)==opcZipRawReadBuffer(helper->io, &helper->rawBuffer, buf, sizeof(buf))) {
-                uint32_t stream_len=0;
-                uint32_t crc=0;
-                do {
-                    uint32_t v[3];
-                    uint32_t k=0;
-                    for(uint32_t j=0;j<3;j++) {
-                        v[j]=0;
-                        for(uint32_t i=0;i<sizeof(uint32_t);i++) {
-                            v[j]|=(uint32_t)buf[(stream_len+(j*sizeof(v[0]))+i)%sizeof(buf)]<<(i<<3);
-                        }
-                    }
-                    uint32_t skip_len=0;
-                    if (0x08074b50==v[0]) {
-                        // useless data descriptor signature, recalc v0..v3
-                        for(uint32_t i=0;i<2;i++) v[i]=v[i+1];
-                        v[2]=opcZipRawPeekHeaderSignature(helper->io, &helper->rawBuffer);
-                        skip_len=sizeof(uint32_t);
-                    }
-                    if (crc==v[0] && stream_len==v[1] && stream_len==v[2]) {
-                        if (OPC_ERROR_NONE==err && skip_len>0) {
-                            err=opcZipRawSkipFileData(helper->io, &helper->rawBuffer, skip_len);
-                        }
-                        // found valid data descriptor, assume this is the end of the local content
-                        if (OPC_ERROR_NONE==err) {
-                            helper->info.data_crc=v[0];
-                            helper->info.compressed_size=v[1];
-                            helper->info.uncompressed_size=v[2];
-                            helper->info.trailing_bytes=sizeof(buf)+skip_len;
+            // search for a data descriptor (optional signature, crc, compressed size, uncompressed size) which 
+            // matches the data in front of it. Sizes are checked for every offset in the buffer, the crc only for candidates.
+            // The sizes are 8 bytes if the local header has a ZIP64 extra field (APPNOTE 4.3.9.2).
+            opcFileRawBuffer *raw=&helper->rawBuffer;
+            uint32_t const size_len=(helper->info.zip64_segment?8:4);
+            uint32_t const descriptor_len=sizeof(uint32_t)+2*size_len; // without signature
+            opc_ofs_t stream_len=0;
+            uint32_t crc=0;
+            bool found=false;
+            while(OPC_ERROR_NONE==err && !found) {
+                opcZipRawPeekFill(helper->io, raw, sizeof(uint32_t)+descriptor_len);
+                uint32_t const avail=raw->buf_len-raw->buf_ofs;
+                if (OPC_ERROR_NONE!=raw->state.err || avail<descriptor_len) {
+                    err=OPC_ERROR_STREAM; // not enough bytes for the trailing data descriptor => error
+                } else {
+                    const uint8_t *data=raw->data+raw->buf_ofs;
+                    // at the end of the file a descriptor with signature needs to start 4 bytes earlier
+                    uint32_t const end=(avail>=sizeof(uint32_t)+descriptor_len?avail-sizeof(uint32_t)-descriptor_len+1:avail-descriptor_len+1);
+                    uint32_t crc_ofs=0;
+                    uint32_t i=0;
+                    for(;i<end && !found;i++) {
+                        opc_ofs_t const len=stream_len+i;
+                        uint32_t skip_len=0;
+                        if (0x08074b50==opcZipGetU32(data+i)) {
+                            // useless data descriptor signature
+                            skip_len=(i+sizeof(uint32_t)+descriptor_len<=avail?sizeof(uint32_t):0);
                         }
-                        break;
-                    } else {
-                        // check next byte
-                        crc=crc32(crc, &buf[stream_len%sizeof(buf)], sizeof(buf[0]));
-                        if (sizeof(buf[0])==opcZipRawReadBuffer(helper->io, &helper->rawBuffer, &buf[stream_len%sizeof(buf)], sizeof(buf[0]))) {
-                            stream_len++;
-                        } else {
-                            err=OPC_ERROR_STREAM;
-                            break;
+                        if ((0x08074b50!=opcZipGetU32(data+i) || skip_len>0)
+                         && len==opcZipGetSize(data+i+skip_len+sizeof(uint32_t), size_len) 
+                         && len==opcZipGetSize(data+i+skip_len+sizeof(uint32_t)+size_len, size_len)) {
+                            crc=opcHelperCrc32(crc, data+crc_ofs, i-crc_ofs);
+                            crc_ofs=i;
+                            if (crc==opcZipGetU32(data+i+skip_len)) {
+                                // found valid data descriptor, assume this is the end of the local content
+                                helper->info.data_crc=crc;
+                                helper->info.compressed_size=len;
+                                helper->info.uncompressed_size=len;
+                                helper->info.trailing_bytes=descriptor_len+skip_len;
+                                raw->buf_ofs+=i+helper->info.trailing_bytes;
+                                raw->state.buf_pos+=i+helper->info.trailing_bytes;
+                                found=true;
+                            }
                         }
                     }
-                } while(OPC_ERROR_NONE==helper->rawBuffer.state.err);
-            } else {
-                err=OPC_ERROR_STREAM; // not enough bytes for the trailing data descriptor => error
+                    if (!found) {
+                        crc=opcHelperCrc32(crc, data+crc_ofs, end-crc_ofs);
+                        stream_len+=end;
+                        raw->buf_ofs+=end;
+                        raw->state.buf_pos+=end;
+                    }
+                }
             }
         }
     } else {
@@ -880,10 +1359,11 @@ opc_error_t opcZipLoader(opcIO_t *io, void *userctx, opcZipLoaderSegmentCallback
     struct OPC_ZIPLOADER_IO_HELPER_STRUCT helper;
     opc_bzero_mem(&helper, sizeof(helper));
     helper.io=io;
+    helper.codec=opcZipInitCodec(&helper.zlib_codec, io->allocator);
     OPC_ENSURE(OPC_ERROR_NONE==opcZipInitRawBuffer(io, &helper.rawBuffer));
     while(OPC_ERROR_NONE==helper.rawBuffer.state.err &&
         opcZipRawReadLocalFileEx(io, &helper.rawBuffer, helper.info.name, sizeof(helper.info.name), &helper.info.name_len,
-        &helper.info.header_size, &helper.info.min_header_size, &helper.info.compressed_size, &helper.info.uncompressed_size, &helper.info.bit_flag, &helper.info.data_crc, &helper.info.compression_method, &helper.info.stream_ofs, &helper.info.growth_hint)) {
+        &helper.info.header_size, &helper.info.min_header_size, &helper.info.compressed_size, &helper.info.uncompressed_size, &helper.info.bit_flag, &helper.info.data_crc, &helper.info.compression_method, &helper.info.stream_ofs, &helper.info.growth_hint, &helper.info.zip64_segment)) {
         assert(helper.info.min_header_size<=helper.info.header_size);
         helper.info.trailing_bytes=0;
         assert(NULL!=segmentCallback);
@@ -894,59 +1374,289 @@ opc_error_t opcZipLoader(opcIO_t *io, void *userctx, opcZipLoaderSegmentCallback
             helper.rawBuffer.state.err=ret; // indicate an error
         }
     }
-    //@TODO verify directoy etc..
-#if 0
-                opcZipSegment segment;
-                xmlChar *name=NULL;
-                uint32_t segment_number;
-                bool last_segment;
-                while(opcZipRawReadCentralDirectory(zip, &rawBuffer, &segment, &name, &segment_number, &last_segment, NULL)) {
-                    OPC_ENSURE(OPC_ERROR_NONE==opcZipCleanupSegment(&segment));
-                    xmlFree(name);
-                }
-                uint16_t central_dir_entries=0;
-                OPC_ENSURE(opcZipRawReadEndOfCentralDirectory(zip, &rawBuffer, &central_dir_entries));
-                for(uint32_t i=0;i<container.part_items;i++) {
-                    opcZipSegmentInputStream *stream=opcZipCreateSegmentInputStream(zip, &container.part_array[i].segment);
-                    uint8_t buf[OPC_DEFLATE_BUFFER_SIZE];
-                    uint32_t len=0;
-                    uint32_t crc=0;
-                    while((len=opcZipReadSegmentInputStream(zip, stream, buf, sizeof(buf)))>0) {
-                        crc=crc32(crc, buf, len);
-                    }
-                    assert(crc==container.part_array[i].segment.crc32);
-                    printf("%s [%08X]\n", container.part_array[i].name, crc);
-                    OPC_ENSURE(OPC_ERROR_NONE==opcZipCloseSegmentInputStream(zip, &container.part_array[i].segment, stream));
-                }
-                for(uint32_t i=0;i<container.part_items;i++) {
-                    OPC_ENSURE(OPC_ERROR_NONE==opcZipCleanupSegment(&container.part_array[i].segment));
-                    xmlFree(container.part_array[i].name);
-                }
-#endif
 
     return helper.rawBuffer.state.err;
 }
 
+static opc_error_t opcZipRawReadLocalHeaderSize(opcIO_t *io, opcFileRawBuffer *raw, opc_ofs_t stream_ofs, uint32_t *header_size, uint32_t *min_header_size, uint16_t *growth_hint, bool *zip64) {
+    xmlChar name[OPC_MAX_PATH];
+    uint32_t name_len=0;
+    opc_ofs_t compressed_size=0;
+    opc_ofs_t uncompressed_size=0;
+    uint16_t bit_flag=0;
+    uint32_t crc=0;
+    uint16_t compression_method=0;
+    opc_ofs_t local_ofs=0;
+    OPC_ENSURE(OPC_ERROR_NONE==opcZipInitRawBuffer(io, raw));
+    if (OPC_ERROR_NONE==_opcZipFileSeekRawState(io, &raw->state, stream_ofs)) {
+        if (!opcZipRawReadLocalFileEx(io, raw, name, sizeof(name), &name_len, header_size, min_header_size, &compressed_size, &uncompressed_size, &bit_flag, &crc, &compression_method, &local_ofs, growth_hint, zip64)
+            && OPC_ERROR_NONE==raw->state.err) {
+            raw->state.err=OPC_ERROR_HEADER;
+        }
+    }
+    return raw->state.err;
+}
+
+typedef struct OPC_ZIPDIRECTORYENTRY_STRUCT {
+    xmlChar *name;
+    uint32_t name_len;
+    opc_ofs_t compressed_size;
+    opc_ofs_t uncompressed_size;
+    uint16_t bit_flag;
+    uint32_t data_crc;
+    uint16_t compression_method;
+    opc_ofs_t stream_ofs;
+} opcZipDirectoryEntry;
+
+static int opcZipDirectoryEntryCompare(const void *a, const void *b) {
+    opc_ofs_t const ofs_a=((const opcZipDirectoryEntry*)a)->stream_ofs;
+    opc_ofs_t const ofs_b=((const opcZipDirectoryEntry*)b)->stream_ofs;
+    return (ofs_a<ofs_b?-1:(ofs_a>ofs_b?1:0));
+}
+
+static void opcZipFreeDirectory(opcIO_t *io, opcZipDirectoryEntry *entry_array, uint32_t entry_items) {
+    if (NULL!=entry_array) {
+        for(uint32_t i=0;i<entry_items;i++) {
+            opcHelperFree(io->allocator, entry_array[i].name);
+        }
+        opcHelperFree(io->allocator, entry_array);
+    }
+}
+
+static opcZipDirectoryEntry *opcZipReadDirectory(opcIO_t *io, uint32_t *entry_items, opc_ofs_t *central_dir_start_ofs) {
+    opcZipDirectoryEntry *entry_array=NULL;
+    opc_ofs_t central_dir_end_ofs=0;
+    uint32_t segments=0;
+    *entry_items=0;
+    if (opcZipRawReadEndOfCentralDirectoryEx(io, central_dir_start_ofs, &central_dir_end_ofs, &segments)
+        && segments>0 && NULL!=(entry_array=(opcZipDirectoryEntry *)opcHelperMalloc(io->allocator, segments*sizeof(opcZipDirectoryEntry)))) {
+        opcFileRawBuffer rawBuffer;
+        OPC_ENSURE(OPC_ERROR_NONE==opcZipInitRawBuffer(io, &rawBuffer));
+        bool valid=(OPC_ERROR_NONE==_opcZipFileSeekRawState(io, &rawBuffer.state, *central_dir_start_ofs));
+        while(valid && *entry_items<segments) {
+            xmlChar name[OPC_MAX_PATH];
+            opcZipDirectoryEntry *entry=&entry_array[*entry_items];
+            if ((valid=opcZipRawReadCentralDirectoryEx(io, &rawBuffer, name, sizeof(name), &entry->name_len,
+                                                       &entry->compressed_size, &entry->uncompressed_size, &entry->bit_flag,
+                                                       &entry->data_crc, &entry->compression_method, &entry->stream_ofs))
+                && NULL!=(entry->name=opcHelperStrndup(io->allocator, name, entry->name_len))) {
+                (*entry_items)++;
+            } else {
+                valid=false;
+            }
+        }
+        valid=valid && rawBuffer.state.buf_pos==central_dir_end_ofs;
+        if (valid) {
+            // segments are kept in physical order, so sort them by their local header offset.
+            qsort(entry_array, *entry_items, sizeof(opcZipDirectoryEntry), opcZipDirectoryEntryCompare);
+            for(uint32_t i=0;valid && i<*entry_items;i++) {
+                opc_ofs_t const next_ofs=(i+1<*entry_items?entry_array[i+1].stream_ofs:*central_dir_start_ofs);
+                valid=entry_array[i].stream_ofs+4*4+7*2+entry_array[i].name_len+entry_array[i].compressed_size<=next_ofs;
+            }
+        }
+        if (!valid) {
+            opcZipFreeDirectory(io, entry_array, *entry_items); entry_array=NULL;
+            *entry_items=0;
+        }
+    }
+    return entry_array;
+}
+
+static int opcZipDirectoryLoaderOpen(void *iocontext) {
+    struct OPC_ZIPLOADER_IO_HELPER_STRUCT *helper=(struct OPC_ZIPLOADER_IO_HELPER_STRUCT *)iocontext;
+    if (0==helper->info.header_size) {
+        // the central directory does not know about the local extra fields, so read the local header now.
+        if (OPC_ERROR_NONE==opcZipRawReadLocalHeaderSize(helper->io, &helper->rawBuffer, helper->info.stream_ofs, &helper->info.header_size, &helper->info.min_header_size, &helper->info.growth_hint, &helper->info.zip64_segment)) {
+            assert(helper->info.trailing_bytes>=helper->info.header_size);
+            helper->info.trailing_bytes-=helper->info.header_size;
+        }
+    } else {
+        OPC_ENSURE(OPC_ERROR_NONE==opcZipInitRawBuffer(helper->io, &helper->rawBuffer));
+        _opcZipFileSeekRawState(helper->io, &helper->rawBuffer.state, helper->info.stream_ofs+helper->info.header_size);
+    }
+    return opcZipLoaderOpen(iocontext);
+}
+
+static int opcZipDirectoryLoaderClose(void *iocontext) {
+    struct OPC_ZIPLOADER_IO_HELPER_STRUCT *helper=(struct OPC_ZIPLOADER_IO_HELPER_STRUCT *)iocontext;
+    // sizes and crc are already known from the central directory, so there is no data descriptor to read.
+    opc_error_t err=opcZipCleanupInflateState(&helper->rawBuffer.state, helper->info.compressed_size, helper->info.uncompressed_size, helper->info.data_crc, &helper->inflateState);
+    return (OPC_ERROR_NONE==err?0:-1);
+}
+
+static int opcZipDirectoryLoaderSkip(void *iocontext) {
+    (void)iocontext;
+    return 0; // nothing to do, the next segment is found via the central directory.
+}
+
+opc_error_t opcZipDirectoryLoader(opcIO_t *io, void *userctx, opcZipLoaderSegmentCallback_t *segmentCallback) {
+    uint32_t entry_items=0;
+    opc_ofs_t central_dir_start_ofs=0;
+    opcZipDirectoryEntry *entry_array=opcZipReadDirectory(io, &entry_items, &central_dir_start_ofs);
+    if (NULL==entry_array) {
+        // no usable central directory (e.g. truncated or streamed archive) => scan the local headers.
+        if (NULL!=io->_ioseek) {
+            io->state.err=OPC_ERROR_NONE;
+            _opcZipFileSeek(io, 0, opcFileSeekSet);
+        }
+        return opcZipLoader(io, userctx, segmentCallback);
+    } else {
+        struct OPC_ZIPLOADER_IO_HELPER_STRUCT helper;
+        opc_bzero_mem(&helper, sizeof(helper));
+        helper.io=io;
+        helper.codec=opcZipInitCodec(&helper.zlib_codec, io->allocator);
+        OPC_ENSURE(OPC_ERROR_NONE==opcZipInitRawBuffer(io, &helper.rawBuffer));
+        for(uint32_t i=0;OPC_ERROR_NONE==helper.rawBuffer.state.err && i<entry_items;i++) {
+            opcZipDirectoryEntry *entry=&entry_array[i];
+            opc_ofs_t const next_ofs=(i+1<entry_items?entry_array[i+1].stream_ofs:central_dir_start_ofs);
+            memcpy(helper.info.name, entry->name, entry->name_len+1);
+            helper.info.name_len=entry->name_len;
+            helper.info.header_size=0; // not known until the local header is read, see opcZipDirectoryLoaderOpen
+            helper.info.min_header_size=0;
+            helper.info.growth_hint=0;
+            helper.info.zip64_segment=false;
+            helper.info.compressed_size=entry->compressed_size;
+            helper.info.uncompressed_size=entry->uncompressed_size;
+            helper.info.bit_flag=entry->bit_flag;
+            helper.info.data_crc=entry->data_crc;
+            helper.info.compression_method=entry->compression_method;
+            helper.info.stream_ofs=entry->stream_ofs;
+            helper.info.trailing_bytes=next_ofs-entry->stream_ofs-entry->compressed_size; // includes the local header while header_size is 0
+            OPC_ENSURE(OPC_ERROR_NONE==opcHelperSplitFilename(helper.info.name, helper.info.name_len, &helper.info.segment_number, &helper.info.last_segment, &helper.info.rels_segment));
+            opc_error_t ret=segmentCallback(&helper, userctx, &helper.info, opcZipDirectoryLoaderOpen, opcZipLoaderRead, opcZipDirectoryLoaderClose, opcZipDirectoryLoaderSkip);
+            assert(OPC_ERROR_NONE==ret);
+            if (OPC_ERROR_NONE==helper.rawBuffer.state.err && OPC_ERROR_NONE!=ret) {
+                helper.rawBuffer.state.err=ret; // indicate an error
+            }
+        }
+        opcZipFreeDirectory(io, entry_array, entry_items);
+        return helper.rawBuffer.state.err;
+    }
+}
+
+static bool opcZipSegmentReserveZip64(opcZipSegment *segment) {
+    // the ZIP64 extra field of the local header can be taken from the padding without moving the data.
+    if (!segment->zip64_segment && segment->padding>=4+2*8) {
+        segment->zip64_segment=1;
+        segment->header_size+=4+2*8;
+        segment->padding-=4+2*8;
+    }
+    return segment->zip64_segment;
+}
+
+static opc_error_t opcZipSegmentLoadHeader(opcZip *zip, uint32_t segment_id) {
+    assert(segment_id<zip->segment_items);
+    opcZipSegment *segment=&zip->segment_array[segment_id];
+    opc_error_t err=OPC_ERROR_NONE;
+    if (0==segment->header_size && !segment->deleted_segment) {
+        opcFileRawBuffer rawBuffer;
+        uint32_t header_size=0;
+        uint32_t min_header_size=0;
+        uint16_t growth_hint=0;
+        bool zip64=false;
+        if (OPC_ERROR_NONE==(err=opcZipRawReadLocalHeaderSize(zip->io, &rawBuffer, segment->stream_ofs, &header_size, &min_header_size, &growth_hint, &zip64))) {
+            assert(min_header_size<=header_size && header_size<=segment->segment_size);
+            segment->header_size=min_header_size;
+            segment->padding=header_size-min_header_size;
+            segment->growth_hint=growth_hint;
+            segment->zip64_segment=(zip64?1:0);
+            if (segment->compressed_size>=OPC_ZIP64_LIMIT || segment->uncompressed_size>=OPC_ZIP64_LIMIT) {
+                opcZipSegmentReserveZip64(segment); // e.g. streamed archives with a ZIP64 data descriptor only
+            }
+        }
+    }
+    return err;
+}
+
+opc_error_t opcZipLoadAllHeaders(opcZip *zip) {
+    opc_error_t err=OPC_ERROR_NONE;
+    for(uint32_t i=0;OPC_ERROR_NONE==err && i<zip->segment_items;i++) {
+        err=opcZipSegmentLoadHeader(zip, i);
+    }
+    return err;
+}
+
+static int segment_ofs_sort_fct(const void *a, const void *b) {
+    opc_ofs_t const ofs_a=(*(const opcZipSegment* const*)a)->stream_ofs;
+    opc_ofs_t const ofs_b=(*(const opcZipSegment* const*)b)->stream_ofs;
+    return (ofs_a<ofs_b?-1:(ofs_a>ofs_b?1:0));
+}
+
+opc_error_t opcZipPrefetchSegments(opcZip *zip, const uint32_t *segment_id_array, uint32_t segment_items) {
+    opc_error_t err=OPC_ERROR_NONE;
+    const opcZipSegment **sorted=(segment_items>0?(const opcZipSegment **)opcHelperMalloc(zip->io->allocator, segment_items*sizeof(opcZipSegment*)):NULL);
+    if (NULL!=sorted) {
+        uint32_t sorted_items=0;
+        for(uint32_t i=0;i<segment_items;i++) {
+            if (segment_id_array[i]<zip->segment_items && !zip->segment_array[segment_id_array[i]].deleted_segment) {
+                sorted[sorted_items++]=&zip->segment_array[segment_id_array[i]];
+            }
+        }
+        qsort(sorted, sorted_items, sizeof(opcZipSegment*), segment_ofs_sort_fct);
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<sorted_items;) {
+            // adjacent segments are read ahead as one range, in the order they are stored in the file.
+            opc_ofs_t const ofs=sorted[i]->stream_ofs;
+            opc_ofs_t end=ofs+sorted[i]->segment_size;
+            for(i++;i<sorted_items && sorted[i]->stream_ofs<=end;i++) {
+                if (sorted[i]->stream_ofs+sorted[i]->segment_size>end) end=sorted[i]->stream_ofs+sorted[i]->segment_size;
+            }
+            err=opcFileAdviseIO(zip->io, ofs, end-ofs, opcFileAdviceWillNeed);
+        }
+        opcHelperFree(zip->io->allocator, sorted);
+    } else if (segment_items>0) {
+        err=OPC_ERROR_MEMORY;
+    }
+    return err;
+}
+
 opcZipInputStream *opcZipOpenInputStream(opcZip *zip, uint32_t segment_id) {
     assert(segment_id>=0 && segment_id<zip->segment_items);
-    opcZipInputStream *stream=(opcZipInputStream *)xmlMalloc(sizeof(opcZipInputStream));
+    opcZipInputStream *stream=(!zip->streaming && OPC_ERROR_NONE==opcZipSegmentLoadHeader(zip, segment_id)?(opcZipInputStream *)opcHelperMalloc(zip->io->allocator, sizeof(opcZipInputStream)):NULL);
     if (NULL!=stream) {        
         opc_bzero_mem(stream, sizeof(*stream));
         stream->segment_id=segment_id;
         opcZipSegment *segment=&zip->segment_array[segment_id];
         stream->rawBuffer.state.buf_pos=segment->stream_ofs+segment->padding+segment->header_size;
+        stream->rawBuffer.read_at=(NULL!=zip->io->_ioreadat); // no need to share the file position
+        opcFileAdviseIO(zip->io, segment->stream_ofs, segment->segment_size, opcFileAdviceSequential);
         if (OPC_ERROR_NONE!=opcZipInitInflateState(&stream->rawBuffer.state, 
+                                                   zip->codec,
                                                    segment->compressed_size, 
                                                    segment->uncompressed_size, 
                                                    segment->compression_method, 
                                                    &stream->inflateState)) {
             // error
-            xmlFree(stream); stream=NULL;
+            opcHelperFree(zip->io->allocator, stream); stream=NULL;
+        } else {
+            stream->inflateState.verify_crc=zip->verify_crc;
         }
     }
     return stream;
 }
 
+opc_error_t opcZipMapSegment(opcZip *zip, uint32_t segment_id, const uint8_t **data, opc_ofs_t *data_len) {
+    assert(NULL!=zip && NULL!=data && NULL!=data_len);
+    assert(segment_id<zip->segment_items);
+    opc_error_t err=OPC_ERROR_STREAM;
+    *data=NULL; *data_len=0;
+    if (NULL!=zip->io->data && !zip->streaming && OPC_ERROR_NONE==(err=opcZipSegmentLoadHeader(zip, segment_id))) {
+        opcZipSegment *segment=&zip->segment_array[segment_id];
+        opc_ofs_t ofs=segment->stream_ofs+segment->padding+segment->header_size;
+        if (segment->deleted_segment) {
+            err=OPC_ERROR_STREAM;
+        } else if (0!=segment->compression_method) {
+            err=OPC_ERROR_UNSUPPORTED_COMPRESSION;
+        } else if (ofs>zip->io->file_size || segment->compressed_size>zip->io->file_size-ofs) {
+            err=OPC_ERROR_STREAM; // truncated archive
+        } else {
+            *data=zip->io->data+ofs;
+            *data_len=segment->compressed_size;
+            opcFileAdviseIO(zip->io, ofs, segment->compressed_size, opcFileAdviceSequential);
+        }
+    }
+    return err;
+}
+
 opc_error_t opcZipCloseInputStream(opcZip *zip, opcZipInputStream *stream) {
     assert(NULL!=zip && NULL!=stream);
     assert(stream->segment_id>=0 && stream->segment_id<zip->segment_items);
@@ -954,34 +1664,219 @@ opc_error_t opcZipCloseInputStream(opcZip *zip, opcZipInputStream *stream) {
     opc_error_t err=opcZipCleanupInflateState(&stream->rawBuffer.state, 
                                               segment->compressed_size, 
                                               segment->uncompressed_size, 
+                                              segment->crc32,
                                               &stream->inflateState);
-    xmlFree(stream); stream=NULL;
+    opcHelperFree(zip->io->allocator, stream); stream=NULL;
     return err;
 }
 
 uint32_t opcZipReadInputStream(opcZip *zip, opcZipInputStream *stream, uint8_t *buf, uint32_t buf_len) {
     assert(NULL!=zip && NULL!=stream);
-    OPC_ENSURE(stream->rawBuffer.state.buf_pos+stream->rawBuffer.buf_len-stream->rawBuffer.buf_ofs==_opcZipFileSeek(zip->io, stream->rawBuffer.state.buf_pos+stream->rawBuffer.buf_len-stream->rawBuffer.buf_ofs, opcFileSeekSet));
-    assert(zip->io->state.buf_pos==stream->rawBuffer.state.buf_pos+stream->rawBuffer.buf_len-stream->rawBuffer.buf_ofs);
+    if (!stream->rawBuffer.read_at) {
+        OPC_ENSURE(stream->rawBuffer.state.buf_pos+stream->rawBuffer.buf_len-stream->rawBuffer.buf_ofs==_opcZipFileSeek(zip->io, stream->rawBuffer.state.buf_pos+stream->rawBuffer.buf_len-stream->rawBuffer.buf_ofs, opcFileSeekSet));
+        assert(zip->io->state.buf_pos==stream->rawBuffer.state.buf_pos+stream->rawBuffer.buf_len-stream->rawBuffer.buf_ofs);
+    }
 
 //    OPC_ENSURE(stream->rawBuffer.state.buf_pos==_opcZipFileSeek(zip->io, stream->rawBuffer.state.buf_pos, opcFileSeekSet));
     uint32_t ret=opcZipRawReadFileData(zip->io, &stream->rawBuffer, &stream->inflateState, buf, buf_len);
     return ret;
 }
 
+#define OPC_ZIP_WINDOW_SIZE (1<<MAX_WBITS)
+
+static opc_error_t opcZipSeekPointRestore(opcZip *zip, opcZipSegment *segment, const opcZipSeekPoint *point, opcFileRawBuffer *raw, z_stream *strm) {
+    // position raw at the checkpoint. If the checkpoint is in the middle of a byte the remaining bits are primed.
+    opc_ofs_t const data_ofs=segment->stream_ofs+segment->padding+segment->header_size;
+    opc_ofs_t const ofs=data_ofs+point->compressed_ofs-(point->bits>0?1:0);
+    raw->buf_ofs=0;
+    raw->buf_len=0;
+    raw->data=raw->buf;
+    if (raw->read_at) {
+        raw->state.buf_pos=ofs;
+    } else {
+        _opcZipFileSeekRawState(zip->io, &raw->state, ofs);
+    }
+    if (OPC_ERROR_NONE==raw->state.err && point->bits>0) {
+        uint8_t val=0;
+        if (1!=opcZipRawReadU8(zip->io, raw, &val)) {
+            raw->state.err=OPC_ERROR_STREAM;
+        } else if (Z_OK!=inflatePrime(strm, point->bits, val>>(8-point->bits))) {
+            raw->state.err=OPC_ERROR_DEFLATE;
+        }
+    }
+    if (OPC_ERROR_NONE==raw->state.err && point->window_len>0) {
+        if (Z_OK!=inflateSetDictionary(strm, point->window, point->window_len)) {
+            raw->state.err=OPC_ERROR_DEFLATE;
+        }
+    }
+    return raw->state.err;
+}
+
+static opc_error_t opcZipSeekIndexAddPoint(const opcAllocator *allocator, opcZipSeekIndex *index, opc_ofs_t compressed_ofs, opc_ofs_t uncompressed_ofs, uint32_t bits, const uint8_t *window, uint32_t window_pos, uint32_t window_len) {
+    opcZipSeekPoint *point_array=(opcZipSeekPoint *)opcHelperRealloc(allocator, index->point_array, (index->point_items+1)*sizeof(opcZipSeekPoint));
+    if (NULL==point_array) return OPC_ERROR_MEMORY;
+    index->point_array=point_array;
+    opcZipSeekPoint *point=&index->point_array[index->point_items];
+    opc_bzero_mem(point, sizeof(*point));
+    point->compressed_ofs=compressed_ofs;
+    point->uncompressed_ofs=uncompressed_ofs;
+    point->bits=bits;
+    if (window_len>0) {
+        // window is circular: the last window_len bytes end at window_pos.
+        if (NULL==(point->window=(uint8_t *)opcHelperMalloc(allocator, window_len))) return OPC_ERROR_MEMORY;
+        uint32_t const tail=(window_len<=window_pos?window_len:window_pos);
+        memcpy(point->window, window+OPC_ZIP_WINDOW_SIZE-(window_len-tail), window_len-tail);
+        memcpy(point->window+(window_len-tail), window+window_pos-tail, tail);
+        point->window_len=window_len;
+    }
+    index->point_items++;
+    return OPC_ERROR_NONE;
+}
+
+static opc_error_t opcZipSeekIndexExtend(opcZip *zip, uint32_t segment_id, opc_ofs_t target) {
+    opcZipSegment *segment=&zip->segment_array[segment_id];
+    assert(8==segment->compression_method);
+    opc_error_t err=OPC_ERROR_NONE;
+    if (NULL==segment->seek_index) {
+        if (NULL==(segment->seek_index=(opcZipSeekIndex *)opcHelperMalloc(zip->io->allocator, sizeof(opcZipSeekIndex)))) return OPC_ERROR_MEMORY;
+        opc_bzero_mem(segment->seek_index, sizeof(*segment->seek_index));
+        // the start of the stream is always the first checkpoint.
+        if (OPC_ERROR_NONE!=(err=opcZipSeekIndexAddPoint(zip->io->allocator, segment->seek_index, 0, 0, 0, NULL, 0, 0))) return err;
+    }
+    opcZipSeekIndex *index=segment->seek_index;
+    const opcZipSeekPoint *last=&index->point_array[index->point_items-1];
+    if (index->complete || last->uncompressed_ofs+OPC_SEEK_INDEX_SPAN>target) return OPC_ERROR_NONE;
+    uint8_t *window=(uint8_t *)opcHelperMalloc(zip->io->allocator, OPC_ZIP_WINDOW_SIZE);
+    opcFileRawBuffer *raw=(opcFileRawBuffer *)opcHelperMalloc(zip->io->allocator, sizeof(opcFileRawBuffer));
+    z_stream strm;
+    opcZipZlibInitStream(&strm, zip->io->allocator);
+    if (NULL==window || NULL==raw || Z_OK!=inflateInit2(&strm, -MAX_WBITS)) {
+        if (NULL!=window) opcHelperFree(zip->io->allocator, window);
+        if (NULL!=raw) opcHelperFree(zip->io->allocator, raw);
+        return OPC_ERROR_MEMORY;
+    }
+    opcZipInitRawBuffer(zip->io, raw);
+    raw->read_at=(NULL!=zip->io->_ioreadat);
+    opc_ofs_t total_in=last->compressed_ofs;
+    opc_ofs_t total_out=last->uncompressed_ofs;
+    opc_ofs_t last_out=total_out;
+    uint32_t window_pos=last->window_len%OPC_ZIP_WINDOW_SIZE;
+    uint32_t window_len=last->window_len;
+    if (last->window_len>0) memcpy(window, last->window, last->window_len);
+    err=opcZipSeekPointRestore(zip, segment, last, raw, &strm);
+    // inflate block by block and remember the state at block boundaries every OPC_SEEK_INDEX_SPAN bytes.
+    while(OPC_ERROR_NONE==err && total_out<=target) {
+        if (raw->buf_ofs==raw->buf_len) {
+            opc_ofs_t const max_stream=segment->compressed_size-total_in;
+            if (OPC_ERROR_NONE!=(err=opcZipRawFill(zip->io, raw, (max_stream<UINT32_MAX?(uint32_t)max_stream:UINT32_MAX)))) break;
+        }
+        if (OPC_ZIP_WINDOW_SIZE==window_pos) window_pos=0;
+        strm.next_in=(Bytef*)raw->data+raw->buf_ofs;
+        strm.avail_in=raw->buf_len-raw->buf_ofs;
+        strm.next_out=window+window_pos;
+        strm.avail_out=OPC_ZIP_WINDOW_SIZE-window_pos;
+        int const ret=inflate(&strm, Z_BLOCK);
+        uint32_t const consumed_in=raw->buf_len-raw->buf_ofs-strm.avail_in;
+        uint32_t const consumed_out=OPC_ZIP_WINDOW_SIZE-window_pos-strm.avail_out;
+        raw->buf_ofs+=consumed_in;
+        raw->state.buf_pos+=consumed_in;
+        total_in+=consumed_in;
+        total_out+=consumed_out;
+        window_pos+=consumed_out;
+        window_len=(window_len+consumed_out<OPC_ZIP_WINDOW_SIZE?window_len+consumed_out:OPC_ZIP_WINDOW_SIZE);
+        if (Z_STREAM_END==ret) {
+            index->complete=true;
+        } else if (Z_OK!=ret || (0==consumed_in && 0==consumed_out)) {
+            err=OPC_ERROR_DEFLATE; // corrupt or truncated stream
+        } else if ((strm.data_type&128) && !(strm.data_type&64) && total_out-last_out>=OPC_SEEK_INDEX_SPAN) {
+            err=opcZipSeekIndexAddPoint(zip->io->allocator, index, total_in, total_out, strm.data_type&7, window, window_pos, window_len);
+            last_out=total_out;
+        }
+        if (index->complete) break;
+    }
+    inflateEnd(&strm);
+    opcHelperFree(zip->io->allocator, raw);
+    opcHelperFree(zip->io->allocator, window);
+    return err;
+}
+
+opc_error_t opcZipBuildSeekIndex(opcZip *zip, uint32_t segment_id) {
+    assert(NULL!=zip);
+    assert(segment_id<zip->segment_items);
+    opc_error_t err=opcZipSegmentLoadHeader(zip, segment_id);
+    if (OPC_ERROR_NONE==err && 8==zip->segment_array[segment_id].compression_method) {
+        err=opcZipSeekIndexExtend(zip, segment_id, UINT64_MAX);
+    }
+    return err;
+}
+
+opc_error_t opcZipSeekInputStream(opcZip *zip, opcZipInputStream *stream, opc_ofs_t ofs) {
+    assert(NULL!=zip && NULL!=stream);
+    opcZipSegment *segment=&zip->segment_array[stream->segment_id];
+    opcZipInflateState *state=&stream->inflateState;
+    opcFileRawBuffer *raw=&stream->rawBuffer;
+    if (OPC_ERROR_NONE!=raw->state.err) return raw->state.err;
+    if (ofs>segment->uncompressed_size) return OPC_ERROR_SEEK;
+    state->verify_crc=false; // the crc only covers data read sequentially from the start
+    if (0==state->compression_method) { // STORE
+        raw->buf_ofs=0;
+        raw->buf_len=0;
+        raw->data=raw->buf;
+        raw->state.buf_pos=segment->stream_ofs+segment->padding+segment->header_size+ofs;
+        state->total_in=ofs;
+        state->total_out=ofs;
+        return OPC_ERROR_NONE;
+    }
+    if (ofs<state->total_out || ofs-state->total_out>OPC_SEEK_INDEX_SPAN) {
+        opc_error_t err=opcZipSeekIndexExtend(zip, stream->segment_id, ofs);
+        if (OPC_ERROR_NONE!=err) return err;
+        const opcZipSeekIndex *index=segment->seek_index;
+        uint32_t lo=0, hi=index->point_items; // find the last checkpoint before ofs
+        while(hi-lo>1) {
+            uint32_t const mid=lo+(hi-lo)/2;
+            if (index->point_array[mid].uncompressed_ofs<=ofs) lo=mid; else hi=mid;
+        }
+        const opcZipSeekPoint *point=&index->point_array[lo];
+        if (ofs<state->total_out || point->uncompressed_ofs>state->total_out) {
+            // restart inflating at the checkpoint. Checkpoints are zlib specific, so the stream continues with zlib.
+            z_stream *strm=(z_stream *)opcZipZlibInflateInit(zip->zlib_codec.codec_ctx, segment->compressed_size, segment->uncompressed_size);
+            if (NULL==strm) return OPC_ERROR_MEMORY;
+            if (NULL!=state->codec_state) {
+                state->codec->inflate_end(state->codec_state);
+            }
+            state->codec=&zip->zlib_codec;
+            state->codec_state=strm;
+            state->eof=false;
+            state->total_in=point->compressed_ofs;
+            state->total_out=point->uncompressed_ofs;
+            if (OPC_ERROR_NONE!=opcZipSeekPointRestore(zip, segment, point, raw, strm)) return raw->state.err;
+        }
+    }
+    // skip the remaining bytes
+    uint8_t buf[OPC_DEFLATE_BUFFER_SIZE];
+    while(OPC_ERROR_NONE==raw->state.err && state->total_out<ofs) {
+        opc_ofs_t const delta=ofs-state->total_out;
+        if (0==opcZipReadInputStream(zip, stream, buf, (delta<sizeof(buf)?(uint32_t)delta:sizeof(buf)))) {
+            if (OPC_ERROR_NONE==raw->state.err) raw->state.err=OPC_ERROR_DEFLATE; // premature end of stream
+        }
+    }
+    return raw->state.err;
+}
+
 static uint32_t opcZipAppendSegmentEx(opcZip *zip, 
-                                   size_t stream_ofs,
-                                   size_t segment_size,
+                                   opc_ofs_t stream_ofs,
+                                   opc_ofs_t segment_size,
                                    uint16_t padding,
                                    uint32_t header_size,
                                    uint16_t bit_flag,
                                    uint32_t crc32,
                                    uint16_t compression_method,
-                                   size_t compressed_size,
-                                   size_t uncompressed_size,
+                                   opc_ofs_t compressed_size,
+                                   opc_ofs_t uncompressed_size,
                                    uint32_t growth_hint,
                                    const xmlChar *partName,
-                                   bool relsSegment) {
+                                   bool relsSegment,
+                                   bool zip64) {
     uint32_t segment_id=-1;
     opcZipSegment *segment=ensureSegment(zip);
     if (NULL!=segment) {
@@ -999,6 +1894,7 @@ static uint32_t opcZipAppendSegmentEx(opcZip *zip,
         segment->growth_hint=growth_hint;
         segment->partName=partName;
         segment->rels_segment=(relsSegment?1:0);
+        segment->zip64_segment=(zip64?1:0);
         segment->next_segment_id=-1;
     }
     return segment_id;
@@ -1017,36 +1913,51 @@ uint32_t opcZipLoadSegment(opcZip *zip, const xmlChar *partName, bool rels_segme
                                            info->uncompressed_size,
                                            info->growth_hint,
                                            partName, 
-                                           rels_segment);
+                                           rels_segment,
+                                           info->zip64_segment);
     return ret;
 }
 
 uint32_t opcZipCreateSegment(opcZip *zip, 
                                  const xmlChar *partName, 
                                  bool relsSegment, 
-                                 uint32_t segment_size, 
+                                 opc_ofs_t segment_size, 
                                  uint32_t growth_hint,
                                  uint16_t compression_method,
                                  uint16_t bit_flag) {
     assert(0==compression_method || 8==compression_method); // either STORE or DEFLATE
     assert(8!=compression_method || (0<<1==bit_flag || 1<<1==bit_flag || 2<<1==bit_flag || 3<<1==bit_flag)); // WHEN DELFATE set bit_flag to NORMAL, MAXIMUM, FAST or SUPERFAST compression
     uint32_t segment_id=-1;
-    //@TODO find free segment
-    if (-1==segment_id) {
-        size_t stream_ofs=(zip->segment_items>0?zip->segment_array[zip->segment_items-1].stream_ofs+zip->segment_array[zip->segment_items-1].segment_size:0);
+    if (zip->streaming) {
+        // the local header is written right away, crc and sizes follow the data in a descriptor (bit 3).
+        // The size is not known yet, so the header always has a ZIP64 extra field and the descriptor 8 byte sizes.
+        if ((uint32_t)-1==zip->streaming_segment_id) {
+            opc_ofs_t const stream_ofs=zip->io->state.buf_pos;
+            char name8[OPC_MAX_PATH];
+            uint16_t name8_len=opcHelperAssembleSegmentName(name8, sizeof(name8), partName, 0, -1, relsSegment, NULL);
+            uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, false, true, NULL);
+            bit_flag|=1<<3;
+            if (header_size==opcZipRawWriteSegmentHeaderEx(zip->io, &zip->io->state, name8, name8_len, bit_flag, 0, compression_method, 0, 0, header_size, 0, true)) {
+                segment_id=opcZipAppendSegmentEx(zip, stream_ofs, header_size, 0, header_size, bit_flag, 0, compression_method, 0, 0, 0, partName, relsSegment, true);
+            }
+        } // else only one segment can be written at a time
+    } else if ((uint32_t)-1==segment_id) { //@TODO find free segment
+        opc_ofs_t stream_ofs=(zip->segment_items>0?zip->segment_array[zip->segment_items-1].stream_ofs+zip->segment_array[zip->segment_items-1].segment_size:0);
         uint32_t _growth_hint=(growth_hint>0?growth_hint:OPC_DEFAULT_GROWTH_HINT);
-        size_t _segment_size=(segment_size>0?segment_size:_growth_hint);
+        opc_ofs_t _segment_size=(segment_size>0?segment_size:_growth_hint);
         char name8[OPC_MAX_PATH];
         uint16_t name8_len=opcHelperAssembleSegmentName(name8, sizeof(name8), partName, 0, -1, relsSegment, NULL);
-        uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, NULL);
+        uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, false, NULL);
         if (OPC_ERROR_NONE==_opcZipFileGrow(zip->io, stream_ofs+_segment_size)) {
-            segment_id=opcZipAppendSegmentEx(zip, stream_ofs, _segment_size, 0, header_size, bit_flag, 0, compression_method, 0, 0, _growth_hint, partName, relsSegment);
+            segment_id=opcZipAppendSegmentEx(zip, stream_ofs, _segment_size, 0, header_size, bit_flag, 0, compression_method, 0, 0, _growth_hint, partName, relsSegment, false);
         }
     }
     return segment_id;
 }
 
 opc_error_t opcZipGC(opcZip *zip) {
+    opc_error_t err=opcZipLoadAllHeaders(zip);
+    if (OPC_ERROR_NONE!=err) return err;
     for(uint32_t i=1;i<zip->segment_items;i++) { 
         assert(zip->segment_array[i-1].stream_ofs+zip->segment_array[i-1].segment_size==zip->segment_array[i].stream_ofs);
         if (!zip->segment_array[i-1].deleted_segment && !zip->segment_array[i].deleted_segment) {
@@ -1054,9 +1965,9 @@ opc_error_t opcZipGC(opcZip *zip) {
             char name8[OPC_MAX_PATH];
             uint16_t name8_len=opcHelperAssembleSegmentName(name8, sizeof(name8), segment->partName,  0, -1, segment->rels_segment, NULL);
             name8[name8_len]=0;
-            uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, NULL);
+            uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, segment->zip64_segment, NULL);
             if (header_size>segment->header_size) {
-                header_size=opcZipCalculateHeaderSize(name8, name8_len, false, NULL);
+                header_size=opcZipCalculateHeaderSize(name8, name8_len, false, segment->zip64_segment, NULL);
             }
             assert(header_size<=segment->header_size);
             uint32_t const free_space=segment->padding+(segment->header_size-header_size);
@@ -1072,7 +1983,7 @@ opc_error_t opcZipGC(opcZip *zip) {
     return OPC_ERROR_NONE;
 }
 
-static void opcZipSegmentCalcReal(opcZip *zip, uint32_t segment_id, size_t *real_padding, size_t *real_ofs) {
+static void opcZipSegmentCalcReal(opcZip *zip, uint32_t segment_id, opc_ofs_t *real_padding, opc_ofs_t *real_ofs) {
     assert(segment_id>=0 && segment_id<zip->segment_items);
     *real_padding=zip->segment_array[segment_id].padding;
     uint32_t i=segment_id; 
@@ -1082,7 +1993,7 @@ static void opcZipSegmentCalcReal(opcZip *zip, uint32_t segment_id, size_t *real
     *real_ofs=zip->segment_array[i].stream_ofs;
     if (i>0) {
         assert(!zip->segment_array[i-1].deleted_segment);
-        size_t trailing_space=zip->segment_array[i].stream_ofs
+        opc_ofs_t trailing_space=zip->segment_array[i].stream_ofs
                                 -zip->segment_array[i-1].stream_ofs
                                 -zip->segment_array[i-1].padding
                                 -zip->segment_array[i-1].header_size
@@ -1092,16 +2003,16 @@ static void opcZipSegmentCalcReal(opcZip *zip, uint32_t segment_id, size_t *real
     }
 }
 
-static bool opcZipValidate(opcZip *zip, size_t *append_ofs) {
+static bool opcZipValidate(opcZip *zip, opc_ofs_t *append_ofs) {
     bool valid=true;
     for(uint32_t i=0;i<zip->segment_items;i++) { if (!zip->segment_array[i].deleted_segment) {
-        size_t real_padding=0;
-        size_t real_ofs=0;
+        opc_ofs_t real_padding=0;
+        opc_ofs_t real_ofs=0;
         opcZipSegmentCalcReal(zip, i, &real_padding, &real_ofs);
         char name8[OPC_MAX_PATH];
         uint16_t name8_len=opcHelperAssembleSegmentName(name8, sizeof(name8), zip->segment_array[i].partName,  0, -1, zip->segment_array[i].rels_segment, NULL);
         name8[name8_len]=0;
-        uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, NULL);
+        uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, zip->segment_array[i].zip64_segment, NULL);
         valid=valid && (real_padding==0 || header_size<=zip->segment_array[i].header_size); // check padding>0 needs extra!
         valid=valid&&(real_padding<65000); //@TODO get real value for max padding!
         if (NULL!=append_ofs) *append_ofs=real_ofs+real_padding+zip->segment_array[i].compressed_size+zip->segment_array[i].header_size;
@@ -1109,18 +2020,18 @@ static bool opcZipValidate(opcZip *zip, size_t *append_ofs) {
     return valid;
 }
 
-static void opcZipTrim(opcZip *zip, size_t *append_ofs) {
-    size_t ofs=0;
+static void opcZipTrim(opcZip *zip, opc_ofs_t *append_ofs) {
+    opc_ofs_t ofs=0;
     for(uint32_t i=0;i<zip->segment_items;i++) { 
         if (!zip->segment_array[i].deleted_segment) {
-            size_t real_padding=0;
-            size_t real_ofs=0;
+            opc_ofs_t real_padding=0;
+            opc_ofs_t real_ofs=0;
             opcZipSegmentCalcReal(zip, i, &real_padding, &real_ofs);
             assert(ofs<=real_ofs);
             if (real_padding>0 || ofs<real_ofs) {
-                size_t src_ofs=real_ofs+real_padding+zip->segment_array[i].header_size;
-                size_t dest_ofs=ofs+zip->segment_array[i].header_size;
-                size_t len=zip->segment_array[i].compressed_size;
+                opc_ofs_t src_ofs=real_ofs+real_padding+zip->segment_array[i].header_size;
+                opc_ofs_t dest_ofs=ofs+zip->segment_array[i].header_size;
+                opc_ofs_t len=zip->segment_array[i].compressed_size;
                 assert(dest_ofs<src_ofs);
                 if (dest_ofs<src_ofs) {
                     OPC_ENSURE(OPC_ERROR_NONE==_opcZipFileMove(zip->io, dest_ofs, src_ofs, len));
@@ -1151,15 +2062,102 @@ static void opcZipTrim(opcZip *zip, size_t *append_ofs) {
     if (NULL!=append_ofs) *append_ofs=ofs;
 }
 
+static uint32_t opcZipSegmentOrder(opcZip *zip, const uint32_t *segment_id_array, uint32_t segment_items, uint32_t *order_array, uint32_t *new_id) {
+    // the given segments first, then all others in their current order. Deleted segments are dropped.
+    uint32_t order_items=0;
+    for(uint32_t i=0;i<zip->segment_items;i++) {
+        new_id[i]=-1;
+    }
+    for(uint32_t i=0;i<segment_items+zip->segment_items;i++) {
+        uint32_t const segment_id=(i<segment_items?segment_id_array[i]:i-segment_items);
+        if (segment_id<zip->segment_items && !zip->segment_array[segment_id].deleted_segment && (uint32_t)-1==new_id[segment_id]) {
+            new_id[segment_id]=order_items;
+            order_array[order_items++]=segment_id;
+        }
+    }
+    return order_items;
+}
+
+static void opcZipSegmentReorder(opcZip *zip, const uint32_t *order_array, uint32_t order_items, const uint32_t *new_id, opcZipSegment *old_array) {
+    memcpy(old_array, zip->segment_array, zip->segment_items*sizeof(opcZipSegment));
+    for(uint32_t i=0;i<zip->segment_items;i++) {
+        if ((uint32_t)-1==new_id[i]) {
+            opcZipSegmentFreeSeekIndex(zip, &old_array[i]); // deleted segments are dropped
+        }
+    }
+    for(uint32_t i=0;i<order_items;i++) {
+        opcZipSegment *segment=&zip->segment_array[i];
+        *segment=old_array[order_array[i]];
+        segment->next_segment_id=((uint32_t)-1!=segment->next_segment_id && segment->next_segment_id<zip->segment_items?new_id[segment->next_segment_id]:(uint32_t)-1);
+    }
+    zip->segment_items=order_items;
+    zip->first_free_segment_id=-1;
+}
+
+opc_error_t opcZipDefrag(opcZip *zip, const uint32_t *segment_id_array, uint32_t segment_items) {
+    if (zip->streaming) {
+        return OPC_ERROR_NONE; // streamed segments can not be moved
+    }
+    opc_error_t err=opcZipLoadAllHeaders(zip);
+    uint32_t *order_array=(zip->segment_items>0?(uint32_t *)opcHelperMalloc(zip->io->allocator, 2*zip->segment_items*sizeof(uint32_t)):NULL);
+    opcZipSegment *old_array=(zip->segment_items>0?(opcZipSegment *)opcHelperMalloc(zip->io->allocator, zip->segment_items*sizeof(opcZipSegment)):NULL);
+    if (OPC_ERROR_NONE==err && zip->segment_items>0 && (NULL==order_array || NULL==old_array)) {
+        err=OPC_ERROR_MEMORY;
+    }
+    if (OPC_ERROR_NONE==err && zip->segment_items>0) {
+        uint32_t *new_id=order_array+zip->segment_items; // old segment id -> new segment id
+        for(uint32_t i=0;i<zip->segment_items;i++) {
+            zip->segment_array[i].bit_flag&=~(1<<3); // data descriptors are dropped, see opcZipCommit
+        }
+        opc_ofs_t end=0;
+        opcZipTrim(zip, &end); // no gaps anymore, i.e. the segments are stored in the order of their ids
+        uint32_t const order_items=opcZipSegmentOrder(zip, segment_id_array, segment_items, order_array, new_id);
+        // segments which are in place already stay where they are, all others are appended in the new order...
+        uint32_t keep=0;
+        opc_ofs_t ofs=0;
+        for(uint32_t i=0;i<zip->segment_items && keep<order_items;i++) {
+            if (!zip->segment_array[i].deleted_segment) {
+                if (order_array[keep]!=i) break;
+                ofs+=zip->segment_array[i].segment_size;
+                keep++;
+            }
+        }
+        opc_ofs_t append_ofs=end;
+        for(uint32_t i=keep;OPC_ERROR_NONE==err && i<order_items;i++) {
+            opcZipSegment *segment=&zip->segment_array[order_array[i]];
+            err=_opcZipFileGrow(zip->io, append_ofs+segment->segment_size);
+            if (OPC_ERROR_NONE==err) err=_opcZipFileMove(zip->io, append_ofs+segment->header_size, segment->stream_ofs+segment->header_size, segment->compressed_size);
+            segment->stream_ofs=append_ofs;
+            append_ofs+=segment->segment_size;
+        }
+        // ...and moved down in one go. The local headers are written by opcZipCommit.
+        if (OPC_ERROR_NONE==err && append_ofs>end) {
+            err=_opcZipFileMove(zip->io, ofs, end, append_ofs-end);
+        }
+        if (OPC_ERROR_NONE==err) {
+            for(uint32_t i=keep;i<order_items;i++) {
+                zip->segment_array[order_array[i]].stream_ofs-=end-ofs;
+            }
+            opcZipSegmentReorder(zip, order_array, order_items, new_id, old_array);
+        }
+    }
+    if (NULL!=order_array) opcHelperFree(zip->io->allocator, order_array);
+    if (NULL!=old_array) opcHelperFree(zip->io->allocator, old_array);
+    if (OPC_ERROR_NONE!=err && OPC_ERROR_NONE==zip->io->state.err) {
+        zip->io->state.err=err;
+    }
+    return err;
+}
+
 static void opcZipUpdateLocalFileHeader(opcZip *zip) {
     for(uint32_t i=0;i<zip->segment_items;i++) { if (!zip->segment_array[i].deleted_segment) {
-        size_t real_padding=0;
-        size_t real_ofs=0;
+        opc_ofs_t real_padding=0;
+        opc_ofs_t real_ofs=0;
         opcZipSegmentCalcReal(zip, i, &real_padding, &real_ofs);
         OPC_ENSURE(_opcZipFileSeek(zip->io, real_ofs, opcFileSeekSet)==real_ofs);
         char name8[OPC_MAX_PATH];
         uint16_t name8_len=opcHelperAssembleSegmentName(name8, sizeof(name8), zip->segment_array[i].partName, 0, -1, zip->segment_array[i].rels_segment, NULL);
-//        uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, NULL);
+//        uint32_t header_size=opcZipCalculateHeaderSize(name8, name8_len, true, false, NULL);
         assert(zip->segment_array[i].stream_ofs+zip->segment_array[i].padding==real_ofs+real_padding);
         OPC_ENSURE(opcZipRawWriteSegmentHeaderEx(zip->io, &zip->io->state, 
                                                  name8, name8_len, 
@@ -1169,18 +2167,21 @@ static void opcZipUpdateLocalFileHeader(opcZip *zip) {
                                                  zip->segment_array[i].compressed_size,
                                                  zip->segment_array[i].uncompressed_size,
                                                  zip->segment_array[i].header_size+real_padding,
-                                                 zip->segment_array[i].growth_hint)==zip->segment_array[i].header_size+real_padding);
+                                                 zip->segment_array[i].growth_hint,
+                                                 zip->segment_array[i].zip64_segment)==zip->segment_array[i].header_size+real_padding);
         assert(zip->segment_array[i].stream_ofs+zip->segment_array[i].padding+zip->segment_array[i].header_size==zip->io->state.buf_pos);
     } }
 }
 
-static void opcZipAppendDirectory(opcZip *zip, size_t append_ofs) {
+static void opcZipAppendDirectory(opcZip *zip, opc_ofs_t append_ofs) {
     OPC_ENSURE(_opcZipFileSeek(zip->io, append_ofs, opcFileSeekSet)==append_ofs);
     uint32_t real_segments=0;
     for(uint32_t i=0;i<zip->segment_items;i++) { if (!zip->segment_array[i].deleted_segment) {
-        size_t real_padding=0;
-        size_t real_ofs=0;
-        opcZipSegmentCalcReal(zip, i, &real_padding, &real_ofs);
+        opc_ofs_t real_padding=0;
+        opc_ofs_t real_ofs=zip->segment_array[i].stream_ofs;
+        if (!zip->streaming) { // streamed segments are never moved, deleted ones just stay in the stream
+            opcZipSegmentCalcReal(zip, i, &real_padding, &real_ofs);
+        }
         char name8[OPC_MAX_PATH];
         uint16_t name8_len=opcHelperAssembleSegmentName(name8, sizeof(name8), zip->segment_array[i].partName, 0, -1, zip->segment_array[i].rels_segment, NULL);
         OPC_ENSURE(OPC_ERROR_NONE==opcZipRawWriteCentralDirectoryEx(zip->io, &zip->io->state,
@@ -1196,11 +2197,28 @@ static void opcZipAppendDirectory(opcZip *zip, size_t append_ofs) {
         real_segments++;
     } }
     OPC_ENSURE(OPC_ERROR_NONE==opcZipRawWriteEndOfCentralDirectoryEx(zip->io, &zip->io->state, append_ofs, real_segments));
-    OPC_ENSURE(OPC_ERROR_NONE==_opcZipFileTrim(zip->io, zip->io->state.buf_pos));
+    if (!zip->streaming) {
+        OPC_ENSURE(OPC_ERROR_NONE==_opcZipFileTrim(zip->io, zip->io->state.buf_pos));
+    }
 }
 
 opc_error_t opcZipCommit(opcZip *zip, bool trim) {
-    size_t append_ofs=0;
+    opc_ofs_t append_ofs=0;
+    if (zip->streaming) {
+        // all local headers and data have been written already, just append the directory.
+        if ((uint32_t)-1!=zip->streaming_segment_id && OPC_ERROR_NONE==zip->io->state.err) {
+            zip->io->state.err=OPC_ERROR_STREAM; // output stream still open
+        }
+        opcZipAppendDirectory(zip, zip->io->state.buf_pos);
+        if (NULL!=zip->io->_ioflush) {
+            OPC_ENSURE(OPC_ERROR_NONE==_opcZipFileFlush(zip->io));
+        }
+        return zip->io->state.err;
+    }
+    OPC_ENSURE(OPC_ERROR_NONE==opcZipLoadAllHeaders(zip));
+    for(uint32_t i=0;i<zip->segment_items;i++) {
+        zip->segment_array[i].bit_flag&=~(1<<3); // crc and sizes go to the local header, data descriptors are not needed (and dropped by trimming)
+    }
     if (!opcZipValidate(zip, &append_ofs) || trim) {
         opcZipTrim(zip, &append_ofs);
         assert(opcZipValidate(zip, NULL));
@@ -1211,54 +2229,147 @@ opc_error_t opcZipCommit(opcZip *zip, bool trim) {
     return zip->io->state.err;
 }
 
-opcZipOutputStream *opcZipOpenOutputStream(opcZip *zip, uint32_t *segment_id) {
-    assert(NULL!=zip && NULL!=segment_id && -1!=*segment_id);
-    assert(*segment_id>=0 && *segment_id<zip->segment_items);
-    opcZipSegment *segment=&zip->segment_array[*segment_id];
-    assert(segment->header_size+segment->padding<=segment->segment_size);
-    size_t free_size=segment->segment_size-segment->header_size-segment->padding;
-    uint32_t buf_size=(free_size>OPC_DEFLATE_BUFFER_SIZE?OPC_DEFLATE_BUFFER_SIZE:free_size);
-    opcZipOutputStream *out=(opcZipOutputStream *)xmlMalloc(sizeof(opcZipOutputStream)+OPC_DEFLATE_BUFFER_SIZE);
+opc_error_t opcZipCommitTo(opcZip *zip, opcIO_t *io, const uint32_t *segment_id_array, uint32_t segment_items) {
+    assert(!zip->streaming && io!=zip->io);
+    opc_error_t err=opcZipLoadAllHeaders(zip);
+    uint32_t *order_array=(zip->segment_items>0?(uint32_t *)opcHelperMalloc(zip->io->allocator, 2*zip->segment_items*sizeof(uint32_t)):NULL);
+    opcZipSegment *old_array=(zip->segment_items>0?(opcZipSegment *)opcHelperMalloc(zip->io->allocator, zip->segment_items*sizeof(opcZipSegment)):NULL);
+    if (OPC_ERROR_NONE==err && zip->segment_items>0 && (NULL==order_array || NULL==old_array)) {
+        err=OPC_ERROR_MEMORY;
+    }
+    if (OPC_ERROR_NONE==err && zip->segment_items>0) {
+        // every segment is copied raw behind the previous one, with a fresh local header and without a descriptor.
+        uint32_t *new_id=order_array+zip->segment_items;
+        uint32_t const order_items=opcZipSegmentOrder(zip, segment_id_array, segment_items, order_array, new_id);
+        uint8_t buf[16*1024];
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<order_items;i++) {
+            opcZipSegment *segment=&zip->segment_array[order_array[i]];
+            char name8[OPC_MAX_PATH];
+            uint16_t name8_len=opcHelperAssembleSegmentName(name8, sizeof(name8), segment->partName, 0, -1, segment->rels_segment, NULL);
+            bool const zip64=(segment->compressed_size>=OPC_ZIP64_LIMIT || segment->uncompressed_size>=OPC_ZIP64_LIMIT);
+            uint16_t const header_size=opcZipCalculateHeaderSize(name8, name8_len, false, zip64, NULL);
+            opc_ofs_t const stream_ofs=io->state.buf_pos;
+            opc_ofs_t const data_ofs=segment->stream_ofs+segment->padding+segment->header_size;
+            segment->bit_flag&=~(1<<3);
+            if (header_size!=opcZipRawWriteSegmentHeaderEx(io, &io->state, name8, name8_len, 
+                                                          segment->bit_flag, 
+                                                          segment->crc32, 
+                                                          segment->compression_method, 
+                                                          segment->compressed_size, 
+                                                          segment->uncompressed_size, 
+                                                          header_size, 
+                                                          segment->growth_hint, 
+                                                          zip64)
+             || (segment->compressed_size>0 && _opcZipFileSeek(zip->io, data_ofs, opcFileSeekSet)!=data_ofs)) {
+                err=OPC_ERROR_STREAM;
+            }
+            for(opc_ofs_t len=segment->compressed_size;OPC_ERROR_NONE==err && len>0;) {
+                uint32_t const chunk=(len>sizeof(buf)?(uint32_t)sizeof(buf):(uint32_t)len);
+                if (chunk!=_opcZipFileRead(zip->io, buf, chunk) || chunk!=_opcZipFileWrite(io, buf, chunk)) {
+                    err=OPC_ERROR_STREAM;
+                }
+                len-=chunk;
+            }
+            segment->stream_ofs=stream_ofs;
+            segment->padding=0;
+            segment->header_size=header_size;
+            segment->segment_size=header_size+segment->compressed_size;
+            segment->zip64_segment=zip64;
+        }
+        if (OPC_ERROR_NONE==err) {
+            opcZipSegmentReorder(zip, order_array, order_items, new_id, old_array);
+        }
+    }
+    if (NULL!=order_array) opcHelperFree(zip->io->allocator, order_array);
+    if (NULL!=old_array) opcHelperFree(zip->io->allocator, old_array);
+    if (OPC_ERROR_NONE==err) {
+        // the directory is written like by opcZipCommit, just to io.
+        opcIO_t *const zip_io=zip->io;
+        zip->io=io;
+        opcZipAppendDirectory(zip, io->state.buf_pos);
+        OPC_ENSURE(OPC_ERROR_NONE==_opcZipFileFlush(io));
+        zip->io=zip_io;
+        err=io->state.err;
+    }
+    return err;
+}
+
+static opcCompressionOption_t opcZipCompressionOption(uint16_t bit_flag) {
+    opcCompressionOption_t compression_option=OPC_COMPRESSIONOPTION_NORMAL;
+    switch ((bit_flag>>1) & 0x3) {
+    default: 
+    case 0: compression_option=OPC_COMPRESSIONOPTION_NORMAL; 
+        break;
+    case 1: compression_option=OPC_COMPRESSIONOPTION_MAXIMUM; 
+        break;
+    case 2: compression_option=OPC_COMPRESSIONOPTION_FAST; 
+        break;
+    case 3: compression_option=OPC_COMPRESSIONOPTION_SUPERFAST; 
+        break;
+    }
+    return compression_option;
+}
+
+static opcZipOutputStream *opcZipAllocOutputStream(opcZip *zip, uint16_t compression_method, uint16_t bit_flag, uint32_t buf_size) {
+    opcZipOutputStream *out=(opcZipOutputStream *)opcHelperMalloc(zip->io->allocator, sizeof(opcZipOutputStream)+OPC_DEFLATE_BUFFER_SIZE);
     if (NULL!=out) {
         opc_bzero_mem(out, sizeof(*out));
         out->buf=(uint8_t*)((&out->buf)+1); // buffer starts right after me...
         out->buf_size=buf_size;
+        out->segment_id=-1;
+        out->compression_method=compression_method;
+        out->bit_flag=bit_flag;
+        out->codec=zip->codec;
+        assert(0==out->compression_method || 8==out->compression_method);
+        if (8==out->compression_method) { // delfate
+            if (NULL==(out->codec_state=out->codec->deflate_init(out->codec->codec_ctx, opcZipCompressionOption(bit_flag)))) {
+                opcHelperFree(zip->io->allocator, out); out=NULL;
+            }
+        }
+    }
+    return out;
+}
+
+opcZipOutputStream *opcZipOpenOutputStream(opcZip *zip, uint32_t *segment_id) {
+    assert(NULL!=zip && NULL!=segment_id && (uint32_t)-1!=*segment_id);
+    assert(*segment_id<zip->segment_items);
+    if (zip->streaming && ((uint32_t)-1!=zip->streaming_segment_id || *segment_id+1!=zip->segment_items || zip->segment_array[*segment_id].header_size!=zip->segment_array[*segment_id].segment_size)) {
+        return NULL; // in streaming mode only the segment created last can be written, and only once
+    }
+    OPC_ENSURE(OPC_ERROR_NONE==opcZipSegmentLoadHeader(zip, *segment_id));
+    opcZipSegment *segment=&zip->segment_array[*segment_id];
+    opcZipSegmentFreeSeekIndex(zip, segment); // content will be overwritten
+    assert(segment->header_size+segment->padding<=segment->segment_size);
+    opc_ofs_t free_size=segment->segment_size-segment->header_size-segment->padding;
+    uint32_t buf_size=(free_size>OPC_DEFLATE_BUFFER_SIZE || zip->streaming?OPC_DEFLATE_BUFFER_SIZE:free_size);
+    opcZipOutputStream *out=opcZipAllocOutputStream(zip, segment->compression_method, segment->bit_flag, buf_size);
+    if (NULL!=out) {
         out->segment_id=*segment_id;
         *segment_id=-1; // take ownership
         segment->compressed_size=0;
         segment->uncompressed_size=0;
         segment->crc32=0;
-        out->compression_method=segment->compression_method;
-        assert(0==out->compression_method || 8==out->compression_method);
-        if (8==out->compression_method) { // delfate
-            out->stream.zalloc = Z_NULL;
-            out->stream.zfree = Z_NULL;
-            out->stream.opaque = Z_NULL;
-            int level=Z_DEFAULT_COMPRESSION;
-            switch ((segment->bit_flag>>1) & 0x3) {
-            default: 
-            case 0: level=Z_DEFAULT_COMPRESSION; 
-                break;
-            case 1: level=Z_BEST_COMPRESSION; 
-                break;
-            case 2: level=Z_BEST_SPEED; 
-                break;
-            case 3: level=Z_BEST_SPEED; 
-                break;
-            }
-            if (Z_OK!=(out->inflate_state=deflateInit2(&out->stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY))) {
-                xmlFree(out); out=NULL;
-            }
+        if (zip->streaming) {
+            zip->streaming_segment_id=out->segment_id;
         }
     }
     return out;
 }
 
+opcZipOutputStream *opcZipCreateDetachedOutputStream(opcZip *zip, uint16_t compression_method, uint16_t bit_flag) {
+    assert(0==compression_method || 8==compression_method); // either STORE or DEFLATE
+    opcZipOutputStream *out=opcZipAllocOutputStream(zip, compression_method, bit_flag, OPC_DEFLATE_BUFFER_SIZE);
+    if (NULL!=out) {
+        out->detached=true;
+    }
+    return out;
+}
+
 opcZipOutputStream *opcZipCreateOutputStream(opcZip *zip, 
                                              uint32_t *segment_id, 
                                              const xmlChar *partName, 
                                              bool relsSegment, 
-                                             uint32_t segment_size, 
+                                             opc_ofs_t segment_size, 
                                              uint32_t growth_hint,
                                              uint16_t compression_method,
                                              uint16_t bit_flag) {
@@ -1270,14 +2381,22 @@ opcZipOutputStream *opcZipCreateOutputStream(opcZip *zip,
         } else {
             assert(*segment_id>=0 && *segment_id<zip->segment_items);
             opcZipSegment *segment=&zip->segment_array[*segment_id];
-            segment->bit_flag=bit_flag;
-            segment->compression_method=compression_method;
+            if (!zip->streaming) { // otherwise the local header has been written already
+                segment->bit_flag=bit_flag;
+                segment->compression_method=compression_method;
+            }
+        }
+        if ((uint32_t)-1!=*segment_id) { // e.g. another stream is still open in streaming mode
+            ret=opcZipOpenOutputStream(zip, segment_id);
         }
-        ret=opcZipOpenOutputStream(zip, segment_id);
     }
     return ret;
 }
 
+static inline opc_error_t *opcZipOutputStreamError(opcZip *zip, opcZipOutputStream *stream) {
+    return (stream->detached?&stream->err:&zip->io->state.err); // detached streams do not touch the zip
+}
+
 static uint32_t opcZipOutputStreamFill(opcZip *zip, opcZipOutputStream *stream, const uint8_t *data, uint32_t data_len) {
     assert(NULL!=stream && NULL!=stream->buf && NULL!=data && stream->buf_ofs+stream->buf_len<=stream->buf_size);
     uint32_t const free=stream->buf_size-stream->buf_ofs-stream->buf_len;
@@ -1286,28 +2405,31 @@ static uint32_t opcZipOutputStreamFill(opcZip *zip, opcZipOutputStream *stream,
     assert(len<=data_len && len<=stream->buf_size-(stream->buf_ofs+stream->buf_len));
     if (len>0) {
         if (0==stream->compression_method) { // STORE
-            stream->stream.total_in+=len;
-            stream->stream.total_out+=len;
-            stream->crc32=crc32(stream->crc32, data, len);
+            stream->total_in+=len;
+            stream->total_out+=len;
+            stream->crc32=opcHelperCrc32(stream->crc32, data, len);
             memcpy(stream->buf+stream->buf_ofs, data, len);
             stream->buf_len+=len;
             ret=len;
         } else if (8==stream->compression_method) { // DEFLATE
-            stream->stream.avail_in=data_len;
-            stream->stream.next_in=(Bytef*)data;
-            stream->stream.avail_out=free;
-            stream->stream.next_out=stream->buf+stream->buf_ofs;
-            if (Z_OK==(stream->inflate_state=deflate(&stream->stream, Z_NO_FLUSH))) {
-                uint32_t const bytes_in=data_len-stream->stream.avail_in;
-                uint32_t const bytes_out=free-stream->stream.avail_out;
-                stream->crc32=crc32(stream->crc32, data, bytes_in);
+            const uint8_t *next_in=data;
+            uint32_t avail_in=data_len;
+            uint8_t *next_out=stream->buf+stream->buf_ofs+stream->buf_len;
+            uint32_t avail_out=free;
+            bool eof=false;
+            if (OPC_ERROR_NONE==stream->codec->deflate(stream->codec_state, &next_in, &avail_in, &next_out, &avail_out, false, &eof)) {
+                uint32_t const bytes_in=data_len-avail_in;
+                uint32_t const bytes_out=free-avail_out;
+                stream->crc32=opcHelperCrc32(stream->crc32, data, bytes_in);
                 ret=bytes_in;
                 stream->buf_len+=bytes_out;
+                stream->total_in+=bytes_in;
+                stream->total_out+=bytes_out;
             } else {                
-                zip->io->state.err=OPC_ERROR_DEFLATE;
+                *opcZipOutputStreamError(zip, stream)=OPC_ERROR_DEFLATE;
             }
         } else {
-            zip->io->state.err=OPC_ERROR_UNSUPPORTED_COMPRESSION;
+            *opcZipOutputStreamError(zip, stream)=OPC_ERROR_UNSUPPORTED_COMPRESSION;
         }
     }
     return ret;
@@ -1316,27 +2438,28 @@ static uint32_t opcZipOutputStreamFill(opcZip *zip, opcZipOutputStream *stream,
 
 static bool opcZipOutputStreamFinishCompression(opcZip *zip, opcZipOutputStream *stream) {
     bool ret=false;
-    if (OPC_ERROR_NONE==zip->io->state.err) {
+    if (OPC_ERROR_NONE==*opcZipOutputStreamError(zip, stream)) {
         if (0==stream->compression_method) { // STORE
-            assert(Z_OK==stream->inflate_state);
-            stream->inflate_state=Z_STREAM_END;
-            ret=(Z_STREAM_END==stream->inflate_state);
+            assert(!stream->finished);
+            stream->finished=true;
+            ret=stream->finished;
         } else if (8==stream->compression_method) { // DEFLATE
             uint32_t const free=stream->buf_size-stream->buf_ofs-stream->buf_len;
             assert(free>0); // hmmm --- no space? make sure you correcly growed the segment...
-            stream->stream.avail_in=0;
-            stream->stream.next_in=0;
-            stream->stream.avail_out=free;
-            stream->stream.next_out=stream->buf+stream->buf_ofs;
-            if (Z_OK==(stream->inflate_state=deflate(&stream->stream, Z_FINISH)) || Z_STREAM_END==stream->inflate_state) {
-                uint32_t const bytes_out=free-stream->stream.avail_out;
+            const uint8_t *next_in=NULL;
+            uint32_t avail_in=0;
+            uint8_t *next_out=stream->buf+stream->buf_ofs+stream->buf_len;
+            uint32_t avail_out=free;
+            if (OPC_ERROR_NONE==stream->codec->deflate(stream->codec_state, &next_in, &avail_in, &next_out, &avail_out, true, &stream->finished)) {
+                uint32_t const bytes_out=free-avail_out;
                 stream->buf_len+=bytes_out;
-                ret=(Z_STREAM_END==stream->inflate_state);
+                stream->total_out+=bytes_out;
+                ret=stream->finished;
             } else {
-                zip->io->state.err=OPC_ERROR_DEFLATE;
+                *opcZipOutputStreamError(zip, stream)=OPC_ERROR_DEFLATE;
             }
         } else {
-            zip->io->state.err=OPC_ERROR_UNSUPPORTED_COMPRESSION;
+            *opcZipOutputStreamError(zip, stream)=OPC_ERROR_UNSUPPORTED_COMPRESSION;
         }
     }
     return ret;
@@ -1346,6 +2469,7 @@ static void opcZipMarkSegmentDeleted(opcZip *zip, uint32_t segment_id, opcZipSeg
     assert(segment_id>=0 && segment_id<zip->segment_items);
     opcZipSegment *segment=&zip->segment_array[segment_id];
     if (NULL!=releaseCallback) releaseCallback(zip, segment_id);
+    opcZipSegmentFreeSeekIndex(zip, segment);
     segment->deleted_segment=1;
     segment->partName=NULL; // should have been released in "releaseCallback" above
     segment->next_segment_id=zip->first_free_segment_id;
@@ -1354,13 +2478,46 @@ static void opcZipMarkSegmentDeleted(opcZip *zip, uint32_t segment_id, opcZipSeg
 
 static void opcZipOutputStreamFlushAndGrow(opcZip *zip, opcZipOutputStream *stream) {
     opc_error_t err=OPC_ERROR_NONE;
-    if (stream->buf_len>0 && OPC_ERROR_NONE==zip->io->state.err) {
+    if (stream->detached) {
+        if (stream->buf_len>0 && OPC_ERROR_NONE==stream->err) {
+            if (stream->data_len+stream->buf_len>stream->data_size) {
+                opc_ofs_t data_size=(stream->data_size>0?2*stream->data_size:OPC_DEFLATE_BUFFER_SIZE);
+                while(data_size<stream->data_len+stream->buf_len) data_size*=2;
+                uint8_t *data=(uint8_t *)opcHelperRealloc(zip->io->allocator, stream->data, data_size);
+                if (NULL!=data) {
+                    stream->data=data;
+                    stream->data_size=data_size;
+                } else {
+                    stream->err=OPC_ERROR_MEMORY;
+                }
+            }
+            if (OPC_ERROR_NONE==stream->err) {
+                memcpy(stream->data+stream->data_len, stream->buf+stream->buf_ofs, stream->buf_len);
+                stream->data_len+=stream->buf_len;
+                stream->buf_ofs=0;
+                stream->buf_len=0;
+            }
+        }
+    } else if (stream->buf_len>0 && OPC_ERROR_NONE==zip->io->state.err) {
         assert(stream->segment_id>=0 && stream->segment_id<zip->segment_items);
         opcZipSegment *segment=&zip->segment_array[stream->segment_id];
-        size_t ofs=segment->padding+segment->header_size+segment->compressed_size;
+        if (zip->streaming) {
+            // the segment is the last one and grows with every write, there is nothing to move.
+            assert(segment->stream_ofs+segment->segment_size==zip->io->state.buf_pos);
+            OPC_ENSURE(_opcZipFileWrite(zip->io, stream->buf+stream->buf_ofs, stream->buf_len)==stream->buf_len);
+            segment->compressed_size+=stream->buf_len;
+            segment->segment_size+=stream->buf_len;
+            stream->buf_ofs=0;
+            stream->buf_len=0;
+            return;
+        }
+        opc_ofs_t ofs=segment->padding+segment->header_size+segment->compressed_size;
         assert(ofs<=segment->segment_size);
-        size_t free_space=segment->segment_size-ofs;
-        if (stream->buf_len>free_space && stream->segment_id+1==zip->segment_items) {
+        opc_ofs_t free_space=segment->segment_size-ofs;
+        // crossing the 4GB limit needs a ZIP64 extra field in the local header; if there is no room => move to a new segment.
+        bool const zip64=(segment->compressed_size+stream->buf_len>=OPC_ZIP64_LIMIT || stream->total_in>=OPC_ZIP64_LIMIT)
+                         && !opcZipSegmentReserveZip64(segment);
+        if (!zip64 && stream->buf_len>free_space && stream->segment_id+1==zip->segment_items) {
             // not enoght space and last segment => simply grow it...
             segment->growth_hint=(segment->growth_hint<=0?OPC_DEFAULT_GROWTH_HINT:segment->growth_hint);
             assert(segment->growth_hint>0);
@@ -1369,15 +2526,19 @@ static void opcZipOutputStreamFlushAndGrow(opcZip *zip, opcZipOutputStream *stre
             assert(stream->buf_len<=free_space);
             OPC_ENSURE(OPC_ERROR_NONE==_opcZipFileGrow(zip->io, segment->stream_ofs+segment->segment_size));
         }
-        if (stream->buf_len>free_space) {
+        if (zip64 || stream->buf_len>free_space) {
             // can't grow it, so move to a new segment!
-            size_t size_needed=segment->segment_size+stream->buf_len+segment->header_size;
+            opc_ofs_t size_needed=segment->segment_size+stream->buf_len+segment->header_size+(zip64?4+2*8:0);
             uint32_t new_segment_id=opcZipCreateSegment(zip, segment->partName, segment->rels_segment, size_needed, segment->growth_hint, segment->compression_method, segment->bit_flag);
             segment=&zip->segment_array[stream->segment_id]; // recalc segment, since create can realloc base address
             if (OPC_ERROR_NONE==err && -1!=new_segment_id) {
                 assert(new_segment_id>=0 && new_segment_id<zip->segment_items);
                 opcZipSegment *new_segment=&zip->segment_array[new_segment_id];
-                size_t const free_size=new_segment->segment_size-new_segment->header_size-new_segment->padding;
+                if (zip64) {
+                    new_segment->zip64_segment=1;
+                    new_segment->header_size+=4+2*8;
+                }
+                opc_ofs_t const free_size=new_segment->segment_size-new_segment->header_size-new_segment->padding;
                 assert(segment->compressed_size<free_size);
                 err=_opcZipFileMove(zip->io,
                                     new_segment->stream_ofs+new_segment->padding+new_segment->header_size, // dest
@@ -1414,8 +2575,220 @@ static void opcZipOutputStreamFlushAndGrow(opcZip *zip, opcZipOutputStream *stre
     }    
 }
 
+static void opcZipOutputStreamFlushData(opcZip *zip, opcZipOutputStream *stream, const uint8_t *data, opc_ofs_t data_len) {
+    // data is flushed like a full buffer, i.e. the segment grows resp. is collected or streamed as usual.
+    assert(0==stream->buf_len);
+    uint8_t *buf=stream->buf;
+    for(opc_ofs_t ofs=0;OPC_ERROR_NONE==*opcZipOutputStreamError(zip, stream) && ofs<data_len;) {
+        uint32_t const chunk=(data_len-ofs>0x40000000?0x40000000:(uint32_t)(data_len-ofs));
+        stream->buf=(uint8_t *)data+ofs;
+        stream->buf_ofs=0;
+        stream->buf_len=chunk;
+        opcZipOutputStreamFlushAndGrow(zip, stream);
+        ofs+=chunk;
+    }
+    stream->buf=buf;
+    stream->buf_ofs=0;
+    stream->buf_len=0;
+}
+
+typedef struct OPC_ZIPDEFLATEJOB_STRUCT {
+    z_stream strm;
+    const uint8_t *in;
+    uint32_t in_len;
+    const uint8_t *dict; // the input in front of in
+    uint32_t dict_len;
+    bool last;
+    uint8_t *out;
+    uint32_t out_size;
+    uint32_t out_len;
+    uint32_t crc32; // of in
+    opc_error_t err;
+} opcZipDeflateJob;
+
+struct OPC_ZIPPARALLELDEFLATE_STRUCT {
+    opcZipDeflateJob *job_array;
+    uint32_t job_items; // one per thread
+#ifdef OPC_HAVE_PTHREAD
+    pthread_t *thread_array /*[job_items-1]*/;
+#endif
+    uint8_t *in /*[OPC_DEFLATE_DICT_SIZE+job_items*OPC_PARALLEL_DEFLATE_BLOCK_SIZE]*/;
+    uint32_t dict_len; // input kept in front of the pending input
+    uint32_t in_len; // pending input
+};
+
+static void opcZipParallelDeflateFree(opcZip *zip, struct OPC_ZIPPARALLELDEFLATE_STRUCT *parallel) {
+    if (NULL!=parallel->job_array) {
+        for(uint32_t i=0;i<parallel->job_items;i++) {
+            if (NULL!=parallel->job_array[i].out) {
+                deflateEnd(&parallel->job_array[i].strm);
+                opcHelperFree(zip->io->allocator, parallel->job_array[i].out);
+            }
+        }
+        opcHelperFree(zip->io->allocator, parallel->job_array);
+    }
+#ifdef OPC_HAVE_PTHREAD
+    if (NULL!=parallel->thread_array) {
+        opcHelperFree(zip->io->allocator, parallel->thread_array);
+    }
+#endif
+    if (NULL!=parallel->in) {
+        opcHelperFree(zip->io->allocator, parallel->in);
+    }
+    opcHelperFree(zip->io->allocator, parallel);
+}
+
+opc_error_t opcZipSetOutputStreamThreads(opcZip *zip, opcZipOutputStream *stream, uint32_t threads) {
+    assert(NULL!=zip && NULL!=stream);
+#ifdef OPC_HAVE_PTHREAD
+    if (0==threads) {
+        long const cpus=sysconf(_SC_NPROCESSORS_ONLN);
+        threads=(cpus>0?(uint32_t)cpus:1);
+    }
+    if (threads>OPC_MAX_THREADS) threads=OPC_MAX_THREADS; // every thread needs its own buffers
+#else
+    threads=1; // no threads available
+#endif
+    opc_error_t err=OPC_ERROR_NONE;
+    if (stream->total_in>0 || NULL!=stream->parallel) {
+        err=OPC_ERROR_STREAM; // too late
+    } else if (threads>1 && 8==stream->compression_method && &zip->zlib_codec==stream->codec) { // custom codecs compress sequentially
+        struct OPC_ZIPPARALLELDEFLATE_STRUCT *parallel=(struct OPC_ZIPPARALLELDEFLATE_STRUCT *)opcHelperMalloc(zip->io->allocator, sizeof(struct OPC_ZIPPARALLELDEFLATE_STRUCT));
+        if (NULL!=parallel) {
+            opc_bzero_mem(parallel, sizeof(*parallel));
+            parallel->job_items=threads;
+            parallel->in=(uint8_t *)opcHelperMalloc(zip->io->allocator, OPC_DEFLATE_DICT_SIZE+(size_t)threads*OPC_PARALLEL_DEFLATE_BLOCK_SIZE);
+            parallel->job_array=(opcZipDeflateJob *)opcHelperMalloc(zip->io->allocator, threads*sizeof(opcZipDeflateJob));
+            if (NULL!=parallel->job_array) {
+                opc_bzero_mem(parallel->job_array, threads*sizeof(opcZipDeflateJob));
+            }
+#ifdef OPC_HAVE_PTHREAD
+            parallel->thread_array=(pthread_t *)opcHelperMalloc(zip->io->allocator, (threads-1)*sizeof(pthread_t));
+            if (NULL==parallel->thread_array) {
+                err=OPC_ERROR_MEMORY;
+            }
+#endif
+            if (NULL!=parallel->in && NULL!=parallel->job_array && OPC_ERROR_NONE==err) {
+                int const level=opcZipZlibLevel(opcZipCompressionOption(stream->bit_flag));
+                for(uint32_t i=0;OPC_ERROR_NONE==err && i<threads;i++) {
+                    opcZipDeflateJob *job=&parallel->job_array[i];
+                    opcZipZlibInitStream(&job->strm, zip->io->allocator);
+                    if (Z_OK==deflateInit2(&job->strm, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY)) {
+                        job->out_size=(uint32_t)deflateBound(&job->strm, OPC_PARALLEL_DEFLATE_BLOCK_SIZE)+16; // +sync flush marker
+                        if (NULL==(job->out=(uint8_t *)opcHelperMalloc(zip->io->allocator, job->out_size))) {
+                            deflateEnd(&job->strm);
+                            err=OPC_ERROR_MEMORY;
+                        }
+                    } else {
+                        err=OPC_ERROR_MEMORY;
+                    }
+                }
+            } else {
+                err=OPC_ERROR_MEMORY;
+            }
+            if (OPC_ERROR_NONE==err) {
+                stream->parallel=parallel;
+            } else {
+                opcZipParallelDeflateFree(zip, parallel);
+            }
+        } else {
+            err=OPC_ERROR_MEMORY;
+        }
+    }
+    return err;
+}
+
+static void *opcZipDeflateJobRun(void *arg) {
+    opcZipDeflateJob *job=(opcZipDeflateJob *)arg;
+    job->crc32=opcHelperCrc32(0, job->in, job->in_len);
+    job->err=OPC_ERROR_DEFLATE;
+    if (Z_OK==deflateReset(&job->strm) && (0==job->dict_len || Z_OK==deflateSetDictionary(&job->strm, job->dict, job->dict_len))) {
+        job->strm.next_in=(Bytef*)job->in;
+        job->strm.avail_in=job->in_len;
+        job->strm.next_out=job->out;
+        job->strm.avail_out=job->out_size;
+        // all blocks but the last end byte aligned with a sync flush, so they can simply be concatenated.
+        int const ret=deflate(&job->strm, (job->last?Z_FINISH:Z_SYNC_FLUSH));
+        if ((job->last?Z_STREAM_END==ret:Z_OK==ret) && 0==job->strm.avail_in && job->strm.avail_out>0) {
+            job->out_len=job->out_size-job->strm.avail_out;
+            job->err=OPC_ERROR_NONE;
+        }
+    }
+    return NULL;
+}
+
+static void opcZipParallelDeflateRun(opcZip *zip, opcZipOutputStream *stream, bool last) {
+    struct OPC_ZIPPARALLELDEFLATE_STRUCT *parallel=stream->parallel;
+    uint8_t *const in=parallel->in+OPC_DEFLATE_DICT_SIZE;
+    uint32_t job_items=(parallel->in_len+OPC_PARALLEL_DEFLATE_BLOCK_SIZE-1)/OPC_PARALLEL_DEFLATE_BLOCK_SIZE;
+    if (last && 0==job_items) job_items=1; // the final block
+    assert(job_items<=parallel->job_items);
+    for(uint32_t i=0;i<job_items;i++) {
+        opcZipDeflateJob *job=&parallel->job_array[i];
+        job->in=in+i*OPC_PARALLEL_DEFLATE_BLOCK_SIZE;
+        job->in_len=(parallel->in_len-i*OPC_PARALLEL_DEFLATE_BLOCK_SIZE>OPC_PARALLEL_DEFLATE_BLOCK_SIZE?OPC_PARALLEL_DEFLATE_BLOCK_SIZE:parallel->in_len-i*OPC_PARALLEL_DEFLATE_BLOCK_SIZE);
+        job->dict_len=(0==i?parallel->dict_len:OPC_DEFLATE_DICT_SIZE);
+        job->dict=job->in-job->dict_len;
+        job->last=(last && i+1==job_items);
+    }
+#ifdef OPC_HAVE_PTHREAD
+    pthread_t *const thread_array=parallel->thread_array;
+    uint32_t thread_items=0;
+    while(thread_items+1<job_items && 0==pthread_create(&thread_array[thread_items], NULL, opcZipDeflateJobRun, &parallel->job_array[thread_items+1])) {
+        thread_items++;
+    }
+    for(uint32_t i=thread_items+1;i<job_items;i++) {
+        opcZipDeflateJobRun(&parallel->job_array[i]); // could not start a thread
+    }
+    opcZipDeflateJobRun(&parallel->job_array[0]); // the calling thread helps
+    for(uint32_t i=0;i<thread_items;i++) {
+        pthread_join(thread_array[i], NULL);
+    }
+#else
+    for(uint32_t i=0;i<job_items;i++) {
+        opcZipDeflateJobRun(&parallel->job_array[i]);
+    }
+#endif
+    for(uint32_t i=0;i<job_items && OPC_ERROR_NONE==*opcZipOutputStreamError(zip, stream);i++) {
+        opcZipDeflateJob *job=&parallel->job_array[i];
+        if (OPC_ERROR_NONE==job->err) {
+            stream->crc32=crc32_combine(stream->crc32, job->crc32, job->in_len);
+            stream->total_in+=job->in_len;
+            stream->total_out+=job->out_len;
+            opcZipOutputStreamFlushData(zip, stream, job->out, job->out_len);
+        } else {
+            *opcZipOutputStreamError(zip, stream)=job->err;
+        }
+    }
+    // the last OPC_DEFLATE_DICT_SIZE bytes of input are the dictionary of the next block.
+    uint32_t const keep=(parallel->dict_len+parallel->in_len>OPC_DEFLATE_DICT_SIZE?OPC_DEFLATE_DICT_SIZE:parallel->dict_len+parallel->in_len);
+    memmove(in-keep, in+parallel->in_len-keep, keep);
+    parallel->dict_len=keep;
+    parallel->in_len=0;
+    stream->finished=last;
+}
+
+static uint32_t opcZipParallelDeflateWrite(opcZip *zip, opcZipOutputStream *stream, const uint8_t *buf, uint32_t buf_len) {
+    struct OPC_ZIPPARALLELDEFLATE_STRUCT *parallel=stream->parallel;
+    uint32_t const in_size=parallel->job_items*OPC_PARALLEL_DEFLATE_BLOCK_SIZE;
+    uint32_t out=0;
+    while(out<buf_len && OPC_ERROR_NONE==*opcZipOutputStreamError(zip, stream)) {
+        uint32_t const len=(buf_len-out<in_size-parallel->in_len?buf_len-out:in_size-parallel->in_len);
+        memcpy(parallel->in+OPC_DEFLATE_DICT_SIZE+parallel->in_len, buf+out, len);
+        parallel->in_len+=len;
+        out+=len;
+        if (parallel->in_len==in_size) {
+            opcZipParallelDeflateRun(zip, stream, false);
+        }
+    }
+    return out;
+}
+
 static void opcZipOutputStreamFinishSegment(opcZip *zip, opcZipOutputStream *stream) {
-    bool done=false;
+    if (NULL!=stream->parallel) {
+        opcZipParallelDeflateRun(zip, stream, true);
+    }
+    bool done=(NULL!=stream->parallel);
     while(!done && OPC_ERROR_NONE==zip->io->state.err) {
         done=opcZipOutputStreamFinishCompression(zip, stream);
         opcZipOutputStreamFlushAndGrow(zip, stream);
@@ -1423,27 +2796,75 @@ static void opcZipOutputStreamFinishSegment(opcZip *zip, opcZipOutputStream *str
 }
 
 
+opc_error_t opcZipAttachOutputStream(opcZip *zip, opcZipOutputStream *stream, const xmlChar *partName, bool relsSegment) {
+    assert(NULL!=zip && NULL!=stream && stream->detached && 0==stream->buf_len);
+    uint32_t segment_id=(OPC_ERROR_NONE==stream->err?opcZipCreateSegment(zip, partName, relsSegment, 0, 0, stream->compression_method, stream->bit_flag):(uint32_t)-1);
+    if ((uint32_t)-1!=segment_id) {
+        stream->detached=false;
+        stream->segment_id=segment_id;
+        if (zip->streaming) {
+            zip->streaming_segment_id=segment_id;
+        }
+        opcZipOutputStreamFlushData(zip, stream, stream->data, stream->data_len);
+        if (NULL!=stream->data) {
+            opcHelperFree(zip->io->allocator, stream->data);
+        }
+        stream->data=NULL;
+        stream->data_len=0;
+        stream->data_size=0;
+    } else if (OPC_ERROR_NONE==stream->err) {
+        stream->err=OPC_ERROR_STREAM; // e.g. another stream is open in streaming mode
+    }
+    return (stream->detached?stream->err:zip->io->state.err);
+}
+
 opc_error_t opcZipCloseOutputStream(opcZip *zip, opcZipOutputStream *stream, uint32_t *segment_id) {
     assert(NULL!=zip && NULL!=segment_id && -1==*segment_id);
+    if (stream->detached) {
+        // never attached => discard the data
+        opc_error_t const err=(OPC_ERROR_NONE!=stream->err?stream->err:OPC_ERROR_STREAM);
+        if (NULL!=stream->codec_state) {
+            stream->codec->deflate_end(stream->codec_state);
+        }
+        if (NULL!=stream->parallel) {
+            opcZipParallelDeflateFree(zip, stream->parallel);
+        }
+        if (NULL!=stream->data) {
+            opcHelperFree(zip->io->allocator, stream->data);
+        }
+        opcHelperFree(zip->io->allocator, stream); stream=NULL;
+        return err;
+    }
     opcZipOutputStreamFinishSegment(zip, stream);
     assert(stream->segment_id>=0 && stream->segment_id<zip->segment_items);
     opcZipSegment *segment=&zip->segment_array[stream->segment_id];
     *segment_id=stream->segment_id;
-    assert(segment->compressed_size==stream->stream.total_out);
-    segment->uncompressed_size=stream->stream.total_in;
+    assert(segment->compressed_size==stream->total_out);
+    segment->uncompressed_size=stream->total_in;
     segment->crc32=stream->crc32;
-    deflateEnd(&stream->stream);
-    xmlFree(stream); stream=NULL;
+    if (zip->streaming) {
+        segment->segment_size+=opcZipRawWriteDataDescriptor(zip->io, &zip->io->state, segment->crc32, segment->compressed_size, segment->uncompressed_size, segment->zip64_segment);
+        zip->streaming_segment_id=-1;
+    }
+    if (NULL!=stream->codec_state) {
+        stream->codec->deflate_end(stream->codec_state);
+    }
+    if (NULL!=stream->parallel) {
+        opcZipParallelDeflateFree(zip, stream->parallel);
+    }
+    opcHelperFree(zip->io->allocator, stream); stream=NULL;
     return zip->io->state.err;
 }
 
 uint32_t opcZipWriteOutputStream(opcZip *zip, opcZipOutputStream *stream, const uint8_t *buf, uint32_t buf_len) {
     uint32_t out=0;
-    do {
+    if (NULL!=stream->parallel) {
+        out=opcZipParallelDeflateWrite(zip, stream, buf, buf_len);
+    } else do {
         out+=opcZipOutputStreamFill(zip, stream, buf+out, buf_len-out);
         assert(out<=buf_len);
         opcZipOutputStreamFlushAndGrow(zip, stream);
-    } while (out<buf_len);
+    } while (out<buf_len && OPC_ERROR_NONE==*opcZipOutputStreamError(zip, stream));
     return out;
 }
 
@@ -49,6 +49,11 @@ extern "C" {
      */
     #define OPC_DEFAULT_GROWTH_HINT 512
 
+    /**
+     Sizes and offsets greater or equal to this value need the ZIP64 extensions.
+     */
+    #define OPC_ZIP64_LIMIT 0xFFFFFFFF
+
     /**
      Handle to a ZIP archive.
      \see internal.h
@@ -76,18 +81,50 @@ extern "C" {
         uint32_t segment_number;
         bool   last_segment;
         bool   rels_segment;
+        bool   zip64_segment;
         uint32_t header_size;
         uint32_t min_header_size;
         uint32_t trailing_bytes;
-        uint32_t compressed_size;
-        uint32_t uncompressed_size;
+        opc_ofs_t compressed_size;
+        opc_ofs_t uncompressed_size;
         uint16_t bit_flag;
         uint32_t data_crc;
         uint16_t compression_method;
-        size_t    stream_ofs;
+        opc_ofs_t stream_ofs;
         uint16_t growth_hint;
     } opcZipSegmentInfo_t;
 
+    /**
+      Compression codec for DEFLATE segments. By default zlib is used.
+      A codec works like zlib's inflate/deflate: it consumes from \c *next_in / \c *avail_in and produces into
+      \c *next_out / \c *avail_out and advances the pointers and counters accordingly. \c *eof must be set to true
+      once the end of the stream has been reached resp. written.
+      The sizes passed to \c inflate_init are the sizes from the ZIP directory, so a codec which can only
+      decompress whole buffers (e.g. libdeflate) can collect the input and decompress it in one go.
+      \see opcZipSetDefaultCodec
+      */
+    typedef struct OPC_ZIP_CODEC_STRUCT {
+        void *(*inflate_init)(void *codec_ctx, opc_ofs_t compressed_size, opc_ofs_t uncompressed_size);
+        opc_error_t (*inflate)(void *state, const uint8_t **next_in, uint32_t *avail_in, uint8_t **next_out, uint32_t *avail_out, bool *eof);
+        opc_error_t (*inflate_end)(void *state);
+        void *(*deflate_init)(void *codec_ctx, opcCompressionOption_t compression_option);
+        opc_error_t (*deflate)(void *state, const uint8_t **next_in, uint32_t *avail_in, uint8_t **next_out, uint32_t *avail_out, bool finish, bool *eof);
+        opc_error_t (*deflate_end)(void *state);
+        void *codec_ctx;
+    } opcZipCodec;
+
+    /**
+      Sets the codec which is used by all ZIP archives created afterwards. If \c codec is NULL then zlib is used.
+      The \c codec must stay valid until all archives using it are closed.
+      Should be called once after \ref opcInitLibrary and before any container is opened.
+      */
+    void opcZipSetDefaultCodec(const opcZipCodec *codec);
+
+    /**
+      Returns the codec which is used for new ZIP archives.
+      */
+    const opcZipCodec *opcZipGetDefaultCodec(void);
+
     /**
       \see opcZipLoader
       */
@@ -118,6 +155,17 @@ extern "C" {
       */
     opc_error_t opcZipLoader(opcIO_t *io, void *userctx, opcZipLoaderSegmentCallback_t *segmentCallback);
 
+    /**
+      Like \c opcZipLoader, but reads the segments from the central directory instead of walking all local headers.
+      Therefore the costs depend on the number of segments and not on the size of the ZIP archive.
+      The local header is only read if the \c open callback is used, so \c info->header_size and 
+      \c info->min_header_size are 0 when the segment is skipped. In this case \c info->trailing_bytes also 
+      includes the local header.
+      If the archive has no usable central directory (e.g. a truncated or streamed archive) then \c opcZipLoader is used.
+      \see opcZipLoader
+      */
+    opc_error_t opcZipDirectoryLoader(opcIO_t *io, void *userctx, opcZipLoaderSegmentCallback_t *segmentCallback);
+
     /**
       \see opcZipClose
      */
@@ -140,11 +188,43 @@ extern "C" {
      */
     opc_error_t opcZipCommit(opcZip *zip, bool trim);
 
+    /**
+      Physically reorders the segments: the segments in \c segment_id_array come first in the given order, then all 
+      other segments in their current order. Deleted segments are dropped. Segments are moved via the end of the file, 
+      segments which are in place already are not touched.
+      \warning Segment ids change, i.e. only call this right before the final \ref opcZipCommit.
+      \see OPC_CLOSE_DEFRAG
+      */
+    opc_error_t opcZipDefrag(opcZip *zip, const uint32_t *segment_id_array, uint32_t segment_items);
+
+    /**
+      Like \ref opcZipCommit, but the archive is written to the empty \c io front to back instead of being updated in place.
+      The segments in \c segment_id_array come first, then all other segments in their current order, each copied as it 
+      is (i.e. without inflating and deflating it) behind a fresh local header. Deleted segments are dropped.
+      \warning Segment ids change and the segments refer to \c io afterwards, i.e. the zip must be closed right after.
+      \see OPC_OPEN_TRANSITION
+      */
+    opc_error_t opcZipCommitTo(opcZip *zip, opcIO_t *io, const uint32_t *segment_id_array, uint32_t segment_items);
+
     /**
       Garbage collection on the passed \c zip archive. This will e.g. make deleted files available as free space.
       */
     opc_error_t opcZipGC(opcZip *zip);
 
+    /**
+      Reads the local headers of all segments, which are otherwise read on first access.
+      Afterwards opening input streams does not modify \c zip anymore.
+      \see opcZipDirectoryLoader
+      */
+    opc_error_t opcZipLoadAllHeaders(opcZip *zip);
+
+    /**
+      Asks the IO to read the segments in \c segment_id_array ahead.
+      The segments are sorted by their position in the file and adjacent segments are requested as one range.
+      \see opcFileAdviseIO
+      */
+    opc_error_t opcZipPrefetchSegments(opcZip *zip, const uint32_t *segment_id_array, uint32_t segment_items);
+
     /**
       Load segment information into \c info.
       If \c rels_segment is -1 then load the info for part with name \c partName.
@@ -160,7 +240,7 @@ extern "C" {
     uint32_t opcZipCreateSegment(opcZip *zip, 
                                      const xmlChar *partName, 
                                      bool relsSegment, 
-                                     uint32_t segment_size, 
+                                     opc_ofs_t segment_size, 
                                      uint32_t growth_hint,
                                      uint16_t compression_method,
                                      uint16_t bit_flag);
@@ -183,6 +263,28 @@ extern "C" {
      */
     uint32_t opcZipReadInputStream(opcZip *zip, opcZipInputStream *stream, uint8_t *buf, uint32_t buf_len);
 
+    /**
+     Positions the input \c stream at the uncompressed offset \c ofs.
+     For deflated segments this uses a per segment index of inflate checkpoints (one every \c OPC_SEEK_INDEX_SPAN bytes),
+     which is built lazily up to \c ofs and kept until \c zip is closed or the segment is changed.
+     \see opcZipBuildSeekIndex
+     */
+    opc_error_t opcZipSeekInputStream(opcZip *zip, opcZipInputStream *stream, opc_ofs_t ofs);
+
+    /**
+     Builds the complete seek index of the segment with \c segment_id. Does nothing for stored segments.
+     \see opcZipSeekInputStream
+     */
+    opc_error_t opcZipBuildSeekIndex(opcZip *zip, uint32_t segment_id);
+
+    /**
+     Returns a pointer to the raw data of the segment with \c segment_id in \c *data and its length in \c *data_len.
+     This only works if the data of \c zip is directly addressable (see \c opcIO_t::data) and the segment is
+     stored uncompressed. Otherwise an error is returned and the segment must be read via \c opcZipOpenInputStream.
+     The pointer is valid until the \c zip is closed.
+     */
+    opc_error_t opcZipMapSegment(opcZip *zip, uint32_t segment_id, const uint8_t **data, opc_ofs_t *data_len);
+
 
     /**
       Creates an output stream for the segment with \c segment_id.
@@ -193,7 +295,7 @@ extern "C" {
                                              uint32_t *segment_id, 
                                              const xmlChar *partName, 
                                              bool relsSegment, 
-                                             uint32_t segment_size, 
+                                             opc_ofs_t segment_size, 
                                              uint32_t growth_hint,
                                              uint16_t compression_method,
                                              uint16_t bit_flag);
@@ -205,8 +307,30 @@ extern "C" {
      */
     opcZipOutputStream *opcZipOpenOutputStream(opcZip *zip, uint32_t *segment_id);
 
+    /**
+      Creates an output stream which is not bound to a segment yet. The compressed data is collected in memory
+      and nothing in \c zip is modified, so detached streams can be written by different threads at the same time.
+      \see opcZipAttachOutputStream
+     */
+    opcZipOutputStream *opcZipCreateDetachedOutputStream(opcZip *zip, uint16_t compression_method, uint16_t bit_flag);
+
+    /**
+      Appends a new segment for the detached \c stream and writes the data collected so far. Afterwards the 
+      \c stream is a regular output stream and must be closed by \ref opcZipCloseOutputStream.
+      \see opcZipCreateDetachedOutputStream
+     */
+    opc_error_t opcZipAttachOutputStream(opcZip *zip, opcZipOutputStream *stream, const xmlChar *partName, bool relsSegment);
+
+    /**
+      Lets up to \c threads threads deflate the \c stream, one per CPU if \c threads is 0. 
+      Must be called before anything is written. Stored streams and custom codecs are not affected.
+      \see opcContainerSetOutputStreamThreads
+     */
+    opc_error_t opcZipSetOutputStreamThreads(opcZip *zip, opcZipOutputStream *stream, uint32_t threads);
+
     /** 
       Will close the stream and free all resources. Additionally the new segment id will be stored in \c *segment_id.
+      Detached streams which have not been attached are discarded.
       \see opcZipOpenOutputStream
       */
     opc_error_t opcZipCloseOutputStream(opcZip *zip, opcZipOutputStream *stream, uint32_t *segment_id);
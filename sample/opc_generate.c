@@ -241,24 +241,23 @@ static void generate_parts(opcContainer *c, FILE *out) {
 }
 
 
-static void visit_all_parts(opcContainer *c, opcPart root, opcPart **visited_parts_array, uint32_t *visited_parts_count) {
-    for(opcRelation rel=opcRelationFirst(c, root)
-       ;OPC_RELATION_INVALID!=rel
-       ;rel=opcRelationNext(c, root, rel)) {
-           opcPart part=opcRelationGetInternalTarget(c, root, rel);
-           if (OPC_PART_INVALID!=part) {
-               if (!is_visited_part(*visited_parts_array, *visited_parts_count, part)) {
-                   add_visited_part(visited_parts_array, visited_parts_count, part);
-                   visit_all_parts(c, part, visited_parts_array, visited_parts_count);
-               }
-           }
-    }
+typedef struct {
+    opcPart *visited_parts_array;
+    uint32_t visited_parts_count;
+} visited_parts_t;
+
+static opc_error_t visit_part(void *userctx, opcPart source, opcRelation relation, opcPart part, uint32_t depth) {
+    (void)source; (void)relation; (void)depth;
+    visited_parts_t *visited=(visited_parts_t *)userctx;
+    add_visited_part(&visited->visited_parts_array, &visited->visited_parts_count, part);
+    return OPC_ERROR_NONE;
 }
 
 static void generate_weak_parts(opcContainer *c, FILE *out) {
-    opcPart *visited_parts_array=NULL;
-    uint32_t visited_parts_count=0;
-    visit_all_parts(c, OPC_PART_INVALID, &visited_parts_array, &visited_parts_count);
+    visited_parts_t visited={ NULL, 0 };
+    opcRelationTraverse(c, OPC_PART_INVALID, NULL, 0, OPC_TRAVERSE_DEPTH_FIRST, visit_part, &visited);
+    opcPart *visited_parts_array=visited.visited_parts_array;
+    uint32_t visited_parts_count=visited.visited_parts_count;
     for(opcPart part=opcPartGetFirst(c);OPC_PART_INVALID!=part;part=opcPartGetNext(c, part)) {
         if (!is_visited_part(visited_parts_array, visited_parts_count, part)) {
             char _part[OPC_MAX_PATH]="";
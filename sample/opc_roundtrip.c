@@ -0,0 +1,1690 @@
+/**
+ Copyright (c) 2010, Florian Reuter
+ All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions 
+ are met:
+ 
+ * Redistributions of source code must retain the above copyright 
+ notice, this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright 
+ notice, this list of conditions and the following disclaimer in 
+ the documentation and/or other materials provided with the 
+ distribution.
+ * Neither the name of Florian Reuter nor the names of its contributors 
+ may be used to endorse or promote products derived from this 
+ software without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+ "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+ LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+ FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+ COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+ INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, 
+ BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+ STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED 
+ OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+    Writes containers with generated content, reads them back and compares the content. Used by the regression tests
+    for the limits of the ZIP format and the different ways of writing and reading a container.
+
+    Ussage:
+    opc_roundtrip entries FILENAME COUNT
+    opc_roundtrip size FILENAME MB
+    opc_roundtrip stream FILENAME
+    opc_roundtrip stream-size FILENAME MB
+    opc_roundtrip template FILENAME TEMPLATE
+    opc_roundtrip transition FILENAME SOURCE
+    opc_roundtrip transition-defrag FILENAME SOURCE
+    opc_roundtrip defrag FILENAME SOURCE
+    opc_roundtrip seek FILENAME
+    opc_roundtrip parallel FILENAME
+    opc_roundtrip crc FILENAME
+    opc_roundtrip extract FILENAME SOURCE THREADS
+    opc_roundtrip extract-modified FILENAME SOURCE THREADS
+    opc_roundtrip detached FILENAME SOURCE
+    opc_roundtrip allocator FILENAME SOURCE
+    opc_roundtrip relation-type FILENAME SOURCE
+    opc_roundtrip incoming FILENAME SOURCE
+    opc_roundtrip traverse FILENAME SOURCE
+    opc_roundtrip codec FILENAME SOURCE
+    opc_roundtrip map FILENAME SOURCE
+    opc_roundtrip relations FILENAME SOURCE
+    opc_roundtrip thread-safe FILENAME SOURCE THREADS
+    opc_roundtrip thread-safe-mmap FILENAME SOURCE THREADS
+
+    Sample:
+    opc_roundtrip entries many.zip 65540
+    opc_roundtrip size big.zip 4200
+*/
+#include <opc/opc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <opc/helper.h> // for opcHelperCrc32
+#ifdef WIN32
+#include <crtdbg.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define OPC_HAVE_PTHREAD
+#endif
+
+#define BUFFER_SIZE (64*1024)
+
+/*
+    The generated content consists of 64 byte lines: the line number as 16 hex digits, followed by letters and a newline.
+    So every offset has a predictable and mostly unique value, and the content compresses well.
+*/
+static void generate(uint8_t *buf, opc_ofs_t ofs, uint32_t len) {
+    static const char hex[]="0123456789abcdef";
+    for(uint32_t i=0;i<len;i++) {
+        opc_ofs_t const line=(ofs+i)>>6;
+        uint32_t const col=(uint32_t)((ofs+i)&63);
+        if (col<16) {
+            buf[i]=hex[(line>>(4*(15-col)))&15];
+        } else if (63==col) {
+            buf[i]='\n';
+        } else {
+            buf[i]=(uint8_t)('a'+(line+col)%26);
+        }
+    }
+}
+
+static opc_error_t writePartEx(opcContainer *c, const char *name, opc_ofs_t size, opcCompressionOption_t option, uint32_t threads) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcPart part=opcPartFind(c, BAD_CAST(name), NULL, 0);
+    if (OPC_PART_INVALID==part) {
+        part=opcPartCreate(c, BAD_CAST(name), BAD_CAST("application/octet-stream"), 0);
+    }
+    opcContainerOutputStream *stream=(OPC_PART_INVALID!=part?opcContainerCreateOutputStream(c, part, option):NULL);
+    if (NULL!=stream) {
+        static uint8_t buf[BUFFER_SIZE];
+        err=(1==threads?OPC_ERROR_NONE:opcContainerSetOutputStreamThreads(stream, threads));
+        for(opc_ofs_t ofs=0;OPC_ERROR_NONE==err && ofs<size;) {
+            uint32_t const len=(size-ofs<sizeof(buf)?(uint32_t)(size-ofs):sizeof(buf));
+            generate(buf, ofs, len);
+            if (len!=opcContainerWriteOutputStream(stream, buf, len)) {
+                err=OPC_ERROR_STREAM;
+            }
+            ofs+=len;
+        }
+        opc_error_t const close_err=opcContainerCloseOutputStream(stream);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    return err;
+}
+
+static opc_error_t writePart(opcContainer *c, const char *name, opc_ofs_t size, opcCompressionOption_t option) {
+    return writePartEx(c, name, size, option, 1);
+}
+
+// Reads the part and compares it with the generated content. The stream error, if any, is reported on closing.
+static opc_error_t verifyPart(opcContainer *c, const char *name, opc_ofs_t size) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainerInputStream *stream=opcContainerOpenInputStream(c, BAD_CAST(name));
+    if (NULL!=stream) {
+        static uint8_t buf[BUFFER_SIZE];
+        static uint8_t expected[BUFFER_SIZE];
+        opc_ofs_t ofs=0;
+        uint32_t len=0;
+        err=OPC_ERROR_NONE;
+        while(OPC_ERROR_NONE==err && (len=opcContainerReadInputStream(stream, buf, sizeof(buf)))>0) {
+            generate(expected, ofs, len);
+            if (0!=memcmp(buf, expected, len)) {
+                err=OPC_ERROR_STREAM;
+            }
+            ofs+=len;
+        }
+        opc_error_t const close_err=opcContainerCloseInputStream(stream);
+        if (OPC_ERROR_NONE==err) err=close_err;
+        if (OPC_ERROR_NONE==err && ofs!=size) {
+            err=OPC_ERROR_STREAM;
+        }
+    }
+    return err;
+}
+
+static void report(const char *what, opc_error_t err) {
+    printf("%s...%s\n", what, (OPC_ERROR_NONE==err?"ok":"failure"));
+}
+
+// More than 65535 parts need the ZIP64 end of central directory record.
+static opc_error_t entriesTest(const char *filename, uint32_t count) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    char name[OPC_MAX_PATH];
+    opcContainer *c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_WRITE_ONLY, NULL, NULL);
+    if (NULL!=c) {
+        err=OPC_ERROR_NONE;
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<count;i++) {
+            snprintf(name, sizeof(name), "data/part%u.bin", i);
+            err=writePart(c, name, i%200, (0==i%2?OPC_COMPRESSIONOPTION_NONE:OPC_COMPRESSIONOPTION_NORMAL));
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+        if (NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+            uint32_t parts=0;
+            for(opcPart part=opcPartGetFirst(c);OPC_PART_INVALID!=part;part=opcPartGetNext(c, part)) {
+                parts++;
+            }
+            printf("%u parts\n", parts);
+            err=(count==parts?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+            for(uint32_t i=0;OPC_ERROR_NONE==err && i<count;i++) {
+                snprintf(name, sizeof(name), "data/part%u.bin", i);
+                err=verifyPart(c, name, i%200);
+            }
+            opcContainerClose(c, OPC_CLOSE_NOW);
+        }
+        report("read", err);
+    }
+    return err;
+}
+
+/*
+    Parts of more than 4GB need the ZIP64 extra fields in the local headers and in the central directory. The deflated 
+    part only exceeds the limit uncompressed, the stored one also moves the part behind it beyond a 4GB offset.
+*/
+static opc_error_t sizeTest(const char *filename, opc_ofs_t size, opcContainerOpenMode flags) {
+    static const struct { const char *name; opcCompressionOption_t option; opc_ofs_t size; } parts[]={
+        { "data/deflated.bin", OPC_COMPRESSIONOPTION_SUPERFAST, 0 },
+        { "data/stored.bin", OPC_COMPRESSIONOPTION_NONE, 0 },
+        { "data/small.bin", OPC_COMPRESSIONOPTION_NORMAL, 1000 }
+    };
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=opcContainerOpen(BAD_CAST(filename), (opcContainerOpenMode)(OPC_OPEN_WRITE_ONLY|flags), NULL, NULL);
+    if (NULL!=c) {
+        err=OPC_ERROR_NONE;
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<sizeof(parts)/sizeof(parts[0]);i++) {
+            err=writePart(c, parts[i].name, (0==parts[i].size?size:parts[i].size), parts[i].option);
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        for(uint32_t i=0;i<sizeof(parts)/sizeof(parts[0]);i++) {
+            opc_ofs_t const part_size=(0==parts[i].size?size:parts[i].size);
+            opc_error_t const part_err=verifyPart(c, parts[i].name, part_size);
+            printf("%s %" PRIu64 "...%s\n", parts[i].name, (uint64_t)part_size, (OPC_ERROR_NONE==part_err?"ok":"failure"));
+            if (OPC_ERROR_NONE==err) err=part_err;
+        }
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+/*
+    Writes a container in streaming mode, i.e. every part is followed by a data descriptor. The central directory is read 
+    back here, the local headers are scanned by opc_zipread, which has to find the end of the stored parts by searching 
+    for their data descriptors.
+*/
+static opc_error_t streamTest(const char *filename) {
+    static const struct { const char *name; opcCompressionOption_t option; opc_ofs_t size; } parts[]={
+        { "data/stored1.bin", OPC_COMPRESSIONOPTION_NONE, 5000 },
+        { "data/deflated.bin", OPC_COMPRESSIONOPTION_NORMAL, 100000 },
+        { "data/stored2.bin", OPC_COMPRESSIONOPTION_NONE, 200000 },
+        { "data/empty.bin", OPC_COMPRESSIONOPTION_NONE, 0 },
+        { "data/superfast.bin", OPC_COMPRESSIONOPTION_SUPERFAST, 3000 }
+    };
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=opcContainerOpen(BAD_CAST(filename), (opcContainerOpenMode)(OPC_OPEN_WRITE_ONLY|OPC_OPEN_STREAMING), NULL, NULL);
+    if (NULL!=c) {
+        err=OPC_ERROR_NONE;
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<sizeof(parts)/sizeof(parts[0]);i++) {
+            err=writePart(c, parts[i].name, parts[i].size, parts[i].option);
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        for(uint32_t i=0;i<sizeof(parts)/sizeof(parts[0]);i++) {
+            opc_error_t const part_err=verifyPart(c, parts[i].name, parts[i].size);
+            printf("%s %" PRIu64 "...%s\n", parts[i].name, (uint64_t)parts[i].size, (OPC_ERROR_NONE==part_err?"ok":"failure"));
+            if (OPC_ERROR_NONE==err) err=part_err;
+        }
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+static bool copyFile(const char *src, const char *dest) {
+    bool ret=false;
+    FILE *in=fopen(src, "rb");
+    FILE *out=(NULL!=in?fopen(dest, "wb"):NULL);
+    if (NULL!=out) {
+        static uint8_t buf[BUFFER_SIZE];
+        size_t len=0;
+        ret=true;
+        while(ret && (len=fread(buf, 1, sizeof(buf), in))>0) {
+            ret=(len==fwrite(buf, 1, len, out));
+        }
+        ret=(0==fclose(out) && ret);
+    }
+    if (NULL!=in) fclose(in);
+    return ret;
+}
+
+// Returns the content of the file, to be released with free().
+static uint8_t *readFile(const char *filename, size_t *data_len) {
+    uint8_t *data=NULL;
+    FILE *in=fopen(filename, "rb");
+    long len=0;
+    if (NULL!=in && 0==fseek(in, 0, SEEK_END) && (len=ftell(in))>0 && NULL!=(data=(uint8_t *)malloc((size_t)len))) {
+        rewind(in);
+        if ((size_t)len==fread(data, 1, (size_t)len, in)) {
+            *data_len=(size_t)len;
+        } else {
+            free(data); data=NULL;
+        }
+    }
+    if (NULL!=in) fclose(in);
+    return data;
+}
+
+static uint32_t fileCrc(const char *filename) {
+    uint32_t crc=0;
+    FILE *in=fopen(filename, "rb");
+    if (NULL!=in) {
+        static uint8_t buf[BUFFER_SIZE];
+        size_t len=0;
+        while((len=fread(buf, 1, sizeof(buf), in))>0) {
+            crc=opcHelperCrc32(crc, buf, len);
+        }
+        fclose(in);
+    }
+    return crc;
+}
+
+// The modifications made to an OOXMLI1.docx like container by the template, transition and defrag tests.
+static opc_error_t modifyContainer(opcContainer *c) {
+    opc_error_t err=opcPartDelete(c, BAD_CAST("customXml/item1.xml"));
+    if (OPC_ERROR_NONE==err) {
+        err=writePart(c, "docProps/app.xml", 3000, OPC_COMPRESSIONOPTION_NORMAL); // replaced
+    }
+    if (OPC_ERROR_NONE==err) {
+        err=writePart(c, "data/added.bin", 20000, OPC_COMPRESSIONOPTION_NORMAL);
+    }
+    return err;
+}
+
+static opc_error_t verifyModifiedContainer(const char *filename) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL);
+    if (NULL!=c) {
+        err=(OPC_PART_INVALID==opcPartFind(c, BAD_CAST("customXml/item1.xml"), NULL, 0)?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+        if (OPC_ERROR_NONE==err) {
+            err=verifyPart(c, "docProps/app.xml", 3000);
+        }
+        if (OPC_ERROR_NONE==err) {
+            err=verifyPart(c, "data/added.bin", 20000);
+        }
+        if (OPC_ERROR_NONE==err) {
+            opcContainerDump(c, stdout);
+        }
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    }
+    report("read", err);
+    return err;
+}
+
+// The template is copied to the new container, and must not be modified.
+static opc_error_t templateTest(const char *filename, const char *template_name) {
+    uint32_t const template_crc=fileCrc(template_name);
+    opc_error_t err=OPC_ERROR_STREAM;
+    remove(filename);
+    opcContainer *c=opcContainerOpen(BAD_CAST(template_name), OPC_OPEN_TEMPLATE, NULL, BAD_CAST(filename));
+    if (NULL!=c) {
+        err=modifyContainer(c);
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    report("template unchanged", (fileCrc(template_name)==template_crc?OPC_ERROR_NONE:OPC_ERROR_STREAM));
+    if (OPC_ERROR_NONE==err) {
+        err=(fileCrc(template_name)==template_crc?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+    }
+    if (OPC_ERROR_NONE==err) {
+        err=verifyModifiedContainer(filename);
+    }
+    return err;
+}
+
+// A copy of src is opened in mode, modified and closed with close_mode.
+static opc_error_t modifyTest(const char *filename, const char *src, opcContainerOpenMode mode, opcContainerCloseMode close_mode) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), mode, NULL, NULL):NULL);
+    if (NULL!=c) {
+        err=modifyContainer(c);
+        opc_error_t const close_err=opcContainerClose(c, close_mode);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err) {
+        err=verifyModifiedContainer(filename);
+    }
+    return err;
+}
+
+// Seeks to ofs and compares up to 100 bytes from there with the generated content.
+static opc_error_t verifySeek(opcContainerInputStream *stream, opc_ofs_t ofs, opc_ofs_t size) {
+    uint8_t buf[100];
+    uint8_t expected[100];
+    opc_error_t err=opcContainerSeekInputStream(stream, ofs);
+    if (OPC_ERROR_NONE==err) {
+        uint32_t const len=(size-ofs<sizeof(buf)?(uint32_t)(size-ofs):sizeof(buf));
+        uint32_t ret=0;
+        uint32_t n=0;
+        while(n<len && (ret=opcContainerReadInputStream(stream, buf+n, len-n))>0) {
+            n+=ret;
+        }
+        generate(expected, ofs, len);
+        err=(n==len && 0==memcmp(buf, expected, len)?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+    }
+    return err;
+}
+
+/*
+    Seeks to the checkpoints of the seek index and the bytes just around them, first forward (collecting the checkpoints),
+    then backward (using them), then after building the whole index in a fresh container. Stored parts are seeked directly.
+*/
+static opc_error_t seekTest(const char *filename) {
+    static const char *parts[]={ "data/deflated.bin", "data/stored.bin" };
+    opc_ofs_t const size=3*OPC_SEEK_INDEX_SPAN+OPC_SEEK_INDEX_SPAN/2;
+    opc_ofs_t ofs_array[4*3+3];
+    uint32_t ofs_items=0;
+    ofs_array[ofs_items++]=0;
+    ofs_array[ofs_items++]=1;
+    for(opc_ofs_t ofs=OPC_SEEK_INDEX_SPAN;ofs<size;ofs+=OPC_SEEK_INDEX_SPAN) {
+        ofs_array[ofs_items++]=ofs-1;
+        ofs_array[ofs_items++]=ofs;
+        ofs_array[ofs_items++]=ofs+1;
+    }
+    ofs_array[ofs_items++]=size-1;
+    ofs_array[ofs_items++]=size; // nothing to read
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_WRITE_ONLY, NULL, NULL);
+    if (NULL!=c) {
+        err=writePart(c, parts[0], size, OPC_COMPRESSIONOPTION_NORMAL);
+        if (OPC_ERROR_NONE==err) {
+            err=writePart(c, parts[1], size, OPC_COMPRESSIONOPTION_NONE);
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    for(uint32_t pass=0;OPC_ERROR_NONE==err && pass<3;pass++) {
+        static const char *pass_names[]={ "forward", "backward", "indexed" };
+        if (NULL==(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+            err=OPC_ERROR_STREAM;
+        }
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<sizeof(parts)/sizeof(parts[0]);i++) {
+            opcContainerInputStream *stream=NULL;
+            if (2==pass) {
+                err=opcContainerBuildSeekIndex(c, BAD_CAST(parts[i]));
+            }
+            if (OPC_ERROR_NONE==err && NULL==(stream=opcContainerOpenInputStream(c, BAD_CAST(parts[i])))) {
+                err=OPC_ERROR_STREAM;
+            }
+            for(uint32_t j=0;OPC_ERROR_NONE==err && j<ofs_items;j++) {
+                for(uint32_t k=0;k<(0==pass?1:2);k++) { // the later passes seek backward, then forward again
+                    opc_ofs_t const ofs=ofs_array[0==pass || 1==k?j:ofs_items-1-j];
+                    opc_error_t const seek_err=verifySeek(stream, ofs, size);
+                    if (0==pass) {
+                        printf("%s %" PRIu64 "...%s\n", parts[i], (uint64_t)ofs, (OPC_ERROR_NONE==seek_err?"ok":"failure"));
+                    }
+                    if (OPC_ERROR_NONE==err) err=seek_err;
+                }
+            }
+            if (OPC_ERROR_NONE==err && OPC_ERROR_SEEK!=opcContainerSeekInputStream(stream, size+1)) {
+                err=OPC_ERROR_STREAM; // behind the end
+            }
+            if (NULL!=stream) {
+                opcContainerCloseInputStream(stream);
+            }
+        }
+        if (NULL!=c) {
+            opcContainerClose(c, OPC_CLOSE_NOW);
+        }
+        report(pass_names[pass], err);
+    }
+    return err;
+}
+
+// Compares the content of two parts byte by byte.
+static opc_error_t compareParts(opcContainer *c, const char *name1, const char *name2) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainerInputStream *stream1=opcContainerOpenInputStream(c, BAD_CAST(name1));
+    opcContainerInputStream *stream2=opcContainerOpenInputStream(c, BAD_CAST(name2));
+    if (NULL!=stream1 && NULL!=stream2) {
+        static uint8_t buf1[BUFFER_SIZE];
+        static uint8_t buf2[BUFFER_SIZE];
+        uint32_t len1=0;
+        err=OPC_ERROR_NONE;
+        do {
+            len1=opcContainerReadInputStream(stream1, buf1, sizeof(buf1));
+            uint32_t len2=0;
+            uint32_t ret=0;
+            while(len2<len1 && (ret=opcContainerReadInputStream(stream2, buf2+len2, len1-len2))>0) {
+                len2+=ret;
+            }
+            if (len1!=len2 || 0!=memcmp(buf1, buf2, len1)) {
+                err=OPC_ERROR_STREAM;
+            }
+        } while(OPC_ERROR_NONE==err && len1>0);
+        if (OPC_ERROR_NONE==err && 0!=opcContainerReadInputStream(stream2, buf2, sizeof(buf2))) {
+            err=OPC_ERROR_STREAM; // the second part is longer
+        }
+    }
+    if (NULL!=stream1) opcContainerCloseInputStream(stream1);
+    if (NULL!=stream2) opcContainerCloseInputStream(stream2);
+    return err;
+}
+
+/*
+    Deflates the same content with one and with four threads. The parallel output is a different deflate stream, but
+    it must inflate to exactly the same bytes. The sizes hit the block boundaries of the parallel deflate jobs.
+*/
+static opc_error_t parallelTest(const char *filename) {
+    opc_ofs_t const size_array[]={ 0, 1000, OPC_PARALLEL_DEFLATE_BLOCK_SIZE-1, OPC_PARALLEL_DEFLATE_BLOCK_SIZE, 
+        4*OPC_PARALLEL_DEFLATE_BLOCK_SIZE, 4*OPC_PARALLEL_DEFLATE_BLOCK_SIZE+1, 3300000 };
+    uint32_t const size_items=sizeof(size_array)/sizeof(size_array[0]);
+    char name1[OPC_MAX_PATH];
+    char name2[OPC_MAX_PATH];
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_WRITE_ONLY, NULL, NULL);
+    if (NULL!=c) {
+        err=OPC_ERROR_NONE;
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<size_items;i++) {
+            snprintf(name1, sizeof(name1), "data/single%u.bin", i);
+            snprintf(name2, sizeof(name2), "data/parallel%u.bin", i);
+            err=writePartEx(c, name1, size_array[i], OPC_COMPRESSIONOPTION_NORMAL, 1);
+            if (OPC_ERROR_NONE==err) {
+                err=writePartEx(c, name2, size_array[i], OPC_COMPRESSIONOPTION_NORMAL, 4);
+            }
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        for(uint32_t i=0;i<size_items;i++) {
+            snprintf(name1, sizeof(name1), "data/single%u.bin", i);
+            snprintf(name2, sizeof(name2), "data/parallel%u.bin", i);
+            opc_error_t part_err=compareParts(c, name1, name2);
+            if (OPC_ERROR_NONE==part_err) {
+                part_err=verifyPart(c, name2, size_array[i]);
+            }
+            printf("%s %" PRIu64 "...%s\n", name2, (uint64_t)size_array[i], (OPC_ERROR_NONE==part_err?"ok":"failure"));
+            if (OPC_ERROR_NONE==err) err=part_err;
+        }
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+static const char *errorName(opc_error_t err) {
+    return (OPC_ERROR_NONE==err?"OPC_ERROR_NONE":(OPC_ERROR_CRC==err?"OPC_ERROR_CRC":"unexpected error"));
+}
+
+// Reads the whole part and returns the error reported on closing the stream.
+static opc_error_t readPart(opcContainer *c, const char *name) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainerInputStream *stream=opcContainerOpenInputStream(c, BAD_CAST(name));
+    if (NULL!=stream) {
+        static uint8_t buf[BUFFER_SIZE];
+        while(opcContainerReadInputStream(stream, buf, sizeof(buf))>0);
+        err=opcContainerCloseInputStream(stream);
+    }
+    return err;
+}
+
+static opc_error_t ignoreData(void *userctx, opcPart part, const uint8_t *data, uint32_t data_len, bool last) {
+    (void)userctx; (void)part; (void)data; (void)data_len; (void)last;
+    return OPC_ERROR_NONE;
+}
+
+// Changes the first byte behind the first occurrence of the 16 byte marker in the file.
+static bool corruptFile(const char *filename, const char *marker) {
+    bool ret=false;
+    FILE *f=fopen(filename, "r+b");
+    if (NULL!=f) {
+        static uint8_t buf[BUFFER_SIZE];
+        size_t const len=fread(buf, 1, sizeof(buf), f);
+        for(size_t i=0;!ret && i+16<len;i++) {
+            if (0==memcmp(buf+i, marker, 16)) {
+                buf[i+16]^=0x20; // lower to upper case
+                ret=(0==fseek(f, (long)(i+16), SEEK_SET) && 1==fwrite(buf+i+16, 1, 1, f));
+            }
+        }
+        ret=(0==fclose(f) && ret);
+    }
+    return ret;
+}
+
+/*
+    Flips one byte of a stored part in the file. The part can still be read, but with OPC_OPEN_VERIFY_CRC closing its
+    stream resp. extracting it must fail with OPC_ERROR_CRC. The intact part must still be fine.
+*/
+static opc_error_t crcTest(const char *filename) {
+    static const struct { const char *name; opcContainerOpenMode mode; } modes[]={
+        { "read", OPC_OPEN_READ_ONLY },
+        { "verified read", OPC_OPEN_VERIFY_CRC },
+        { "verified mapped read", (opcContainerOpenMode)(OPC_OPEN_VERIFY_CRC|OPC_OPEN_MMAP) }
+    };
+    static const char *parts[]={ "data/intact.bin", "data/corrupt.bin" };
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_WRITE_ONLY, NULL, NULL);
+    if (NULL!=c) {
+        err=writePart(c, parts[0], 1000, OPC_COMPRESSIONOPTION_NONE);
+        if (OPC_ERROR_NONE==err) {
+            err=writePart(c, parts[1], 10000, OPC_COMPRESSIONOPTION_NONE); // line 100 is only in here
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    if (OPC_ERROR_NONE==err && !corruptFile(filename, "0000000000000064")) {
+        err=OPC_ERROR_STREAM;
+    }
+    report("write and corrupt", err);
+    for(uint32_t i=0;OPC_ERROR_NONE==err && i<sizeof(modes)/sizeof(modes[0]);i++) {
+        if (NULL!=(c=opcContainerOpen(BAD_CAST(filename), modes[i].mode, NULL, NULL))) {
+            opc_error_t const expected=(OPC_OPEN_READ_ONLY==modes[i].mode?OPC_ERROR_NONE:OPC_ERROR_CRC);
+            opc_error_t const intact_err=readPart(c, parts[0]);
+            opc_error_t const corrupt_err=readPart(c, parts[1]);
+            opcPart part=opcPartFind(c, BAD_CAST(parts[1]), NULL, 0);
+            opc_error_t const extract_err=opcContainerExtractParts(c, &part, 1, ignoreData, NULL, 1);
+            printf("%s: %s %s, %s %s, extract %s\n", modes[i].name, 
+                   parts[0], errorName(intact_err), parts[1], errorName(corrupt_err), errorName(extract_err));
+            if (OPC_ERROR_NONE!=intact_err || expected!=corrupt_err || expected!=extract_err) {
+                err=OPC_ERROR_STREAM;
+            }
+            opcContainerClose(c, OPC_CLOSE_NOW);
+        } else {
+            err=OPC_ERROR_STREAM;
+        }
+    }
+    return err;
+}
+
+typedef struct {
+    const opcPart *parts;
+    uint32_t part_items;
+    uint32_t *crc_array;
+    opc_ofs_t *size_array;
+    uint32_t *last_array; // number of calls with last set
+    opcPart abort_part; // OPC_ERROR_USER is returned for this part
+} extractContext;
+
+// Called by several threads at once, but all calls for one part are made by the same thread.
+static opc_error_t extractData(void *userctx, opcPart part, const uint8_t *data, uint32_t data_len, bool last) {
+    extractContext *ctx=(extractContext *)userctx;
+    uint32_t i=0;
+    while(i<ctx->part_items && ctx->parts[i]!=part) i++;
+    if (i==ctx->part_items) {
+        return OPC_ERROR_STREAM;
+    } else if (part==ctx->abort_part) {
+        return OPC_ERROR_USER;
+    } else if (last) {
+        ctx->last_array[i]++;
+    } else {
+        ctx->crc_array[i]=opcHelperCrc32(ctx->crc_array[i], data, data_len);
+        ctx->size_array[i]+=data_len;
+    }
+    return OPC_ERROR_NONE;
+}
+
+/*
+    Extracts all parts of a copy of src with several threads and compares them with reading the parts one after the 
+    other. Then the extraction is aborted by the callback, which must be reported as OPC_ERROR_USER.
+    Unless mode is OPC_OPEN_READ_ONLY the container is modified first, so the parts are extracted while the part 
+    index still has to be rebuilt.
+*/
+static opc_error_t extractTest(const char *filename, const char *src, opcContainerOpenMode mode, uint32_t threads) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), mode, NULL, NULL):NULL);
+    if (NULL!=c && OPC_OPEN_READ_ONLY!=mode && OPC_ERROR_NONE!=modifyContainer(c)) {
+        report("modify", OPC_ERROR_STREAM);
+        opcContainerClose(c, OPC_CLOSE_NOW); c=NULL;
+    }
+    if (NULL!=c) {
+        extractContext ctx;
+        memset(&ctx, 0, sizeof(ctx));
+        for(opcPart part=opcPartGetFirst(c);OPC_PART_INVALID!=part;part=opcPartGetNext(c, part)) {
+            ctx.part_items++;
+        }
+        opcPart *parts=(opcPart *)calloc(ctx.part_items, sizeof(opcPart));
+        ctx.parts=parts;
+        ctx.crc_array=(uint32_t *)calloc(ctx.part_items, sizeof(uint32_t));
+        ctx.size_array=(opc_ofs_t *)calloc(ctx.part_items, sizeof(opc_ofs_t));
+        ctx.last_array=(uint32_t *)calloc(ctx.part_items, sizeof(uint32_t));
+        if (NULL!=parts && NULL!=ctx.crc_array && NULL!=ctx.size_array && NULL!=ctx.last_array) {
+            uint32_t i=0;
+            for(opcPart part=opcPartGetFirst(c);OPC_PART_INVALID!=part;part=opcPartGetNext(c, part)) {
+                parts[i++]=part;
+            }
+            err=opcContainerExtractParts(c, parts, ctx.part_items, extractData, &ctx, threads);
+            report("extract", err);
+            for(i=0;OPC_ERROR_NONE==err && i<ctx.part_items;i++) {
+                uint32_t crc=0;
+                opc_ofs_t size=0;
+                opcContainerInputStream *stream=opcContainerOpenInputStream(c, parts[i]);
+                if (NULL!=stream) {
+                    static uint8_t buf[BUFFER_SIZE];
+                    uint32_t len=0;
+                    while((len=opcContainerReadInputStream(stream, buf, sizeof(buf)))>0) {
+                        crc=opcHelperCrc32(crc, buf, len);
+                        size+=len;
+                    }
+                    opcContainerCloseInputStream(stream);
+                }
+                opc_error_t const part_err=(NULL!=stream && crc==ctx.crc_array[i] && size==ctx.size_array[i] && 1==ctx.last_array[i]?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+                printf("%s %" PRIu64 "...%s\n", parts[i], (uint64_t)size, (OPC_ERROR_NONE==part_err?"ok":"failure"));
+                if (OPC_ERROR_NONE==err) err=part_err;
+            }
+            if (OPC_ERROR_NONE==err) {
+                ctx.abort_part=parts[ctx.part_items/2];
+                err=(OPC_ERROR_USER==opcContainerExtractParts(c, parts, ctx.part_items, extractData, &ctx, threads)?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+                report("abort", err);
+            }
+        }
+        free(parts);
+        free(ctx.crc_array);
+        free(ctx.size_array);
+        free(ctx.last_array);
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    }
+    return err;
+}
+
+// Runs worker once for every item of the array, each in its own thread if threads are available.
+static void runThreads(void *(*worker)(void *), void *array, size_t item_size, uint32_t items) {
+#ifdef OPC_HAVE_PTHREAD
+    pthread_t threads[16];
+    uint32_t started=0;
+    while(started<items && started<sizeof(threads)/sizeof(threads[0]) && 0==pthread_create(&threads[started], NULL, worker, (uint8_t*)array+started*item_size)) {
+        started++;
+    }
+    for(uint32_t i=started;i<items;i++) {
+        worker((uint8_t*)array+i*item_size);
+    }
+    for(uint32_t i=0;i<started;i++) {
+        pthread_join(threads[i], NULL);
+    }
+#else
+    for(uint32_t i=0;i<items;i++) {
+        worker((uint8_t*)array+i*item_size);
+    }
+#endif
+}
+
+typedef struct {
+    const char *name;
+    opcCompressionOption_t option;
+    opc_ofs_t size;
+    opcContainerOutputStream *stream;
+    opc_error_t err;
+} detachedPart;
+
+// Writes the generated content of one detached stream, in odd sized chunks so the writes of the threads interleave.
+static void *detachedWorker(void *arg) {
+    detachedPart *part=(detachedPart *)arg;
+    uint8_t *buf=(uint8_t *)malloc(7001);
+    part->err=(NULL!=buf?OPC_ERROR_NONE:OPC_ERROR_MEMORY);
+    for(opc_ofs_t ofs=0;OPC_ERROR_NONE==part->err && ofs<part->size;) {
+        uint32_t const len=(part->size-ofs<7001?(uint32_t)(part->size-ofs):7001);
+        generate(buf, ofs, len);
+        if (len!=opcContainerWriteOutputStream(part->stream, buf, len)) {
+            part->err=OPC_ERROR_STREAM;
+        }
+        ofs+=len;
+    }
+    free(buf);
+    return NULL;
+}
+
+/*
+    Writes several detached streams of a copy of src at the same time, one thread per stream. The first one replaces
+    an existing part. The streams are closed in reverse order, so the parts are appended in a different order than the
+    streams were created.
+*/
+static opc_error_t detachedTest(const char *filename, const char *src) {
+    detachedPart parts[]={
+        { "docProps/app.xml", OPC_COMPRESSIONOPTION_NORMAL, 3000, NULL, OPC_ERROR_NONE }, // replaced
+        { "data/detached1.bin", OPC_COMPRESSIONOPTION_NORMAL, 300000, NULL, OPC_ERROR_NONE },
+        { "data/detached2.bin", OPC_COMPRESSIONOPTION_NONE, 70000, NULL, OPC_ERROR_NONE },
+        { "data/detached3.bin", OPC_COMPRESSIONOPTION_SUPERFAST, 0, NULL, OPC_ERROR_NONE }
+    };
+    uint32_t const part_items=sizeof(parts)/sizeof(parts[0]);
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_WRITE, NULL, NULL):NULL);
+    if (NULL!=c) {
+        err=OPC_ERROR_NONE;
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<part_items;i++) {
+            if (OPC_PART_INVALID==opcPartFind(c, BAD_CAST(parts[i].name), NULL, 0)
+             && OPC_PART_INVALID==opcPartCreate(c, BAD_CAST(parts[i].name), BAD_CAST("application/octet-stream"), 0)) {
+                err=OPC_ERROR_STREAM;
+            } else if (NULL==(parts[i].stream=opcContainerCreateDetachedOutputStream(c, BAD_CAST(parts[i].name), parts[i].option))) {
+                err=OPC_ERROR_STREAM;
+            }
+        }
+        if (OPC_ERROR_NONE==err) {
+            runThreads(detachedWorker, parts, sizeof(parts[0]), part_items);
+        }
+        for(uint32_t i=part_items;i>0;i--) {
+            if (NULL!=parts[i-1].stream) {
+                opc_error_t const close_err=opcContainerCloseOutputStream(parts[i-1].stream);
+                if (OPC_ERROR_NONE==err) err=parts[i-1].err;
+                if (OPC_ERROR_NONE==err) err=close_err;
+            }
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        for(uint32_t i=0;i<part_items;i++) {
+            opc_error_t const part_err=verifyPart(c, parts[i].name, parts[i].size);
+            printf("%s %" PRIu64 "...%s\n", parts[i].name, (uint64_t)parts[i].size, (OPC_ERROR_NONE==part_err?"ok":"failure"));
+            if (OPC_ERROR_NONE==err) err=part_err;
+        }
+        opc_error_t const part_err=readPart(c, "word/document.xml");
+        report("unchanged part", part_err);
+        if (OPC_ERROR_NONE==err) err=part_err;
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+// CRC of the relation ids, types and targets of part, or of the root relations if part is OPC_PART_INVALID.
+static uint32_t relationCrc(opcContainer *c, opcPart part) {
+    uint32_t crc=0;
+    for(opcRelation rel=opcRelationFirst(c, part);OPC_RELATION_INVALID!=rel;rel=opcRelationNext(c, part, rel)) {
+        const xmlChar *prefix=NULL;
+        uint32_t counter=0;
+        const xmlChar *type=NULL;
+        opcRelationGetInformation(c, part, rel, &prefix, &counter, &type);
+        opcPart const internal_target=opcRelationGetInternalTarget(c, part, rel);
+        const xmlChar *target=(OPC_PART_INVALID!=internal_target?internal_target:opcRelationGetExternalTarget(c, part, rel));
+        crc=opcHelperCrc32(crc, prefix, (uint32_t)xmlStrlen(prefix));
+        crc=opcHelperCrc32(crc, (const uint8_t *)&counter, sizeof(counter));
+        crc=opcHelperCrc32(crc, type, (uint32_t)xmlStrlen(type));
+        crc=opcHelperCrc32(crc, target, (uint32_t)xmlStrlen(target));
+    }
+    return crc;
+}
+
+typedef struct {
+    opcPart part; // of the reference container
+    uint32_t crc;
+    opc_ofs_t size;
+    uint32_t relation_crc;
+} threadSafePart;
+
+typedef struct {
+    opcContainer *c;
+    const threadSafePart *parts;
+    uint32_t part_items;
+    uint32_t root_crc;
+    uint32_t first; // each thread starts at a different part
+    uint32_t rounds;
+    uint32_t errors;
+} threadSafeContext;
+
+// Looks up every part, reads its relations and its content, and compares them with the reference.
+static void *threadSafeWorker(void *arg) {
+    threadSafeContext *ctx=(threadSafeContext *)arg;
+    uint8_t *buf=(uint8_t *)malloc(BUFFER_SIZE);
+    if (NULL==buf) ctx->errors++;
+    for(uint32_t r=0;NULL!=buf && r<ctx->rounds;r++) {
+        if (relationCrc(ctx->c, OPC_PART_INVALID)!=ctx->root_crc) ctx->errors++;
+        for(uint32_t j=0;j<ctx->part_items;j++) {
+            const threadSafePart *ref=&ctx->parts[(ctx->first+j)%ctx->part_items];
+            opcPart const part=opcPartFind(ctx->c, ref->part, NULL, 0);
+            uint32_t crc=0;
+            opc_ofs_t size=0;
+            opcContainerInputStream *stream=(OPC_PART_INVALID!=part && NULL!=opcPartGetType(ctx->c, part)?opcContainerOpenInputStream(ctx->c, part):NULL);
+            if (NULL!=stream) {
+                uint32_t len=0;
+                while((len=opcContainerReadInputStream(stream, buf, BUFFER_SIZE))>0) {
+                    crc=opcHelperCrc32(crc, buf, len);
+                    size+=len;
+                }
+                if (OPC_ERROR_NONE!=opcContainerCloseInputStream(stream)) stream=NULL;
+            }
+            if (NULL==stream || crc!=ref->crc || size!=ref->size || relationCrc(ctx->c, part)!=ref->relation_crc) {
+                ctx->errors++;
+            }
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+/*
+    Opens a copy of src with OPC_OPEN_THREAD_SAFE and looks up the parts, reads their relations and their content from 
+    several threads at the same time. The results must match those of a container read by a single thread.
+*/
+static opc_error_t threadSafeTest(const char *filename, const char *src, opcContainerOpenMode mode, uint32_t threads) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *ref=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL):NULL);
+    if (NULL!=ref) {
+        uint32_t part_items=0;
+        for(opcPart part=opcPartGetFirst(ref);OPC_PART_INVALID!=part;part=opcPartGetNext(ref, part)) {
+            part_items++;
+        }
+        threadSafePart *parts=(threadSafePart *)calloc(part_items, sizeof(threadSafePart));
+        threadSafeContext *ctx_array=(threadSafeContext *)calloc(threads, sizeof(threadSafeContext));
+        if (NULL!=parts && NULL!=ctx_array) {
+            uint32_t i=0;
+            err=OPC_ERROR_NONE;
+            for(opcPart part=opcPartGetFirst(ref);OPC_ERROR_NONE==err && OPC_PART_INVALID!=part;part=opcPartGetNext(ref, part), i++) {
+                static uint8_t buf[BUFFER_SIZE];
+                opcContainerInputStream *stream=opcContainerOpenInputStream(ref, part);
+                uint32_t len=0;
+                parts[i].part=part;
+                parts[i].relation_crc=relationCrc(ref, part);
+                while(NULL!=stream && (len=opcContainerReadInputStream(stream, buf, sizeof(buf)))>0) {
+                    parts[i].crc=opcHelperCrc32(parts[i].crc, buf, len);
+                    parts[i].size+=len;
+                }
+                if (NULL==stream || OPC_ERROR_NONE!=opcContainerCloseInputStream(stream)) err=OPC_ERROR_STREAM;
+            }
+            report("reference", err);
+            opcContainer *c=(OPC_ERROR_NONE==err?opcContainerOpen(BAD_CAST(filename), mode, NULL, NULL):NULL);
+            if (NULL!=c) {
+                for(i=0;i<threads;i++) {
+                    ctx_array[i].c=c;
+                    ctx_array[i].parts=parts;
+                    ctx_array[i].part_items=part_items;
+                    ctx_array[i].root_crc=relationCrc(ref, OPC_PART_INVALID);
+                    ctx_array[i].first=i*part_items/threads;
+                    ctx_array[i].rounds=20;
+                }
+                runThreads(threadSafeWorker, ctx_array, sizeof(ctx_array[0]), threads);
+                for(i=0;i<threads;i++) {
+                    if (0!=ctx_array[i].errors) err=OPC_ERROR_STREAM;
+                }
+                opcContainerClose(c, OPC_CLOSE_NOW);
+            } else {
+                err=OPC_ERROR_STREAM;
+            }
+            printf("%u parts, %u threads\n", part_items, threads);
+            report("concurrent reads", err);
+        }
+        free(parts);
+        free(ctx_array);
+        opcContainerClose(ref, OPC_CLOSE_NOW);
+    }
+    return err;
+}
+
+/*
+    Counts the allocations of a container. Every block starts with a header holding its size and a magic number, so 
+    blocks which were not allocated by the allocator are detected when they are released.
+*/
+typedef struct {
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t foreign_frees;
+    size_t live_bytes;
+} countingContext;
+
+typedef union {
+    struct {
+        size_t size;
+        uint32_t magic;
+    } h;
+    double align;
+    void *align_ptr;
+} countingHeader;
+
+#define COUNTING_MAGIC 0x0bc4a11c
+
+static void *countingMalloc(void *ctx, size_t size) {
+    countingContext *counter=(countingContext *)ctx;
+    countingHeader *header=(countingHeader *)malloc(sizeof(countingHeader)+size);
+    if (NULL==header) return NULL;
+    header->h.size=size;
+    header->h.magic=COUNTING_MAGIC;
+    counter->allocs++;
+    counter->live_bytes+=size;
+    return header+1;
+}
+
+static void countingFree(void *ctx, void *ptr) {
+    countingContext *counter=(countingContext *)ctx;
+    if (NULL!=ptr) {
+        countingHeader *header=(countingHeader *)ptr-1;
+        if (COUNTING_MAGIC!=header->h.magic) {
+            counter->foreign_frees++; // leaked rather than crashing on a block of another allocator
+        } else {
+            header->h.magic=0;
+            counter->frees++;
+            counter->live_bytes-=header->h.size;
+            free(header);
+        }
+    }
+}
+
+static void *countingRealloc(void *ctx, void *ptr, size_t size) {
+    if (NULL==ptr) return countingMalloc(ctx, size);
+    countingHeader *header=(countingHeader *)ptr-1;
+    void *ret=countingMalloc(ctx, size);
+    if (NULL!=ret) {
+        memcpy(ret, ptr, (header->h.size<size?header->h.size:size));
+        countingFree(ctx, ptr);
+    }
+    return ret;
+}
+
+// The allocations made while the part is read.
+static uint32_t countingReadPart(opcContainer *c, countingContext *counter, const char *name) {
+    uint32_t const allocs=counter->allocs;
+    return (OPC_ERROR_NONE==readPart(c, name)?counter->allocs-allocs:0);
+}
+
+// The allocations made while the part is written.
+static uint32_t countingWritePart(opcContainer *c, countingContext *counter, const char *name, opcCompressionOption_t option) {
+    uint32_t const allocs=counter->allocs;
+    return (OPC_ERROR_NONE==writePart(c, name, 20000, option)?counter->allocs-allocs:0);
+}
+
+/*
+    Opens a copy of src in different ways with a counting allocator. The part and zip index must be allocated by the 
+    allocator, which opcContainerLoadFromZip has to pass on to the io again after opening the file. Deflating and 
+    inflating a part has to allocate more than storing it, i.e. zlib must allocate its state with the allocator as well.
+    Finally everything must be released when the container is closed.
+*/
+static opc_error_t allocatorTest(const char *filename, const char *src) {
+    static const struct { const char *name; opcContainerOpenMode mode; bool mem; } variants[]={
+        { "file", OPC_OPEN_READ_ONLY, false },
+        { "mmap", OPC_OPEN_MMAP, false },
+        { "memory", OPC_OPEN_READ_ONLY, true },
+        { "read-write", OPC_OPEN_READ_WRITE, false },
+        { "transition", OPC_OPEN_TRANSITION, false }
+    };
+    opc_error_t err=OPC_ERROR_NONE;
+    for(uint32_t i=0;i<sizeof(variants)/sizeof(variants[0]);i++) {
+        countingContext counter;
+        memset(&counter, 0, sizeof(counter));
+        opcAllocator const allocator={ countingMalloc, countingRealloc, countingFree, &counter };
+        uint8_t *data=NULL;
+        size_t data_len=0;
+        opcContainer *c=NULL;
+        if (!copyFile(src, filename)) {
+        } else if (!variants[i].mem) {
+            c=opcContainerOpenEx(BAD_CAST(filename), variants[i].mode, NULL, NULL, &allocator);
+        } else if (NULL!=(data=readFile(filename, &data_len))) {
+            c=opcContainerOpenMemEx(data, data_len, variants[i].mode, NULL, &allocator);
+        }
+        opc_error_t index_err=OPC_ERROR_STREAM;
+        opc_error_t zlib_err=OPC_ERROR_STREAM;
+        if (NULL!=c) {
+            uint32_t parts=0;
+            for(opcPart part=opcPartGetFirst(c);OPC_PART_INVALID!=part;part=opcPartGetNext(c, part)) {
+                parts++;
+            }
+            index_err=(counter.allocs>parts?OPC_ERROR_NONE:OPC_ERROR_STREAM); // at least the names of the zip index
+            uint32_t const stored_read=countingReadPart(c, &counter, "word/media/image4.png");
+            uint32_t const deflated_read=countingReadPart(c, &counter, "word/document.xml");
+            zlib_err=(stored_read>0 && deflated_read>stored_read+1 /* the z_stream of libopc */?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+            if (OPC_OPEN_READ_ONLY!=(variants[i].mode & ~OPC_OPEN_MMAP)) {
+                uint32_t const stored_write=countingWritePart(c, &counter, "data/stored.bin", OPC_COMPRESSIONOPTION_NONE);
+                uint32_t const deflated_write=countingWritePart(c, &counter, "data/deflated.bin", OPC_COMPRESSIONOPTION_NORMAL);
+                if (!(stored_write>0 && deflated_write>stored_write+1)) zlib_err=OPC_ERROR_STREAM;
+            }
+            opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+            if (OPC_ERROR_NONE==zlib_err) zlib_err=close_err;
+        }
+        free(data);
+        opc_error_t const free_err=(counter.allocs==counter.frees && 0==counter.foreign_frees && 0==counter.live_bytes?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+        printf("%s:\n", variants[i].name);
+        report("index", index_err);
+        report("zlib", zlib_err);
+        report("released", free_err);
+        if (OPC_ERROR_NONE==err) err=(OPC_ERROR_NONE!=index_err?index_err:(OPC_ERROR_NONE!=zlib_err?zlib_err:free_err));
+    }
+    return err;
+}
+
+static const xmlChar *relationType(opcContainer *c, opcPart part, opcRelation rel) {
+    const xmlChar *type=NULL;
+    opcRelationGetInformation(c, part, rel, NULL, NULL, &type);
+    return type;
+}
+
+#define IMAGE_RELATION "http://schemas.openxmlformats.org/officeDocument/2006/relationships/image"
+#define TEST_RELATION "http://libopc.codeplex.com/relationships/test"
+
+/*
+    Compares the relations of part of each type found by opcRelationFirstOfType/opcRelationNextOfType with those found
+    by scanning all relations. Also checks the number of image and test relations.
+*/
+static opc_error_t checkRelationTypes(opcContainer *c, opcPart part, const char *label, uint32_t images, uint32_t tests) {
+    opc_error_t err=OPC_ERROR_NONE;
+    uint32_t relations=0;
+    uint32_t found[2]={ 0, 0 };
+    for(opcRelation rel=opcRelationFirst(c, part);OPC_RELATION_INVALID!=rel;rel=opcRelationNext(c, part, rel)) {
+        const xmlChar *type=relationType(c, part, rel);
+        relations++;
+        // the relations of this type must be found in the same order by both
+        opcRelation by_type=opcRelationFirstOfType(c, part, type);
+        opcRelation scan=opcRelationFirst(c, part);
+        while(OPC_RELATION_INVALID!=scan && !xmlStrEqual(type, relationType(c, part, scan))) scan=opcRelationNext(c, part, scan);
+        while(OPC_RELATION_INVALID!=by_type && by_type==scan) {
+            by_type=opcRelationNextOfType(c, part, by_type);
+            do { scan=opcRelationNext(c, part, scan); } while(OPC_RELATION_INVALID!=scan && !xmlStrEqual(type, relationType(c, part, scan)));
+        }
+        if (by_type!=scan) err=OPC_ERROR_STREAM;
+    }
+    for(uint32_t i=0;i<2;i++) {
+        for(opcRelation rel=opcRelationFirstOfType(c, part, BAD_CAST(0==i?IMAGE_RELATION:TEST_RELATION));OPC_RELATION_INVALID!=rel;rel=opcRelationNextOfType(c, part, rel)) {
+            found[i]++;
+        }
+    }
+    if (found[0]!=images || found[1]!=tests) err=OPC_ERROR_STREAM;
+    printf("%s: %u relations, %u images, %u tests...%s\n", label, relations, found[0], found[1], (OPC_ERROR_NONE==err?"ok":"failure"));
+    return err;
+}
+
+/*
+    Adds and deletes relations of a copy of src after the type index of the part was built, so it has to be rebuilt.
+    Replacing a relation keeps the number of relations, so only the relation generation tells the index is stale.
+*/
+static opc_error_t relationTypeTest(const char *filename, const char *src) {
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_WRITE, NULL, NULL):NULL);
+    if (NULL!=c) {
+        opcPart const doc=opcPartFind(c, BAD_CAST("word/document.xml"), NULL, 0);
+        opcPart const image=opcPartFind(c, BAD_CAST("word/media/image4.png"), NULL, 0);
+        opcPart const app=opcPartFind(c, BAD_CAST("docProps/app.xml"), NULL, 0);
+        err=checkRelationTypes(c, doc, "loaded", 4, 0);
+        if (OPC_ERROR_NONE==err) {
+            opcRelationAdd(c, doc, BAD_CAST("rId40"), image, BAD_CAST(IMAGE_RELATION));
+            opcRelationAdd(c, doc, BAD_CAST("rId41"), app, BAD_CAST(TEST_RELATION));
+            err=checkRelationTypes(c, doc, "added", 5, 1);
+        }
+        if (OPC_ERROR_NONE==err) {
+            err=opcRelationDelete(c, doc, BAD_CAST("rId15"), NULL);
+            if (OPC_ERROR_NONE==err) err=checkRelationTypes(c, doc, "deleted", 4, 1);
+        }
+        if (OPC_ERROR_NONE==err) {
+            err=opcRelationDelete(c, doc, BAD_CAST("rId16"), NULL);
+            opcRelationAdd(c, doc, BAD_CAST("rId42"), app, BAD_CAST(TEST_RELATION));
+            if (OPC_ERROR_NONE==err) err=checkRelationTypes(c, doc, "replaced", 3, 2);
+        }
+        if (OPC_ERROR_NONE==err) {
+            err=checkRelationTypes(c, OPC_PART_INVALID, "root loaded", 0, 0);
+            opcRelationAdd(c, OPC_PART_INVALID, BAD_CAST("rId4"), app, BAD_CAST(TEST_RELATION));
+            if (OPC_ERROR_NONE==err) err=checkRelationTypes(c, OPC_PART_INVALID, "root added", 0, 1);
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        err=checkRelationTypes(c, opcPartFind(c, BAD_CAST("word/document.xml"), NULL, 0), "read", 3, 2);
+        if (OPC_ERROR_NONE==err) err=checkRelationTypes(c, OPC_PART_INVALID, "root read", 0, 1);
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+// The number of relations targeting part, found by scanning the relations of the root and of all parts.
+static uint32_t scanIncoming(opcContainer *c, opcPart part) {
+    uint32_t ret=0;
+    opcPart source=OPC_PART_INVALID;
+    do {
+        for(opcRelation rel=opcRelationFirst(c, source);OPC_RELATION_INVALID!=rel;rel=opcRelationNext(c, source, rel)) {
+            if (xmlStrEqual(part, opcRelationGetInternalTarget(c, source, rel))) ret++;
+        }
+        source=(OPC_PART_INVALID==source?opcPartGetFirst(c):opcPartGetNext(c, source));
+    } while(OPC_PART_INVALID!=source);
+    return ret;
+}
+
+typedef struct {
+    opcPart source;
+    opcRelation rel;
+} incomingRelation;
+
+// Checks that rel from source targets part and has not been visited yet.
+static bool visitIncoming(opcContainer *c, opcPart part, opcPart source, opcRelation rel, incomingRelation *visited, uint32_t *visited_items, uint32_t visited_max) {
+    for(uint32_t i=0;i<*visited_items;i++) {
+        if (visited[i].rel==rel && xmlStrEqual(visited[i].source, source)) return false;
+    }
+    if (*visited_items>=visited_max || !xmlStrEqual(part, opcRelationGetInternalTarget(c, source, rel))) return false;
+    visited[*visited_items].source=source;
+    visited[*visited_items].rel=rel;
+    (*visited_items)++;
+    return true;
+}
+
+static opc_error_t checkIncoming(opcContainer *c, opcPart part, const char *label, uint32_t expected) {
+    incomingRelation visited[64];
+    uint32_t visited_items=0;
+    opc_error_t err=OPC_ERROR_NONE;
+    opcPart source=OPC_PART_INVALID;
+    for(opcRelation rel=opcRelationFirstIncoming(c, part, &source);OPC_ERROR_NONE==err && OPC_RELATION_INVALID!=rel;rel=opcRelationNextIncoming(c, part, &source, rel)) {
+        if (!visitIncoming(c, part, source, rel, visited, &visited_items, sizeof(visited)/sizeof(visited[0]))) err=OPC_ERROR_STREAM;
+    }
+    if (visited_items!=expected || scanIncoming(c, part)!=expected) err=OPC_ERROR_STREAM;
+    printf("%s: %u incoming...%s\n", label, visited_items, (OPC_ERROR_NONE==err?"ok":"failure"));
+    return err;
+}
+
+/*
+    Adds relations from the root and from all headers and footers of a copy of src to an image, then deletes some of
+    them and a part referencing the image. The deleted entries are only marked, so the iterator has to skip them.
+    Finally word/document.xml is deleted while the incoming relations of the image are iterated. This deletes more 
+    than half of all entries, so they are compacted, and the iteration has to continue after the current relation.
+*/
+static opc_error_t incomingTest(const char *filename, const char *src) {
+    static const char *sources[]={ "word/header1.xml", "word/header2.xml", "word/header3.xml", "word/header4.xml", 
+        "word/header5.xml", "word/footer1.xml", "word/footer2.xml", "word/footer3.xml" };
+    uint32_t const source_items=sizeof(sources)/sizeof(sources[0]);
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_WRITE, NULL, NULL):NULL);
+    if (NULL!=c) {
+        opcPart const image=opcPartFind(c, BAD_CAST("word/media/image4.png"), NULL, 0);
+        err=checkIncoming(c, image, "loaded", 1);
+        for(uint32_t i=0;i<source_items;i++) {
+            opcRelationAdd(c, opcPartFind(c, BAD_CAST(sources[i]), NULL, 0), BAD_CAST("rId50"), image, BAD_CAST(IMAGE_RELATION));
+        }
+        opcRelationAdd(c, OPC_PART_INVALID, BAD_CAST("rId50"), image, BAD_CAST(IMAGE_RELATION));
+        if (OPC_ERROR_NONE==err) err=checkIncoming(c, image, "added", 10);
+        if (OPC_ERROR_NONE==err) err=opcRelationDelete(c, opcPartFind(c, BAD_CAST("word/footer1.xml"), NULL, 0), BAD_CAST("rId50"), NULL);
+        if (OPC_ERROR_NONE==err) err=opcPartDelete(c, BAD_CAST("word/header2.xml"));
+        if (OPC_ERROR_NONE==err) err=checkIncoming(c, image, "deleted", 8);
+        if (OPC_ERROR_NONE==err) {
+            incomingRelation visited[64];
+            uint32_t visited_items=0;
+            bool deleted=false;
+            bool document_visited=false;
+            opcPart source=OPC_PART_INVALID;
+            for(opcRelation rel=opcRelationFirstIncoming(c, image, &source);OPC_ERROR_NONE==err && OPC_RELATION_INVALID!=rel;rel=opcRelationNextIncoming(c, image, &source, rel)) {
+                if (!visitIncoming(c, image, source, rel, visited, &visited_items, sizeof(visited)/sizeof(visited[0]))) err=OPC_ERROR_STREAM;
+                if (xmlStrEqual(source, BAD_CAST("word/document.xml"))) {
+                    document_visited=true;
+                } else if (!deleted && OPC_PART_INVALID!=source) {
+                    // the current source stays, the relations of word/document.xml are gone afterwards
+                    err=opcPartDelete(c, BAD_CAST("word/document.xml"));
+                    deleted=true;
+                }
+            }
+            if (!deleted || visited_items!=(document_visited?8:7)) err=OPC_ERROR_STREAM;
+            report("deleted while iterating", err);
+        }
+        if (OPC_ERROR_NONE==err) err=checkIncoming(c, image, "compacted", 7);
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        err=checkIncoming(c, opcPartFind(c, BAD_CAST("word/media/image4.png"), NULL, 0), "read", 7);
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+typedef struct {
+    opcContainer *c;
+    const char *label; // prints the visits unless NULL
+    bool read; // reads the visited parts
+    uint32_t stop; // stops after so many visits unless 0
+    opcPart part_array[64];
+    uint32_t part_items;
+    opc_error_t err;
+} traverseContext;
+
+static opc_error_t traverseVisit(void *userctx, opcPart source, opcRelation relation, opcPart part, uint32_t depth) {
+    traverseContext *ctx=(traverseContext *)userctx;
+    for(uint32_t i=0;i<ctx->part_items;i++) {
+        if (xmlStrEqual(ctx->part_array[i], part)) ctx->err=OPC_ERROR_STREAM; // visited twice
+    }
+    if (ctx->part_items<sizeof(ctx->part_array)/sizeof(ctx->part_array[0])) {
+        ctx->part_array[ctx->part_items++]=part;
+    } else {
+        ctx->err=OPC_ERROR_STREAM;
+    }
+    if (OPC_RELATION_INVALID!=relation && !xmlStrEqual(part, opcRelationGetInternalTarget(ctx->c, source, relation))) {
+        ctx->err=OPC_ERROR_STREAM;
+    }
+    if (ctx->read && OPC_ERROR_NONE!=readPart(ctx->c, (const char *)part)) {
+        ctx->err=OPC_ERROR_STREAM;
+    }
+    if (NULL!=ctx->label) {
+        printf("%s %u %s -> %s\n", ctx->label, depth, (OPC_PART_INVALID!=source?(const char *)source:"/"), part);
+    }
+    return (0!=ctx->stop && ctx->part_items==ctx->stop?OPC_ERROR_USER:OPC_ERROR_NONE);
+}
+
+/*
+    Adds relations to a copy of src so several parts reference the same image and the relations form cycles. Then the
+    reachable parts are visited breadth first and depth first. Every part must be visited once, and with 
+    OPC_TRAVERSE_PREFETCH the parts must be visited in the same order and still be readable.
+*/
+static opc_error_t traverseTest(const char *filename, const char *src) {
+    static const struct { const char *source; const char *target; } relations[]={
+        { "word/header1.xml", "word/media/image4.png" },
+        { "word/footer1.xml", "word/media/image4.png" },
+        { "word/footer1.xml", "word/header1.xml" },
+        { "word/header1.xml", "word/document.xml" },
+        { "word/media/image4.png", "word/footer2.xml" }
+    };
+    static const struct { const char *label; const char *start; uint32_t max_depth; int flags; } traversals[]={
+        { "bfs", NULL, 0, 0 },
+        { "dfs", NULL, 0, OPC_TRAVERSE_DEPTH_FIRST },
+        { "dfs-header1", "word/header1.xml", 0, OPC_TRAVERSE_DEPTH_FIRST },
+        { "bfs-depth2", NULL, 2, 0 }
+    };
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_WRITE, NULL, NULL):NULL);
+    if (NULL!=c) {
+        err=OPC_ERROR_NONE;
+        for(uint32_t i=0;i<sizeof(relations)/sizeof(relations[0]);i++) {
+            char rid[16];
+            snprintf(rid, sizeof(rid), "rId%u", 60+i);
+            opcRelationAdd(c, opcPartFind(c, BAD_CAST(relations[i].source), NULL, 0), BAD_CAST(rid), 
+                           opcPartFind(c, BAD_CAST(relations[i].target), NULL, 0), BAD_CAST(TEST_RELATION));
+        }
+        err=opcContainerClose(c, OPC_CLOSE_NOW);
+    }
+    report("write", err);
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        static traverseContext ctx;
+        static traverseContext prefetch_ctx;
+        static traverseContext bfs_ctx;
+        for(uint32_t i=0;OPC_ERROR_NONE==err && i<sizeof(traversals)/sizeof(traversals[0]);i++) {
+            opcPart const start=(NULL!=traversals[i].start?opcPartFind(c, BAD_CAST(traversals[i].start), NULL, 0):OPC_PART_INVALID);
+            memset(&ctx, 0, sizeof(ctx));
+            ctx.c=c;
+            ctx.label=traversals[i].label;
+            err=opcRelationTraverse(c, start, NULL, traversals[i].max_depth, traversals[i].flags, traverseVisit, &ctx);
+            if (OPC_ERROR_NONE==err) err=ctx.err;
+            memset(&prefetch_ctx, 0, sizeof(prefetch_ctx));
+            prefetch_ctx.c=c;
+            prefetch_ctx.read=true;
+            opc_error_t prefetch_err=opcRelationTraverse(c, start, NULL, traversals[i].max_depth, traversals[i].flags|OPC_TRAVERSE_PREFETCH, traverseVisit, &prefetch_ctx);
+            if (OPC_ERROR_NONE==prefetch_err) prefetch_err=prefetch_ctx.err;
+            if (OPC_ERROR_NONE==prefetch_err && (ctx.part_items!=prefetch_ctx.part_items || 0!=memcmp(ctx.part_array, prefetch_ctx.part_array, ctx.part_items*sizeof(opcPart)))) {
+                prefetch_err=OPC_ERROR_STREAM;
+            }
+            printf("%s: %u parts...%s, prefetch...%s\n", traversals[i].label, ctx.part_items, (OPC_ERROR_NONE==err?"ok":"failure"), (OPC_ERROR_NONE==prefetch_err?"ok":"failure"));
+            if (OPC_ERROR_NONE==err) err=prefetch_err;
+            if (0==i) {
+                bfs_ctx=ctx;
+            } else if (1==i && OPC_ERROR_NONE==err) { // the same parts in a different order
+                uint32_t found=0;
+                for(uint32_t j=0;j<ctx.part_items;j++) {
+                    uint32_t k=0;
+                    while(k<bfs_ctx.part_items && !xmlStrEqual(bfs_ctx.part_array[k], ctx.part_array[j])) k++;
+                    if (k<bfs_ctx.part_items) found++;
+                }
+                err=(found==bfs_ctx.part_items && found==ctx.part_items && 0!=memcmp(ctx.part_array, bfs_ctx.part_array, found*sizeof(opcPart))?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+                report("bfs and dfs visit the same parts", err);
+            }
+        }
+        if (OPC_ERROR_NONE==err) {
+            memset(&ctx, 0, sizeof(ctx));
+            ctx.c=c;
+            ctx.stop=3;
+            err=(OPC_ERROR_USER==opcRelationTraverse(c, OPC_PART_INVALID, NULL, 0, OPC_TRAVERSE_PREFETCH, traverseVisit, &ctx) && 3==ctx.part_items?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+            report("stop", err);
+        }
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+/*
+    A codec which passes everything on to the codec that was installed before and counts the calls. There is only one,
+    so the state returned by the inner codec is passed on unchanged.
+*/
+static struct {
+    const opcZipCodec *inner;
+    uint32_t inflate_init;
+    uint32_t inflate;
+    uint32_t inflate_end;
+    uint32_t deflate_init;
+    uint32_t deflate;
+    uint32_t deflate_end;
+} codecCounter;
+
+static void *countingInflateInit(void *codec_ctx, opc_ofs_t compressed_size, opc_ofs_t uncompressed_size) {
+    (void)codec_ctx; // the inner codec has its own context
+    codecCounter.inflate_init++;
+    return codecCounter.inner->inflate_init(codecCounter.inner->codec_ctx, compressed_size, uncompressed_size);
+}
+
+static opc_error_t countingInflate(void *state, const uint8_t **next_in, uint32_t *avail_in, uint8_t **next_out, uint32_t *avail_out, bool *eof) {
+    codecCounter.inflate++;
+    return codecCounter.inner->inflate(state, next_in, avail_in, next_out, avail_out, eof);
+}
+
+static opc_error_t countingInflateEnd(void *state) {
+    codecCounter.inflate_end++;
+    return codecCounter.inner->inflate_end(state);
+}
+
+static void *countingDeflateInit(void *codec_ctx, opcCompressionOption_t compression_option) {
+    (void)codec_ctx; // the inner codec has its own context
+    codecCounter.deflate_init++;
+    return codecCounter.inner->deflate_init(codecCounter.inner->codec_ctx, compression_option);
+}
+
+static opc_error_t countingDeflate(void *state, const uint8_t **next_in, uint32_t *avail_in, uint8_t **next_out, uint32_t *avail_out, bool finish, bool *eof) {
+    codecCounter.deflate++;
+    return codecCounter.inner->deflate(state, next_in, avail_in, next_out, avail_out, finish, eof);
+}
+
+static opc_error_t countingDeflateEnd(void *state) {
+    codecCounter.deflate_end++;
+    return codecCounter.inner->deflate_end(state);
+}
+
+/*
+    Installs the counting codec and opens a copy of src. Loading the content types and relations, reading and writing
+    parts must all go through the codec, even after the default codec has been reset, since every archive keeps the 
+    codec it was opened with. The written parts are read back with zlib.
+*/
+static opc_error_t codecTest(const char *filename, const char *src) {
+    static const opcZipCodec counting_codec={ countingInflateInit, countingInflate, countingInflateEnd, 
+        countingDeflateInit, countingDeflate, countingDeflateEnd, NULL };
+    opc_error_t err=OPC_ERROR_STREAM;
+    memset(&codecCounter, 0, sizeof(codecCounter));
+    codecCounter.inner=opcZipGetDefaultCodec();
+    opcZipSetDefaultCodec(&counting_codec);
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_WRITE, NULL, NULL):NULL);
+    opcZipSetDefaultCodec(NULL);
+    if (NULL!=c) {
+        err=(codecCounter.inflate_init>0 && codecCounter.inflate>0?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+        report("load", err);
+        if (OPC_ERROR_NONE==err) {
+            uint32_t const inflate=codecCounter.inflate;
+            err=readPart(c, "word/document.xml");
+            if (OPC_ERROR_NONE==err && codecCounter.inflate==inflate) err=OPC_ERROR_STREAM;
+            report("read", err);
+        }
+        if (OPC_ERROR_NONE==err) {
+            err=writePartEx(c, "data/deflated.bin", 300000, OPC_COMPRESSIONOPTION_NORMAL, 4); // custom codecs deflate sequentially
+            if (OPC_ERROR_NONE==err && (1!=codecCounter.deflate_init || 0==codecCounter.deflate || 1!=codecCounter.deflate_end)) err=OPC_ERROR_STREAM;
+            report("write", err);
+        }
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+        if (OPC_ERROR_NONE==err && codecCounter.inflate_init!=codecCounter.inflate_end) err=OPC_ERROR_STREAM;
+        report("close", err);
+    }
+    if (OPC_ERROR_NONE==err && NULL!=(c=opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_ONLY, NULL, NULL))) {
+        uint32_t const inflate_init=codecCounter.inflate_init;
+        err=verifyPart(c, "data/deflated.bin", 300000);
+        if (OPC_ERROR_NONE==err) err=readPart(c, "word/document.xml");
+        if (OPC_ERROR_NONE==err && codecCounter.inflate_init!=inflate_init) err=OPC_ERROR_STREAM; // zlib again
+        report("read back", err);
+        opcContainerClose(c, OPC_CLOSE_NOW);
+    } else if (OPC_ERROR_NONE==err) {
+        err=OPC_ERROR_STREAM;
+    }
+    return err;
+}
+
+// Maps the part and compares it with reading it through an input stream.
+static opc_error_t compareMapped(opcContainer *c, const char *name, bool expect_map) {
+    const uint8_t *data=NULL;
+    opc_ofs_t data_len=0;
+    opc_error_t err=opcContainerMapPart(c, BAD_CAST(name), &data, &data_len);
+    bool const mapped=(OPC_ERROR_NONE==err);
+    if (mapped!=expect_map) {
+        err=OPC_ERROR_STREAM;
+    } else if (!mapped) {
+        err=readPart(c, name); // the fall back
+    } else {
+        err=OPC_ERROR_STREAM;
+        opcContainerInputStream *stream=opcContainerOpenInputStream(c, BAD_CAST(name));
+        if (NULL!=stream) {
+            static uint8_t buf[BUFFER_SIZE];
+            opc_ofs_t ofs=0;
+            uint32_t len=0;
+            err=OPC_ERROR_NONE;
+            while(OPC_ERROR_NONE==err && (len=opcContainerReadInputStream(stream, buf, sizeof(buf)))>0) {
+                if (ofs+len>data_len || 0!=memcmp(data+ofs, buf, len)) err=OPC_ERROR_STREAM;
+                ofs+=len;
+            }
+            opc_error_t const close_err=opcContainerCloseInputStream(stream);
+            if (OPC_ERROR_NONE==err) err=close_err;
+            if (OPC_ERROR_NONE==err && ofs!=data_len) err=OPC_ERROR_STREAM;
+        }
+    }
+    printf("%s %s...%s\n", name, (mapped?"mapped":"not mapped"), (OPC_ERROR_NONE==err?"ok":"failure"));
+    return err;
+}
+
+/*
+    Adds a stored and a deflated part to a copy of src and maps them with the container opened from memory, with mmap
+    and from a file. Stored parts can be mapped from memory and with mmap, and the mapping must match the content read 
+    by an input stream. Deflated parts and files which are not mapped must fail, so the caller falls back to a stream.
+*/
+static opc_error_t mapTest(const char *filename, const char *src) {
+    static const struct { const char *name; opcContainerOpenMode mode; bool mem; bool map; } variants[]={
+        { "memory", OPC_OPEN_READ_ONLY, true, true },
+        { "mmap", OPC_OPEN_MMAP, false, true },
+        { "file", OPC_OPEN_READ_ONLY, false, false }
+    };
+    opc_error_t err=OPC_ERROR_STREAM;
+    opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), OPC_OPEN_READ_WRITE, NULL, NULL):NULL);
+    if (NULL!=c) {
+        err=writePart(c, "data/stored.bin", 200000, OPC_COMPRESSIONOPTION_NONE);
+        if (OPC_ERROR_NONE==err) err=writePart(c, "data/deflated.bin", 200000, OPC_COMPRESSIONOPTION_NORMAL);
+        if (OPC_ERROR_NONE==err) err=writePart(c, "data/empty.bin", 0, OPC_COMPRESSIONOPTION_NONE);
+        opc_error_t const close_err=opcContainerClose(c, OPC_CLOSE_NOW);
+        if (OPC_ERROR_NONE==err) err=close_err;
+    }
+    report("write", err);
+    for(uint32_t i=0;OPC_ERROR_NONE==err && i<sizeof(variants)/sizeof(variants[0]);i++) {
+        uint8_t *data=NULL;
+        size_t data_len=0;
+        c=NULL;
+        if (!variants[i].mem) {
+            c=opcContainerOpen(BAD_CAST(filename), variants[i].mode, NULL, NULL);
+        } else if (NULL!=(data=readFile(filename, &data_len))) {
+            c=opcContainerOpenMem(data, data_len, variants[i].mode, NULL);
+        }
+        printf("%s:\n", variants[i].name);
+        if (NULL!=c) {
+            err=compareMapped(c, "data/stored.bin", variants[i].map);
+            if (OPC_ERROR_NONE==err) err=compareMapped(c, "word/media/image1.jpeg", variants[i].map);
+            if (OPC_ERROR_NONE==err) err=compareMapped(c, "data/empty.bin", variants[i].map);
+            if (OPC_ERROR_NONE==err) err=compareMapped(c, "data/deflated.bin", false);
+            if (OPC_ERROR_NONE==err) err=compareMapped(c, "word/document.xml", false);
+            if (OPC_ERROR_NONE==err) err=verifyPart(c, "data/stored.bin", 200000); // the mapping leaves the part intact
+            opcContainerClose(c, OPC_CLOSE_NOW);
+        } else {
+            err=OPC_ERROR_STREAM;
+        }
+        free(data);
+    }
+    return err;
+}
+
+// Writes all relations of the root and of every part, and the incoming relations of every part.
+static uint32_t dumpRelations(opcContainer *c, FILE *out) {
+    uint32_t ret=0;
+    opcPart source=OPC_PART_INVALID;
+    do {
+        for(opcRelation rel=opcRelationFirst(c, source);OPC_RELATION_INVALID!=rel;rel=opcRelationNext(c, source, rel)) {
+            const xmlChar *prefix=NULL;
+            uint32_t counter=(uint32_t)-1;
+            const xmlChar *type=NULL;
+            opcRelationGetInformation(c, source, rel, &prefix, &counter, &type);
+            opcPart const target=opcRelationGetInternalTarget(c, source, rel);
+            char buf[20]="";
+            if ((uint32_t)-1!=counter) {
+                snprintf(buf, sizeof(buf), "%u", counter);
+            }
+            fprintf(out, "%s %s%s %s %s\n", (OPC_PART_INVALID!=source?(const char *)source:"/"), prefix, buf, 
+                    (OPC_PART_INVALID!=target?target:opcRelationGetExternalTarget(c, source, rel)), type);
+            ret++;
+        }
+        source=(OPC_PART_INVALID==source?opcPartGetFirst(c):opcPartGetNext(c, source));
+    } while(OPC_PART_INVALID!=source);
+    for(opcPart part=opcPartGetFirst(c);OPC_PART_INVALID!=part;part=opcPartGetNext(c, part)) {
+        uint32_t incoming=0;
+        opcPart in_source=OPC_PART_INVALID;
+        for(opcRelation rel=opcRelationFirstIncoming(c, part, &in_source);OPC_RELATION_INVALID!=rel;rel=opcRelationNextIncoming(c, part, &in_source, rel)) {
+            incoming++;
+        }
+        fprintf(out, "%s %u incoming\n", part, incoming);
+    }
+    return ret;
+}
+
+// Compares the content of two files.
+static bool sameContent(FILE *a, FILE *b) {
+    static uint8_t buf_a[BUFFER_SIZE];
+    static uint8_t buf_b[BUFFER_SIZE];
+    size_t len_a=0;
+    size_t len_b=0;
+    rewind(a);
+    rewind(b);
+    do {
+        len_a=fread(buf_a, 1, sizeof(buf_a), a);
+        len_b=fread(buf_b, 1, sizeof(buf_b), b);
+    } while(len_a==len_b && len_a>0 && 0==memcmp(buf_a, buf_b, len_a));
+    return len_a==len_b && 0==len_a;
+}
+
+/*
+    Dumps the relations of src with relations parsed on demand, parsed on opening with OPC_OPEN_EAGER_RELATIONS and 
+    with OPC_OPEN_THREAD_SAFE, which implies eager relations. The dumps must be identical.
+*/
+static opc_error_t relationsTest(const char *filename, const char *src) {
+    static const struct { const char *name; opcContainerOpenMode mode; } variants[]={
+        { "lazy", OPC_OPEN_READ_ONLY },
+        { "eager", OPC_OPEN_EAGER_RELATIONS },
+        { "thread-safe", OPC_OPEN_THREAD_SAFE }
+    };
+    opc_error_t err=OPC_ERROR_NONE;
+    FILE *dump[sizeof(variants)/sizeof(variants[0])];
+    memset(dump, 0, sizeof(dump));
+    for(uint32_t i=0;OPC_ERROR_NONE==err && i<sizeof(variants)/sizeof(variants[0]);i++) {
+        opcContainer *c=(copyFile(src, filename)?opcContainerOpen(BAD_CAST(filename), variants[i].mode, NULL, NULL):NULL);
+        if (NULL!=c && NULL!=(dump[i]=tmpfile())) {
+            uint32_t const relations=dumpRelations(c, dump[i]);
+            err=(0==i || sameContent(dump[0], dump[i])?OPC_ERROR_NONE:OPC_ERROR_STREAM);
+            printf("%s: %u relations...%s\n", variants[i].name, relations, (OPC_ERROR_NONE==err?"ok":"failure"));
+        } else {
+            err=OPC_ERROR_STREAM;
+        }
+        if (NULL!=c) opcContainerClose(c, OPC_CLOSE_NOW);
+    }
+    if (NULL!=dump[0]) {
+        static uint8_t buf[BUFFER_SIZE];
+        size_t len=0;
+        rewind(dump[0]);
+        while((len=fread(buf, 1, sizeof(buf), dump[0]))>0) {
+            fwrite(buf, 1, len, stdout);
+        }
+    }
+    for(uint32_t i=0;i<sizeof(variants)/sizeof(variants[0]);i++) {
+        if (NULL!=dump[i]) fclose(dump[i]);
+    }
+    return err;
+}
+
+int main( int argc, const char* argv[] )
+{
+#ifdef WIN32
+     _CrtSetDbgFlag (_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
+    time_t start_time=time(NULL);
+    opc_error_t err=OPC_ERROR_NONE;
+    if (argc>2 && OPC_ERROR_NONE==(err=opcInitLibrary())) {
+        if (0==strcmp(argv[1], "entries") && argc>3) {
+            err=entriesTest(argv[2], (uint32_t)atol(argv[3]));
+        } else if (0==strcmp(argv[1], "size") && argc>3) {
+            err=sizeTest(argv[2], (opc_ofs_t)atol(argv[3])*1024*1024, OPC_OPEN_READ_ONLY);
+        } else if (0==strcmp(argv[1], "stream-size") && argc>3) {
+            err=sizeTest(argv[2], (opc_ofs_t)atol(argv[3])*1024*1024, OPC_OPEN_STREAMING);
+        } else if (0==strcmp(argv[1], "template") && argc>3) {
+            err=templateTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "transition") && argc>3) {
+            err=modifyTest(argv[2], argv[3], OPC_OPEN_TRANSITION, OPC_CLOSE_NOW);
+        } else if (0==strcmp(argv[1], "transition-defrag") && argc>3) {
+            err=modifyTest(argv[2], argv[3], OPC_OPEN_TRANSITION, OPC_CLOSE_DEFRAG);
+        } else if (0==strcmp(argv[1], "defrag") && argc>3) {
+            err=modifyTest(argv[2], argv[3], OPC_OPEN_READ_WRITE, OPC_CLOSE_DEFRAG);
+        } else if (0==strcmp(argv[1], "seek")) {
+            err=seekTest(argv[2]);
+        } else if (0==strcmp(argv[1], "parallel")) {
+            err=parallelTest(argv[2]);
+        } else if (0==strcmp(argv[1], "crc")) {
+            err=crcTest(argv[2]);
+        } else if (0==strcmp(argv[1], "extract") && argc>4) {
+            err=extractTest(argv[2], argv[3], OPC_OPEN_READ_ONLY, (uint32_t)atol(argv[4]));
+        } else if (0==strcmp(argv[1], "extract-modified") && argc>4) {
+            err=extractTest(argv[2], argv[3], OPC_OPEN_READ_WRITE, (uint32_t)atol(argv[4]));
+        } else if (0==strcmp(argv[1], "thread-safe") && argc>4) {
+            err=threadSafeTest(argv[2], argv[3], (opcContainerOpenMode)(OPC_OPEN_READ_ONLY|OPC_OPEN_THREAD_SAFE), (uint32_t)atol(argv[4]));
+        } else if (0==strcmp(argv[1], "thread-safe-mmap") && argc>4) {
+            err=threadSafeTest(argv[2], argv[3], (opcContainerOpenMode)(OPC_OPEN_MMAP|OPC_OPEN_THREAD_SAFE), (uint32_t)atol(argv[4]));
+        } else if (0==strcmp(argv[1], "allocator") && argc>3) {
+            err=allocatorTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "relation-type") && argc>3) {
+            err=relationTypeTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "incoming") && argc>3) {
+            err=incomingTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "traverse") && argc>3) {
+            err=traverseTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "codec") && argc>3) {
+            err=codecTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "map") && argc>3) {
+            err=mapTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "relations") && argc>3) {
+            err=relationsTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "detached") && argc>3) {
+            err=detachedTest(argv[2], argv[3]);
+        } else if (0==strcmp(argv[1], "stream")) {
+            err=streamTest(argv[2]);
+        } else {
+            printf("ERROR: unknown test \"%s\".\n", argv[1]);
+            err=OPC_ERROR_STREAM;
+        }
+        opcFreeLibrary();
+    } else if (argc<=2) {
+        printf("opc_roundtrip TEST FILENAME [ARGS].\n\n");
+        printf("Sample: opc_roundtrip entries many.zip 65540\n");
+    }
+    time_t end_time=time(NULL);
+    fprintf(stderr, "time %.2lfsec\n", difftime(end_time, start_time));
+#ifdef WIN32
+    assert(!_CrtDumpMemoryLeaks());
+#endif
+    return (OPC_ERROR_NONE==err?0:3);
+}
@@ -33,8 +33,9 @@
 #include <opc/opc.h>
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 #include <time.h>
-#include <zlib.h> // for crc32 function
+#include <opc/helper.h> // for opcHelperCrc32
 #ifdef WIN32
 #include <crtdbg.h>
 #endif
@@ -63,12 +64,12 @@ opc_error_t loadSegment(void *iocontext,
                         opcZipLoaderReadCallback *read, 
                         opcZipLoaderCloseCallback *close, 
                         opcZipLoaderSkipCallback *skip) {
-    printf("%i: %s%s(%i%s) %i/%i %i/%i...", (int)info->stream_ofs, 
+    printf("%" PRIu64 ": %s%s(%i%s) %" PRIu64 "/%" PRIu64 " %i/%i...", (uint64_t)info->stream_ofs, 
                               info->name, 
                               (info->rels_segment?"(.rels)":""),
                               info->segment_number,
                               (info->last_segment?".last":""),
-                              info->compressed_size, info->uncompressed_size,
+                              (uint64_t)info->compressed_size, (uint64_t)info->uncompressed_size,
                               info->min_header_size, info->header_size);
     if (!verify_crc) {
         // enable this to SKIP throught the files FAST.
@@ -82,7 +83,7 @@ opc_error_t loadSegment(void *iocontext,
             char buf[OPC_DEFLATE_BUFFER_SIZE];
             int ret=0;
             while((ret=read(iocontext, buf, sizeof(buf)))>0) {
-                crc=crc32(crc, (const Bytef*)buf, ret);
+                crc=opcHelperCrc32(crc, (const uint8_t*)buf, ret);
             }
             OPC_ENSURE(0==close(iocontext));
             ok=(info->data_crc==crc);
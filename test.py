@@ -95,6 +95,16 @@ def opc_trim_test(path):
 	test.call(test.build("opc_dump"), [], [test.docs(path)], test.tmp(path+"_4.opc_trim.opc_dump"), [], {})
 	test.regr(test.tmp(path+"_3.opc_trim.opc_dump"), test.tmp(path+"_4.opc_trim.opc_dump"), True)
 
+def opc_roundtrip_test(path, args, zipread=False, unzip_return=0):
+	test.rm(test.tmp(path))
+	test.call(test.build("opc_roundtrip"), [], [args[0], test.tmp(path)]+args[1:], test.tmp(path+".opc_roundtrip"), [], {"return": 0})
+	test.regr(test.docs(path+".opc_roundtrip"), test.tmp(path+".opc_roundtrip"), True)
+	if zipread: # scans the local headers instead of reading the central directory
+		test.call(test.build("opc_zipread"), [], [test.tmp(path)], test.tmp(path+".opc_zipread"), [], {"return": 0})
+		test.regr(test.docs(path+".opc_zipread"), test.tmp(path+".opc_zipread"), True)
+	test.call("unzip", [], ["-tq", test.tmp(path)], test.tmp("stdout.txt"), [], {"return": unzip_return})
+	test.rm(test.tmp(path)) # some are several GB
+
 def mce_extract_test(path, part, namespaces, returncode):
 	_part_="."+part.replace('.', '_')
 	args=[test.docs(path), part]
@@ -255,6 +265,31 @@ if __name__ == "__main__":
 		opc_proc_test("OOXMLI1.docx", ["--delete", "customXml/item1.xml", "--dump"], "delete")
 		opc_proc_test("OOXMLI1.docx", ["--create", "readme.txt", "text/plain", "0", test.docs("Readme.txt"), "--delete", "readme.txt", "--dump"], "create_delete")
 
+		opc_roundtrip_test("zip64_entries.zip", ["entries", "65540"])
+		opc_roundtrip_test("zip64_size.zip", ["size", "4200"])
+		opc_roundtrip_test("stream_parts.zip", ["stream"], True)
+		opc_roundtrip_test("zip64_stream.zip", ["stream-size", "4200"])
+		opc_roundtrip_test("template.docx", ["template", test.docs("OOXMLI1.docx")])
+		opc_roundtrip_test("transition.docx", ["transition", test.docs("OOXMLI1.docx")], True)
+		opc_roundtrip_test("transition_defrag.docx", ["transition-defrag", test.docs("OOXMLI1.docx")], True)
+		opc_roundtrip_test("defrag.docx", ["defrag", test.docs("OOXMLI1.docx")], True)
+		opc_roundtrip_test("seek.zip", ["seek"])
+		opc_roundtrip_test("parallel.zip", ["parallel"])
+		opc_roundtrip_test("crc.zip", ["crc"], False, 2) # unzip has to find the corrupted part too
+		opc_roundtrip_test("extract.docx", ["extract", test.docs("OOXMLI1.docx"), "4"])
+		opc_roundtrip_test("extract.docx", ["extract", test.docs("OOXMLI1.docx"), "1"])
+		opc_roundtrip_test("extract_modified.docx", ["extract-modified", test.docs("OOXMLI1.docx"), "4"])
+		opc_roundtrip_test("detached.docx", ["detached", test.docs("OOXMLI1.docx")], True)
+		opc_roundtrip_test("thread_safe.docx", ["thread-safe", test.docs("OOXMLI1.docx"), "4"])
+		opc_roundtrip_test("thread_safe_mmap.docx", ["thread-safe-mmap", test.docs("OOXMLI1.docx"), "4"])
+		opc_roundtrip_test("allocator.docx", ["allocator", test.docs("OOXMLI1.docx")])
+		opc_roundtrip_test("relation_type.docx", ["relation-type", test.docs("OOXMLI1.docx")])
+		opc_roundtrip_test("incoming.docx", ["incoming", test.docs("OOXMLI1.docx")])
+		opc_roundtrip_test("traverse.docx", ["traverse", test.docs("OOXMLI1.docx")])
+		opc_roundtrip_test("codec.docx", ["codec", test.docs("OOXMLI1.docx")])
+		opc_roundtrip_test("map.docx", ["map", test.docs("OOXMLI1.docx")])
+		opc_roundtrip_test("relations.docx", ["relations", test.docs("OOXMLI1.docx")])
+
 	else:
 		ignore_list = {  }
 		skip_list = {  }